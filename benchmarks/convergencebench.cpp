@@ -0,0 +1,190 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QImage>
+#include <QSettings>
+
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "utils/imagecompare.h"
+#include "utils/renderconfig.h"
+#include "utils/sceneparser.h"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Measures error against wall time for each sampling strategy. A scene is
+// rendered once with many samples as the reference, then every strategy is
+// rendered at increasing sample counts, giving one error-versus-time curve
+// per strategy in a CSV file.
+
+/**
+ * @brief The SamplerVariant struct: a named sampling configuration
+ */
+struct SamplerVariant {
+    std::string name;
+    RayTracer::Config config;
+};
+
+/**
+ * @brief parseList: parses a comma separated list of numbers
+ */
+template <typename T> std::vector<T> parseList(const QString &text) {
+    std::vector<T> values;
+    for (const QString &item : text.split(",", Qt::SkipEmptyParts))
+        values.push_back((T)item.toDouble());
+    return values;
+}
+
+/**
+ * @brief renderImage: renders the scene with a configuration
+ * @param scene: the scene to render
+ * @param config: the configuration to render with
+ * @param seconds: set to the wall time of the render
+ * @return the rendered image
+ */
+QImage renderImage(const RayTraceScene &scene, const RayTracer::Config &config,
+                   double &seconds) {
+    QImage image(scene.width(), scene.height(), QImage::Format_RGBX8888);
+    image.fill(Qt::black);
+    RayTracer raytracer{config};
+    QElapsedTimer timer;
+    timer.start();
+    raytracer.render(reinterpret_cast<RGBA *>(image.bits()), scene);
+    seconds = timer.nsecsElapsed() / 1e9;
+    return image;
+}
+
+/**
+ * @brief rootMeanSquaredError: RMSE over the color channels, in 0-255 units
+ */
+double rootMeanSquaredError(const QImage &image, const QImage &reference) {
+    const RGBA *a = reinterpret_cast<const RGBA *>(image.constBits());
+    const RGBA *b = reinterpret_cast<const RGBA *>(reference.constBits());
+    double sum = 0;
+    int count = image.width() * image.height();
+    for (int i = 0; i < count; i++) {
+        double dr = a[i].r - b[i].r, dg = a[i].g - b[i].g, db = a[i].b - b[i].b;
+        sum += dr * dr + dg * dg + db * db;
+    }
+    return std::sqrt(sum / (3.0 * count));
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("config", "Path of the config file (.ini) of the scene.");
+    QCommandLineOption referenceSppOption("reference-spp", "Samples per pixel of the reference.", "n", "1024");
+    QCommandLineOption referenceOption("reference", "Reference image; rendered and saved here if it does not exist.", "file");
+    QCommandLineOption sppOption("spp", "Samples per pixel of each point of a curve.", "list", "1,2,4,8,16,32,64,128");
+    QCommandLineOption gridOption("area-light-grids", "Area light grid sizes to compare.", "list", "1,3,6,10");
+    QCommandLineOption adaptiveOption("adaptive-thresholds", "Adaptive sampling thresholds to compare.", "list", "0.5,1,2");
+    QCommandLineOption outputOption("output", "CSV file of the curves.", "file", "convergence.csv");
+    parser.addOption(referenceSppOption);
+    parser.addOption(referenceOption);
+    parser.addOption(sppOption);
+    parser.addOption(gridOption);
+    parser.addOption(adaptiveOption);
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    if (parser.positionalArguments().size() != 1) {
+        std::cerr << "Please provide a path to a config file (.ini) as a command-line argument." << std::endl;
+        return 1;
+    }
+
+    QSettings settings(parser.positionalArguments()[0], QSettings::IniFormat);
+    QString scenePath = settings.value("IO/scene").toString();
+    RenderData metaData;
+    if (!SceneParser::parse(scenePath.toStdString(), metaData)) {
+        std::cerr << "Error loading scene: \"" << scenePath.toStdString() << "\"" << std::endl;
+        return 1;
+    }
+    RayTraceScene scene{settings.value("Canvas/width").toInt(), settings.value("Canvas/height").toInt(), metaData};
+    RayTracer::Config baseConfig = readRayTracerConfig(settings);
+    scene.setAcceleration(baseConfig.enableAcceleration, baseConfig.bvhRebuildThreshold);
+    std::vector<int> gridSizes = parseList<int>(parser.value(gridOption));
+
+    // the reference uses the default strategies with many samples and a grid
+    // at least as fine as any compared one
+    QImage reference;
+    QString referencePath = parser.value(referenceOption);
+    if (!referencePath.isEmpty() && QFileInfo::exists(referencePath)) {
+        reference.load(referencePath);
+        reference = reference.convertToFormat(QImage::Format_RGBX8888);
+    }
+    if (reference.width() != scene.width() || reference.height() != scene.height()) {
+        RayTracer::Config referenceConfig = baseConfig;
+        referenceConfig.samplesPerPixel = parser.value(referenceSppOption).toInt();
+        referenceConfig.adaptiveThreshold = 0;
+        // its own random numbers, so that its noise does not match that of
+        // the strategies it measures
+        referenceConfig.seed = baseConfig.seed + 1;
+        for (int grid : gridSizes)
+            referenceConfig.areaLightGrid = std::max(referenceConfig.areaLightGrid, grid);
+        double seconds;
+        std::cout << "Rendering reference at " << referenceConfig.samplesPerPixel << " samples per pixel" << std::endl;
+        reference = renderImage(scene, referenceConfig, seconds);
+        std::cout << "Rendered reference in " << seconds << "s" << std::endl;
+        if (!referencePath.isEmpty())
+            reference.save(referencePath);
+    }
+
+    // the strategies to compare, each a change from the config file
+    std::vector<SamplerVariant> variants;
+    variants.push_back({"stratified", baseConfig});
+    SamplerVariant randomTime{"random-time", baseConfig};
+    randomTime.config.stratifiedTime = false;
+    variants.push_back(randomTime);
+    SamplerVariant randomArea{"random-area-light", baseConfig};
+    randomArea.config.stratifiedAreaLight = false;
+    variants.push_back(randomArea);
+    for (int grid : gridSizes) {
+        SamplerVariant variant{"area-light-grid-" + std::to_string(grid), baseConfig};
+        variant.config.areaLightGrid = grid;
+        variants.push_back(variant);
+    }
+    for (float threshold : parseList<float>(parser.value(adaptiveOption))) {
+        SamplerVariant variant{"adaptive-" + QString::number(threshold).toStdString(), baseConfig};
+        variant.config.adaptiveThreshold = threshold;
+        variants.push_back(variant);
+    }
+
+    std::ofstream csv(parser.value(outputOption).toStdString());
+    if (!csv) {
+        std::cerr << "Error: could not open \"" << parser.value(outputOption).toStdString() << "\" for writing" << std::endl;
+        return 1;
+    }
+    csv << "strategy,samples_per_pixel,seconds,rmse,psnr,ssim\n";
+
+    const RGBA *referenceData = reinterpret_cast<const RGBA *>(reference.constBits());
+    for (const SamplerVariant &variant : variants) {
+        for (int spp : parseList<int>(parser.value(sppOption))) {
+            RayTracer::Config config = variant.config;
+            config.samplesPerPixel = spp;
+            // adaptive pixels need a few samples before they can stop
+            config.adaptiveMinSamples = std::min(config.adaptiveMinSamples, spp);
+
+            double seconds;
+            QImage image = renderImage(scene, config, seconds);
+            const RGBA *data = reinterpret_cast<const RGBA *>(image.constBits());
+            double rmse = rootMeanSquaredError(image, reference);
+            double psnr = computePSNR(data, referenceData, scene.width(), scene.height());
+            double ssim = computeSSIM(data, referenceData, scene.width(), scene.height());
+
+            csv << variant.name << "," << spp << "," << seconds << "," << rmse << ","
+                << psnr << "," << ssim << "\n";
+            std::cout << variant.name << " spp=" << spp << " " << seconds << "s rmse=" << rmse << std::endl;
+        }
+    }
+    std::cout << "Saved convergence curves to \"" << parser.value(outputOption).toStdString() << "\"" << std::endl;
+
+    a.exit();
+    return 0;
+}
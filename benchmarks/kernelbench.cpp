@@ -0,0 +1,406 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "lenses/lenseassemblies.h"
+#include "light/lighting.h"
+#include "light/texturemap.h"
+#include "raytracer/raytracescene.h"
+#include "shapes/cone.h"
+#include "shapes/cube.h"
+#include "shapes/cylinder.h"
+#include "shapes/sphere.h"
+#include "singleraytrace/tracesingleray.h"
+#include "utils/sceneparser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <glm/gtc/matrix_transform.hpp>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Microbenchmarks of the ray tracing kernels. Every input is drawn from a
+// seeded generator, so two runs with the same seed time the same work.
+
+/**
+ * @brief The RayInput struct: an object space ray and the motion parameters
+ * of the moving shapes
+ */
+struct RayInput {
+    glm::vec3 point;
+    glm::vec3 direction;
+    double time;
+    glm::vec3 center2;
+};
+
+/**
+ * @brief The BenchResult struct: the timing of one benchmark
+ */
+struct BenchResult {
+    std::string name;
+    double nsPerOp;
+    std::uint64_t ops;
+};
+
+/**
+ * @brief benchSink: every benchmarked result is added here so that the
+ * compiler cannot discard the work
+ */
+volatile float benchSink = 0;
+
+/**
+ * @brief The BenchRunner class: runs benchmarks matching a filter and collects
+ * their results
+ */
+class BenchRunner {
+public:
+    BenchRunner(std::string filter, double minSeconds)
+        : m_filter(std::move(filter)), m_minSeconds(minSeconds) {}
+
+    /**
+     * @brief run: times op over every input index, repeating the sweep until a
+     * run lasts at least the minimum time, and keeps the median of 7 runs
+     * @param name: name of the benchmark
+     * @param inputCount: number of distinct inputs op accepts
+     * @param op: the kernel call for input i, returning a value to sink
+     */
+    void run(const std::string &name, int inputCount,
+             const std::function<float(int)> &op) {
+        if (inputCount == 0 || name.find(m_filter) == std::string::npos)
+            return;
+
+        // find how many sweeps over the inputs fill the minimum time
+        std::uint64_t sweeps = 1;
+        while (timeSweeps(inputCount, op, sweeps) < m_minSeconds && sweeps < (1u << 30))
+            sweeps *= 2;
+
+        std::vector<double> runs;
+        for (int r = 0; r < 7; r++)
+            runs.push_back(timeSweeps(inputCount, op, sweeps));
+        std::sort(runs.begin(), runs.end());
+
+        std::uint64_t ops = sweeps * inputCount;
+        BenchResult result{name, runs[runs.size() / 2] * 1e9 / ops, ops};
+        std::cout << std::left << std::setw(40) << result.name << std::right
+                  << std::fixed << std::setprecision(2) << std::setw(12)
+                  << result.nsPerOp << " ns/op" << std::endl;
+        m_results.push_back(result);
+    }
+
+    const std::vector<BenchResult> &getResults() const { return m_results; }
+
+private:
+    double timeSweeps(int inputCount, const std::function<float(int)> &op,
+                      std::uint64_t sweeps) {
+        float sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (std::uint64_t s = 0; s < sweeps; s++) {
+            for (int i = 0; i < inputCount; i++)
+                sum += op(i);
+        }
+        auto end = std::chrono::steady_clock::now();
+        benchSink = benchSink + sum;
+        return std::chrono::duration<double>(end - start).count();
+    }
+
+    std::string m_filter;
+    double m_minSeconds;
+    std::vector<BenchResult> m_results;
+};
+
+/**
+ * @brief makeRays: generates object space rays from around the unit shapes
+ * aimed at random points near them, so roughly half of them hit
+ * @param rng: the seeded generator
+ * @param count: number of rays to generate
+ * @return the rays
+ */
+std::vector<RayInput> makeRays(std::mt19937 &rng, int count) {
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    std::uniform_real_distribution<float> distance(1.5f, 3.f);
+    std::uniform_real_distribution<double> time(0.0, 1.0);
+    std::vector<RayInput> rays;
+    for (int i = 0; i < count; i++) {
+        glm::vec3 origin;
+        do {
+            origin = glm::vec3(unit(rng), unit(rng), unit(rng));
+        } while (glm::length(origin) < 0.1f || glm::length(origin) > 1.f);
+        origin = glm::normalize(origin) * distance(rng);
+        glm::vec3 target = 0.6f * glm::vec3(unit(rng), unit(rng), unit(rng));
+        rays.push_back(RayInput{origin, glm::normalize(target - origin),
+                                time(rng), glm::vec3(0, 0.5f, 0)});
+    }
+    return rays;
+}
+
+/**
+ * @brief hitPoints: intersects the rays with a shape and keeps the hit points
+ * @param rays: the rays to intersect
+ * @param intersect: returns the t value of a ray, -1 if it misses
+ * @return the inputs whose point is moved onto the shape's surface
+ */
+std::vector<RayInput>
+hitPoints(const std::vector<RayInput> &rays,
+          const std::function<float(const RayInput &)> &intersect) {
+    std::vector<RayInput> hits;
+    for (const RayInput &ray : rays) {
+        float t = intersect(ray);
+        if (t != -1.f) {
+            RayInput hit = ray;
+            hit.point = ray.point + t * ray.direction;
+            hits.push_back(hit);
+        }
+    }
+    return hits;
+}
+
+/**
+ * @brief makeScene: builds a scene of random shapes around a unit sphere at
+ * the origin, lit by a single light
+ * @param rng: the seeded generator
+ * @param light: the light of the scene
+ * @param occluderCount: number of random shapes besides the sphere
+ * @return the scene data
+ */
+RenderData makeScene(std::mt19937 &rng, const SceneLightData &light,
+                     int occluderCount) {
+    RenderData data{};
+    data.globalData = SceneGlobalData{0.5f, 0.5f, 0.5f, 0.f};
+    data.cameraData.pos = glm::vec4(0, 0, 5, 1);
+    data.cameraData.look = glm::vec4(0, 0, -1, 0);
+    data.cameraData.up = glm::vec4(0, 1, 0, 0);
+    data.cameraData.heightAngle = 0.5f;
+    data.lights.push_back(light);
+
+    ScenePrimitive primitive{};
+    primitive.material.clear();
+    primitive.material.cAmbient = glm::vec4(0.1f);
+    primitive.material.cDiffuse = glm::vec4(0.8f, 0.4f, 0.2f, 1);
+    primitive.material.cSpecular = glm::vec4(0.5f);
+    primitive.material.shininess = 20;
+    primitive.center2 = glm::vec3(0, 0.5f, 0);
+    primitive.type = PrimitiveType::PRIMITIVE_SPHERE;
+    data.shapes.push_back(RenderShapeData{primitive, glm::mat4(1), glm::mat4(1), "/sphere[0]"});
+
+    const PrimitiveType types[] = {
+        PrimitiveType::PRIMITIVE_SPHERE, PrimitiveType::PRIMITIVE_CUBE,
+        PrimitiveType::PRIMITIVE_CONE, PrimitiveType::PRIMITIVE_CYLINDER,
+        PrimitiveType::PRIMITIVE_SPHERE_MOVING, PrimitiveType::PRIMITIVE_CUBE_MOVING};
+    std::uniform_real_distribution<float> position(-3.f, 3.f);
+    std::uniform_real_distribution<float> scale(0.2f, 0.8f);
+    for (int i = 0; i < occluderCount; i++) {
+        primitive.type = types[i % std::size(types)];
+        glm::vec3 translation(position(rng), position(rng), position(rng));
+        glm::mat4 ctm = glm::scale(glm::translate(glm::mat4(1), translation),
+                                   glm::vec3(scale(rng)));
+        data.shapes.push_back(RenderShapeData{primitive, ctm, glm::inverse(ctm),
+                                              "/occluder" + std::to_string(i)});
+    }
+    return data;
+}
+
+/**
+ * @brief makeLight: creates a light of the given type above the scene
+ * @param type: the type of light
+ * @return the light
+ */
+SceneLightData makeLight(LightType type) {
+    SceneLightData light{};
+    light.type = type;
+    light.color = glm::vec4(1);
+    light.function = glm::vec3(1, 0.1f, 0);
+    switch (type) {
+    case LightType::LIGHT_POINT:
+        light.pos = glm::vec4(2, 3, 2, 1);
+        break;
+    case LightType::LIGHT_DIRECTIONAL:
+        light.dir = glm::vec4(-1, -1, -1, 0);
+        break;
+    case LightType::LIGHT_SPOT:
+        light.pos = glm::vec4(0, 3, 0, 1);
+        light.dir = glm::vec4(0, -1, 0, 0);
+        light.angle = 0.6f;
+        light.penumbra = 0.2f;
+        break;
+    case LightType::LIGHT_AREA:
+        light.pos = glm::vec4(-1, 3, -1, 1);
+        light.width = 2;
+        light.height = 2;
+        light.uvec = glm::vec3(1, 0, 0);
+        light.vvec = glm::vec3(0, 0, 1);
+        break;
+    }
+    return light;
+}
+
+/**
+ * @brief saveResults: writes the results as a JSON file
+ * @param file: path of the file to write
+ * @param seed: seed the inputs were generated with
+ * @param results: the benchmark results
+ * @return whether the file was written
+ */
+bool saveResults(const QString &file, unsigned seed,
+                 const std::vector<BenchResult> &results) {
+    QJsonArray benchmarks;
+    for (const BenchResult &result : results) {
+        QJsonObject entry;
+        entry["name"] = QString::fromStdString(result.name);
+        entry["ns_per_op"] = result.nsPerOp;
+        entry["ops"] = (double)result.ops;
+        benchmarks.append(entry);
+    }
+    QJsonObject root;
+    root["seed"] = (double)seed;
+    root["benchmarks"] = benchmarks;
+
+    QFile out(file);
+    if (!out.open(QIODevice::WriteOnly)) {
+        std::cerr << "Error: could not open \"" << file.toStdString() << "\" for writing" << std::endl;
+        return false;
+    }
+    out.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption seedOption("seed", "Seed of the random inputs.", "seed", "1230");
+    QCommandLineOption jsonOption("json", "Also write the results to this JSON file.", "file");
+    QCommandLineOption filterOption("filter", "Only run benchmarks whose name contains this text.", "text");
+    QCommandLineOption minTimeOption("min-time", "Minimum duration of a timed run in milliseconds.", "ms", "20");
+    parser.addOption(seedOption);
+    parser.addOption(jsonOption);
+    parser.addOption(filterOption);
+    parser.addOption(minTimeOption);
+    parser.process(a);
+
+    unsigned seed = parser.value(seedOption).toUInt();
+    std::mt19937 rng(seed);
+    BenchRunner runner(parser.value(filterOption).toStdString(),
+                       parser.value(minTimeOption).toDouble() / 1000.0);
+
+    const int inputCount = 4096;
+    std::vector<RayInput> rays = makeRays(rng, inputCount);
+
+    // intersections, normals and texture coordinates of each shape
+    struct ShapeKernels {
+        const char *name;
+        PrimitiveType type;
+        std::function<float(const RayInput &)> intersect;
+        std::function<glm::vec4(const RayInput &)> normal;
+    };
+    const std::vector<ShapeKernels> shapes = {
+        {"Sphere", PrimitiveType::PRIMITIVE_SPHERE,
+         [](const RayInput &r) { return SphereIntersect(r.point, r.direction).getIntersection(); },
+         [](const RayInput &r) { return SphereNormal(r.point).getObjectNormal(); }},
+        {"Cube", PrimitiveType::PRIMITIVE_CUBE,
+         [](const RayInput &r) { return CubeIntersect(r.point, r.direction).getIntersection(); },
+         [](const RayInput &r) { return CubeNormal(r.point).getObjectNormal(); }},
+        {"Cone", PrimitiveType::PRIMITIVE_CONE,
+         [](const RayInput &r) { return ConeIntersect(r.point, r.direction).getIntersection(); },
+         [](const RayInput &r) { return ConeNormal(r.point).getObjectNormal(); }},
+        {"Cylinder", PrimitiveType::PRIMITIVE_CYLINDER,
+         [](const RayInput &r) { return CylinderIntersect(r.point, r.direction).getIntersection(); },
+         [](const RayInput &r) { return CylinderNormal(r.point).getObjectNormal(); }},
+        {"movingSphere", PrimitiveType::PRIMITIVE_SPHERE_MOVING,
+         [](const RayInput &r) { return movingSphereIntersect(r.point, r.direction, r.time, r.center2).getIntersection(); },
+         [](const RayInput &r) { return movingSphereNormal(r.point, r.time, r.center2).getObjectNormal(); }},
+        {"movingCube", PrimitiveType::PRIMITIVE_CUBE_MOVING,
+         [](const RayInput &r) { return movingCubeIntersect(r.point, r.direction, r.time, r.center2).getIntersection(); },
+         [](const RayInput &r) { return movingCubeNormal(r.point, r.time, r.center2).getObjectNormal(); }},
+    };
+    for (const ShapeKernels &shape : shapes) {
+        std::string name = shape.name;
+        runner.run(name + "Intersect", rays.size(),
+                   [&](int i) { return shape.intersect(rays[i]); });
+
+        std::vector<RayInput> hits = hitPoints(rays, shape.intersect);
+        runner.run(name + "Normal", hits.size(), [&](int i) {
+            glm::vec4 normal = shape.normal(hits[i]);
+            return normal.x + normal.y + normal.z;
+        });
+        // getShapeUV dispatches to the UV function of each shape in
+        // texturemap.cpp; moving spheres have no UV mapping
+        if (shape.type != PrimitiveType::PRIMITIVE_SPHERE_MOVING) {
+            runner.run(name + "UV", hits.size(), [&](int i) {
+                auto [u, v] = getShapeUV(shape.type, hits[i].point, hits[i].time,
+                                         hits[i].center2);
+                return u + v;
+            });
+        }
+    }
+
+    // camera space directions across the field of view, as generatePrimaryRay
+    // hands them to the lens assembly
+    std::vector<glm::vec3> lensDirections;
+    std::uniform_real_distribution<float> viewPlane(-0.25f, 0.25f);
+    for (int i = 0; i < inputCount; i++)
+        lensDirections.push_back(glm::vec3(viewPlane(rng), viewPlane(rng), 1));
+    runner.run("computeLensesAdjustedDirection", lensDirections.size(), [&](int i) {
+        auto [direction, position, inLens] = computeLensesAdjustedDirection(lensDirections[i]);
+        return direction.x + position.y + (float)inLens;
+    });
+
+    // shading of points on the unit sphere, with shadows from 16 shapes
+    RayTracer::Config config{};
+    config.enableShadow = true;
+    std::vector<glm::vec3> spherePoints;
+    std::uniform_real_distribution<float> unit(-1.f, 1.f);
+    for (int i = 0; i < inputCount; i++) {
+        glm::vec3 direction(unit(rng), unit(rng), unit(rng));
+        spherePoints.push_back(0.5f * glm::normalize(direction + glm::vec3(0, 0, 1e-3f)));
+    }
+    const std::pair<const char *, LightType> lightTypes[] = {
+        {"point", LightType::LIGHT_POINT},
+        {"directional", LightType::LIGHT_DIRECTIONAL},
+        {"spot", LightType::LIGHT_SPOT},
+        {"area", LightType::LIGHT_AREA}};
+    for (auto [lightName, lightType] : lightTypes) {
+        RenderData data = makeScene(rng, makeLight(lightType), 16);
+        RayTraceScene scene(64, 64, data);
+        SceneMaterial material = scene.getShapes()[0].primitive.material;
+        runner.run(std::string("phong/") + lightName, spherePoints.size(), [&](int i) {
+            glm::vec4 position(spherePoints[i], 1);
+            glm::vec4 normal(glm::normalize(spherePoints[i]), 0);
+            RGBA color = phong(position, normal, glm::vec4(0, 0, 1, 0), material,
+                               scene.getLights(), scene.getGlobalData(), scene, config,
+                               0, PrimitiveType::PRIMITIVE_SPHERE, position, 0.5,
+                               glm::vec3(0, 0.5f, 0), 0.f);
+            return (float)(color.r + color.g + color.b);
+        });
+    }
+
+    // shadow rays from the surface of the unit sphere through 16 shapes
+    RenderData shadowData = makeScene(rng, makeLight(LightType::LIGHT_POINT), 16);
+    RayTraceScene shadowScene(64, 64, shadowData);
+    std::vector<RayInput> shadowRays;
+    for (int i = 0; i < inputCount; i++) {
+        glm::vec3 direction = glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0, 0, 1e-3f));
+        shadowRays.push_back(RayInput{spherePoints[i] + 1e-3f * direction, direction, 0.5,
+                                      glm::vec3(0, 0.5f, 0)});
+    }
+    runner.run("traceShadowRay", shadowRays.size(), [&](int i) {
+        return traceShadowRay(glm::vec4(shadowRays[i].point, 1),
+                              glm::vec4(shadowRays[i].direction, 0), shadowScene,
+                              shadowRays[i].time);
+    });
+
+    if (parser.isSet(jsonOption) &&
+        saveResults(parser.value(jsonOption), seed, runner.getResults())) {
+        std::cout << "Saved benchmark results to \"" << parser.value(jsonOption).toStdString() << "\"" << std::endl;
+    }
+
+    a.exit();
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSettings>
+
+#include "raytracer/raytracer.h"
+#include "raytracer/raytracescene.h"
+#include "utils/imagecompare.h"
+#include "utils/renderconfig.h"
+#include "utils/sceneparser.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+// Renders every scene of a manifest, times it and compares it against a
+// reference image. Exits with 1 if any scene is below its quality thresholds
+// or slower than its baseline time by more than the tolerance.
+
+/**
+ * @brief The SceneResult struct: the measurements of one manifest scene
+ */
+struct SceneResult {
+    QString name;
+    double seconds = 0;
+    std::uint64_t rays = 0;
+    double psnr = 0;
+    double ssim = 0;
+    bool passed = false;
+    QString failure;
+};
+
+/**
+ * @brief readJsonFile: reads a JSON file holding an object
+ * @param file: path of the file
+ * @param object: set to the object in the file
+ * @return whether the file could be read and parsed
+ */
+bool readJsonFile(const QString &file, QJsonObject &object) {
+    QFile in(file);
+    if (!in.open(QIODevice::ReadOnly)) {
+        std::cerr << "Error: could not open \"" << file.toStdString() << "\"" << std::endl;
+        return false;
+    }
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(in.readAll(), &error);
+    if (document.isNull() || !document.isObject()) {
+        std::cerr << "Error: could not parse \"" << file.toStdString()
+                  << "\": " << error.errorString().toStdString() << std::endl;
+        return false;
+    }
+    object = document.object();
+    return true;
+}
+
+/**
+ * @brief renderScene: renders a manifest scene and compares it to its
+ * reference
+ * @param entry: the manifest entry of the scene
+ * @param manifest: the manifest, holding the shared settings
+ * @param outputDir: if not empty, directory to save the render in
+ * @param result: filled with the measurements
+ * @return whether the scene could be rendered and compared
+ */
+bool renderScene(const QJsonObject &entry, const QJsonObject &manifest,
+                 const QString &outputDir, SceneResult &result) {
+    result.name = entry["name"].toString();
+    QSettings settings(entry["ini"].toString(), QSettings::IniFormat);
+    QString scenePath = settings.value("IO/scene").toString();
+
+    RenderData metaData;
+    if (!SceneParser::parse(scenePath.toStdString(), metaData)) {
+        std::cerr << "Error loading scene: \"" << scenePath.toStdString() << "\"" << std::endl;
+        return false;
+    }
+
+    // render every scene at the same fraction of its configured size
+    double scale = manifest["scale"].toDouble(1.0);
+    int width = std::max(1, (int)std::lround(settings.value("Canvas/width").toInt() * scale));
+    int height = std::max(1, (int)std::lround(settings.value("Canvas/height").toInt() * scale));
+
+    QImage image(width, height, QImage::Format_RGBX8888);
+    image.fill(Qt::black);
+    RGBA *data = reinterpret_cast<RGBA *>(image.bits());
+
+    RayTracer::Config config = readRayTracerConfig(settings, manifest["overrides"].toObject().toVariantMap());
+    RayTracer raytracer{config};
+    RayTraceScene rtScene{width, height, metaData};
+    rtScene.setAcceleration(config.enableAcceleration, config.bvhRebuildThreshold);
+    QElapsedTimer timer;
+    timer.start();
+    raytracer.render(data, rtScene);
+    result.seconds = timer.nsecsElapsed() / 1e9;
+#ifdef AETHER_RENDER_STATS
+    const RenderStats &stats = raytracer.getStats();
+    result.rays = stats.primaryRays + stats.reflectionRays + stats.shadowRays;
+#endif
+
+    if (!outputDir.isEmpty()) {
+        image.save(QDir(outputDir).filePath(result.name + ".png"));
+    }
+
+    QImage reference;
+    if (!reference.load(entry["reference"].toString())) {
+        std::cerr << "Error: could not load reference \"" << entry["reference"].toString().toStdString() << "\"" << std::endl;
+        return false;
+    }
+    reference = reference.convertToFormat(QImage::Format_RGBX8888);
+    if (reference.width() != width || reference.height() != height) {
+        reference = reference.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    const RGBA *referenceData = reinterpret_cast<const RGBA *>(reference.constBits());
+    result.psnr = computePSNR(data, referenceData, width, height);
+    result.ssim = computeSSIM(data, referenceData, width, height);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("manifest", "Path of the regression manifest (.json).");
+    QCommandLineOption baselineOption("baseline", "Results of an earlier run to compare render times against.", "file");
+    QCommandLineOption jsonOption("json", "Write the results to this JSON file.", "file");
+    QCommandLineOption outputOption("output-dir", "Save the renders in this directory.", "dir");
+    parser.addOption(baselineOption);
+    parser.addOption(jsonOption);
+    parser.addOption(outputOption);
+    parser.process(a);
+
+    if (parser.positionalArguments().size() != 1) {
+        std::cerr << "Please provide the path to a regression manifest as a command-line argument." << std::endl;
+        return 1;
+    }
+
+    QJsonObject manifest;
+    if (!readJsonFile(parser.positionalArguments()[0], manifest)) {
+        return 1;
+    }
+
+    // earlier render times, by scene name
+    std::map<QString, double> baselineSeconds;
+    if (parser.isSet(baselineOption)) {
+        QJsonObject baseline;
+        if (!readJsonFile(parser.value(baselineOption), baseline)) {
+            return 1;
+        }
+        for (const QJsonValue &scene : baseline["scenes"].toArray()) {
+            baselineSeconds[scene.toObject()["name"].toString()] = scene.toObject()["seconds"].toDouble();
+        }
+    }
+    double timeTolerance = manifest["timeTolerance"].toDouble(0.1);
+
+    std::cout << std::left << std::setw(28) << "scene" << std::right << std::setw(10) << "seconds"
+              << std::setw(14) << "rays/s" << std::setw(10) << "PSNR" << std::setw(8) << "SSIM"
+              << "  result" << std::endl;
+
+    std::vector<SceneResult> results;
+    bool allPassed = true;
+    for (const QJsonValue &value : manifest["scenes"].toArray()) {
+        QJsonObject entry = value.toObject();
+        SceneResult result;
+        if (!renderScene(entry, manifest, parser.value(outputOption), result)) {
+            result.failure = "could not render";
+        } else {
+            // a scene may tighten or relax the manifest's quality thresholds
+            double minPsnr = entry["minPsnr"].toDouble(manifest["minPsnr"].toDouble(30));
+            double minSsim = entry["minSsim"].toDouble(manifest["minSsim"].toDouble(0.9));
+            if (result.psnr < minPsnr) {
+                result.failure = QString("PSNR below %1").arg(minPsnr);
+            } else if (result.ssim < minSsim) {
+                result.failure = QString("SSIM below %1").arg(minSsim);
+            } else if (baselineSeconds.contains(result.name) &&
+                       result.seconds > baselineSeconds[result.name] * (1 + timeTolerance)) {
+                result.failure = QString("slower than baseline %1s").arg(baselineSeconds[result.name]);
+            }
+        }
+        result.passed = result.failure.isEmpty();
+        allPassed = allPassed && result.passed;
+
+        std::cout << std::left << std::setw(28) << result.name.toStdString() << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(10) << result.seconds
+                  << std::setprecision(0) << std::setw(14)
+                  << (result.seconds > 0 ? result.rays / result.seconds : 0)
+                  << std::setprecision(2) << std::setw(10) << result.psnr
+                  << std::setprecision(4) << std::setw(8) << result.ssim << "  "
+                  << (result.passed ? "PASS" : "FAIL: " + result.failure.toStdString()) << std::endl;
+        results.push_back(result);
+    }
+
+    if (parser.isSet(jsonOption)) {
+        QJsonArray scenes;
+        for (const SceneResult &result : results) {
+            QJsonObject scene;
+            scene["name"] = result.name;
+            scene["seconds"] = result.seconds;
+            scene["rays"] = (double)result.rays;
+            scene["raysPerSecond"] = result.seconds > 0 ? result.rays / result.seconds : 0;
+            // identical images have an infinite PSNR, which JSON cannot hold
+            scene["psnr"] = std::isinf(result.psnr) ? 100.0 : result.psnr;
+            scene["ssim"] = result.ssim;
+            scene["passed"] = result.passed;
+            scenes.append(scene);
+        }
+        QJsonObject root;
+        root["scenes"] = scenes;
+        QFile out(parser.value(jsonOption));
+        if (out.open(QIODevice::WriteOnly)) {
+            out.write(QJsonDocument(root).toJson());
+            std::cout << "Saved regression results to \"" << parser.value(jsonOption).toStdString() << "\"" << std::endl;
+        } else {
+            std::cerr << "Error: could not open \"" << parser.value(jsonOption).toStdString() << "\" for writing" << std::endl;
+        }
+    }
+
+    std::cout << (allPassed ? "All scenes passed" : "Some scenes failed") << std::endl;
+    a.exit();
+    return allPassed ? 0 : 1;
+}
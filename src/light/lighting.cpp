@@ -1,24 +1,23 @@
+#include "../light/texturemanager.h"
 #include "../light/texturemap.h"
 #include "../singleraytrace/tracesingleray.h"
 #include "../utils/imagereader.h"
+#include "../utils/pixelrandom.h"
+#include "../utils/renderstats.h"
 #include "../utils/rgba.h"
 #include "../utils/scenedata.h"
+#include "../utils/tracing.h"
 #include "light/texturemap.h"
 #include "utils/imagereader.h"
 #include "utils/rgba.h"
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
 #include <glm/glm.hpp>
 #include <iostream>
-#include <map>
+#include <optional>
 #include <ostream>
 
-/**
- * @brief loadedImages: map to store pointers to already loaded textures to
- * avoid having to reload the files
- */
-std::map<std::string, Image *> loadedImages;
-
 /**
  * @brief toRGBA: Helper function to convert illumination to RGBA, applying some
  * form of tone-mapping (e.g. clamping) in the process
@@ -50,56 +49,125 @@ glm::vec4 toIllumination(RGBA color) {
 }
 
 /**
- * @brief getTextureInterpolation: helper function to computer linear
- * interpolation between texture and object diffuse colors
- * @param material: material of the object for which to computer the
- * interpolation
- * @param globalData: global data of the scene
- * @param shapeType: type of shape for which the interpolation is being computed
+ * @brief getTextureColor: helper function to look up the texture color of a
+ * material at a point on a shape
+ * @param material: material of the object whose texture to sample
+ * @param shapeType: type of shape the point is on
  * @param objectSpaceIntersection: intersection point of the object in object
  * space
- * @return the scene color to use for the diffuse calculation involving linear
- * interpolation between the texture and object diffuse color
+ * @param config: configuration of the raytracer
+ * @param footprint: radius of the area a pixel covers around the point, in
+ * object space, 0 if unknown
+ * @return the texture color at the point as an illumination value
  */
-SceneColor getTextureInterpolation(SceneMaterial &material,
-                                   const SceneGlobalData &globalData,
-                                   PrimitiveType shapeType,
-                                   glm::vec4 objectSpaceIntersection, glm::vec3 center2, double time) {
+SceneColor getTextureColor(SceneMaterial &material, PrimitiveType shapeType,
+                           glm::vec4 objectSpaceIntersection, glm::vec3 center2,
+                           double time, const RayTracer::Config &config, float footprint) {
     // calculate u and v
     auto [u, v] = getShapeUV(shapeType, objectSpaceIntersection, time, center2);
 
-    // see if image is already loaded, if not then load it
-    if (!loadedImages.contains(material.textureMap.filename)) {
-        Image *newLoadedImage = loadImageFromFile(material.textureMap.filename);
-        loadedImages[material.textureMap.filename] = newLoadedImage;
+    // decoded on first use, see getTexture
+    RENDER_STAT(textureLookups++);
+    const Texture *texture = getTexture(material.textureMap.filename);
+    if (texture == nullptr)
+        return material.cDiffuse;
+    const Texture::Level &imageToUse = texture->levels[0];
+
+    if (config.enableTextureFilter) {
+        float scaleU = material.textureMap.repeatU * imageToUse.width;
+        float scaleV = material.textureMap.repeatV * imageToUse.height;
+        // the texels the footprint spans, from how far u and v move when
+        // stepping across it along each axis of object space; the step off
+        // the surface barely moves them
+        float extent = 0;
+        if (footprint > 0) {
+            for (int axis = 0; axis < 3; axis++) {
+                glm::vec4 offset = objectSpaceIntersection;
+                offset[axis] += footprint;
+                auto [offsetU, offsetV] = getShapeUV(shapeType, offset, time, center2);
+                // u and v wrap around, e.g. at the seam of a sphere
+                float du = std::abs(offsetU - u), dv = std::abs(offsetV - v);
+                du = std::min(du, 1 - du);
+                dv = std::min(dv, 1 - dv);
+                extent = std::max(extent, std::max(du * scaleU, dv * scaleV));
+            }
+        }
+        float lod = std::log2(std::max(1.f, 2 * extent));
+        return sampleTexture(*texture, u * scaleU, (1 - v) * scaleV, lod);
     }
-    Image *imageToUse = loadedImages[material.textureMap.filename];
 
     // calculate c and r
     // relevant formula: c = floor(u * m * w) % w
-    int c = (int)(u * material.textureMap.repeatU * imageToUse->width) %
-            imageToUse->width;
+    int c = (int)(u * material.textureMap.repeatU * imageToUse.width) %
+            imageToUse.width;
     // relevant algo section formula: check if c = m * w
-    if (c == material.textureMap.repeatU * imageToUse->width)
+    if (c == material.textureMap.repeatU * imageToUse.width)
         --c;
     // relevant formula: floor((1-v) * n * h) % h
-    int r = (int)((1 - v) * material.textureMap.repeatV * imageToUse->height) %
-            imageToUse->height;
+    int r = (int)((1 - v) * material.textureMap.repeatV * imageToUse.height) %
+            imageToUse.height;
     // relevant formula: check if r = n * h
-    if (r == material.textureMap.repeatV * imageToUse->height)
+    if (r == material.textureMap.repeatV * imageToUse.height)
         --r;
 
+    return toIllumination(imageToUse.texels[r * imageToUse.width + c]);
+}
+
+/**
+ * @brief getTextureInterpolation: helper function to computer linear
+ * interpolation between texture and object diffuse colors
+ * @param material: material of the object for which to computer the
+ * interpolation
+ * @param globalData: global data of the scene
+ * @param shapeType: type of shape for which the interpolation is being computed
+ * @param objectSpaceIntersection: intersection point of the object in object
+ * space
+ * @param config: configuration of the raytracer
+ * @param footprint: radius a pixel covers around the point in object space
+ * @return the scene color to use for the diffuse calculation involving linear
+ * interpolation between the texture and object diffuse color
+ */
+SceneColor getTextureInterpolation(SceneMaterial &material,
+                                   const SceneGlobalData &globalData,
+                                   PrimitiveType shapeType,
+                                   glm::vec4 objectSpaceIntersection, glm::vec3 center2, double time,
+                                   const RayTracer::Config &config, float footprint) {
     // calculate diffuse and linearly interpolate
     SceneColor diffuse = globalData.kd * material.cDiffuse;
     SceneColor linearInterpolation =
-        material.blend *
-                                         toIllumination(imageToUse->data[r * imageToUse->width + c]) +
+        material.blend * getTextureColor(material, shapeType,
+                                         objectSpaceIntersection, center2, time,
+                                         config, footprint) +
                                      (1.f - material.blend) * diffuse;
 
     // return the linear interpolation value
     return linearInterpolation;
 }
 
+/**
+ * @brief getAlbedo: computes the diffuse surface color of a material at a
+ * point, blending in the texture when texture mapping is enabled
+ * @param material: material of the object
+ * @param config: configuration of the raytracer
+ * @param shapeType: type of shape the point is on
+ * @param objectSpaceIntersection: intersection point in object space
+ * @param time: with potential object movement
+ * @param textureFootprint: radius a pixel covers around the point in object
+ * space, which picks the mip level of a filtered texture
+ * @return the albedo at the point
+ */
+SceneColor getAlbedo(SceneMaterial &material, const RayTracer::Config &config,
+                     PrimitiveType shapeType, glm::vec4 objectSpaceIntersection,
+                     double time, glm::vec3 center2, float textureFootprint) {
+    if (config.enableTextureMap && material.blend > 0)
+        return material.blend * getTextureColor(material, shapeType,
+                                                objectSpaceIntersection,
+                                                center2, time, config,
+                                                textureFootprint) +
+               (1.f - material.blend) * material.cDiffuse;
+    return material.cDiffuse;
+}
+
 auto point_on_light(glm::vec3 corner, glm::vec3 uvec, glm::vec3 vvec, int u,
                     int v) {
     return corner + uvec * (u + 0.5f) + vvec * (v + 0.5f);
@@ -122,6 +190,8 @@ auto point_on_light(glm::vec3 corner, glm::vec3 uvec, glm::vec3 vvec, int u,
  * @param shapeType: type of shape the light is being computed for
  * @param objectSpaceIntersection: intersection in object space
  * @param time: with potential object movement
+ * @param textureFootprint: radius a pixel covers around the point in object
+ * space, which picks the mip level of a filtered texture
  * @return an RGBA value corrosponding to the color of the object to render
  */
 RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
@@ -129,7 +199,19 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
            const SceneGlobalData &globalData, const RayTraceScene &scene,
            const RayTracer::Config &config, int completedReflections,
            PrimitiveType shapeType, glm::vec4 objectSpaceIntersection,
-           double time, glm::vec3 center2) {
+           double time, glm::vec3 center2, float textureFootprint) {
+
+    // the textured diffuse color is the same for every light, so it is only
+    // looked up once
+    std::optional<SceneColor> texturedDiffuse;
+    auto textureInterpolation = [&]() -> const SceneColor & {
+        if (!texturedDiffuse) {
+            texturedDiffuse = getTextureInterpolation(material, globalData, shapeType,
+                                                      objectSpaceIntersection, center2, time,
+                                                      config, textureFootprint);
+        }
+        return *texturedDiffuse;
+    };
 
     // normalizing directions
     normal = glm::normalize(normal);
@@ -147,8 +229,8 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
         switch (light.type) {
         case LightType::LIGHT_AREA: {
             float total = 0;
-            float usteps = 6;
-            float vsteps = 6;
+            float usteps = std::max(1, config.areaLightGrid);
+            float vsteps = std::max(1, config.areaLightGrid);
             glm::vec4 areaIllumination(0, 0, 0, 1);
             glm::vec3 corner = light.pos;
 
@@ -159,15 +241,18 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
             for (int i = 0; i < usteps; i++) {
                 for (int j = 0; j < vsteps; j++) {
                     // Adjust the corner for the current grid cell
-                    glm::vec3 adjustedCorner = corner + (i * uStepSize) + (j * vStepSize);
+                    glm::vec3 adjustedCorner = corner;
+                    if (config.stratifiedAreaLight)
+                        adjustedCorner += (i * uStepSize) + (j * vStepSize);
 
-                    // Randomize point within the grid cell
-                    float randomU = static_cast<float>(std::rand()) / RAND_MAX;
-                    float randomV = static_cast<float>(std::rand()) / RAND_MAX;
+                    // Randomize point within the grid cell, or within the whole
+                    // light without stratification
+                    float randomU = pixelRandom();
+                    float randomV = pixelRandom();
 
                     // Compute offsets for the randomized position
-                    float uOffset = randomU * uStepSize;
-                    float vOffset = randomV * vStepSize;
+                    float uOffset = randomU * (config.stratifiedAreaLight ? uStepSize : light.width);
+                    float vOffset = randomV * (config.stratifiedAreaLight ? vStepSize : light.height);
 
                     // Calculate the sample point on the area light
                     glm::vec4 samplePoint = glm::vec4(
@@ -185,8 +270,11 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
                     float minDistance = -1.f;
                     if (config.enableShadow) {
                         float epsilon = 1e-4f;
+                        int occluder;
                         minDistance = traceShadowRay(position + epsilon * directionToSample,
-                                                     directionToSample, scene, time);
+                                                     directionToSample, scene, time, &occluder);
+                        if (minDistance != -1.f && minDistance <= distance)
+                            RENDER_STAT(countPrimitive(occluder, &PrimitiveCost::occlusions));
                     }
 
                     // Diffuse term
@@ -195,8 +283,7 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
                         (minDistance > distance || minDistance == -1.f)) {
                         total += 1.f;
                         if (config.enableTextureMap && material.blend > 0) {
-                            SceneColor linearInterpolation = getTextureInterpolation(
-                                material, globalData, shapeType, objectSpaceIntersection, center2, time);
+                            SceneColor linearInterpolation = textureInterpolation();
                             areaIllumination +=
                                 light.color * fAtt * linearInterpolation * dotProductLambert;
                         } else {
@@ -236,8 +323,11 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
             if (config.enableShadow) {
                 // trace a shadow ray to determine possible intersection
                 float epsilon = pow(10, -2);
+                int occluder;
                 minDistance = traceShadowRay(position + epsilon * directionToLight,
-                                             directionToLight, scene, time);
+                                             directionToLight, scene, time, &occluder);
+                if (minDistance != -1.f && minDistance <= distanceToLight)
+                    RENDER_STAT(countPrimitive(occluder, &PrimitiveCost::occlusions));
             } else
                 minDistance = -1.f;
 
@@ -248,8 +338,7 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
                 if (config.enableTextureMap &&
                     material.blend > 0) { // complete texture mapping
                     // add interpolated color to the output
-                    SceneColor linearInterpolation = getTextureInterpolation(
-                        material, globalData, shapeType, objectSpaceIntersection, center2, time);
+                    SceneColor linearInterpolation = textureInterpolation();
                     illumination +=
                         light.color * fAtt * linearInterpolation * dotProductLambert;
                 } else
@@ -279,8 +368,11 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
             if (config.enableShadow) {
                 float epsilon = pow(10, -2);
                 // trace a shadow ray to determine possible intersection
+                int occluder;
                 minDistance = traceShadowRay(position + epsilon * directionToLight,
-                                             directionToLight, scene, time);
+                                             directionToLight, scene, time, &occluder);
+                if (minDistance != -1.f)
+                    RENDER_STAT(countPrimitive(occluder, &PrimitiveCost::occlusions));
             } else
                 minDistance = -1;
 
@@ -293,8 +385,7 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
                     material.blend > 0) { // complete texture mapping
 
                     // add interpolated color to the output
-                    SceneColor linearInterpolation = getTextureInterpolation(
-                        material, globalData, shapeType, objectSpaceIntersection, center2, time);
+                    SceneColor linearInterpolation = textureInterpolation();
                     illumination +=
                         light.color * fAtt * linearInterpolation * dotProductLambert;
                 } else
@@ -351,8 +442,11 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
             if (config.enableShadow) {
                 // trace a shadow ray to determine possible intersection
                 float epsilon = pow(10, -2);
+                int occluder;
                 minDistance = traceShadowRay(position + epsilon * directionToLight,
-                                             directionToLight, scene, time);
+                                             directionToLight, scene, time, &occluder);
+                if (minDistance != -1.f && minDistance <= distanceToLight)
+                    RENDER_STAT(countPrimitive(occluder, &PrimitiveCost::occlusions));
             } else
                 minDistance = -1;
 
@@ -363,8 +457,7 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
                 if (config.enableTextureMap &&
                     material.blend > 0) { // complete texture mapping
                     // add interpolated color to the output
-                    SceneColor linearInterpolation = getTextureInterpolation(
-                        material, globalData, shapeType, objectSpaceIntersection, center2, time);
+                    SceneColor linearInterpolation = textureInterpolation();
                     illumination +=
                         light.color * fAtt * linearInterpolation * dotProductLambert;
                 } else
@@ -397,6 +490,7 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
         // avoid self reflection
         float epsilon = pow(10, -1);
 
+        RENDER_STAT(reflectionRays++);
         illumination += toIllumination(traceRay(position + reflectedRay * epsilon,
                                                 reflectedRay, scene, config,
                                                 completedReflections + 1, time)) *
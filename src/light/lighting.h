@@ -12,6 +12,10 @@ RGBA phong(glm::vec4 position, glm::vec4 normal, glm::vec4 directionToCamera,
            const SceneGlobalData &globalData, const RayTraceScene &scene,
            const RayTracer::Config &config, int completedReflections,
            PrimitiveType shapeType, glm::vec4 objectSpaceIntersection,
-           double time, glm::vec3 center2);
+           double time, glm::vec3 center2, float textureFootprint);
+
+SceneColor getAlbedo(SceneMaterial &material, const RayTracer::Config &config,
+                     PrimitiveType shapeType, glm::vec4 objectSpaceIntersection,
+                     double time, glm::vec3 center2, float textureFootprint);
 
 #endif // LIGHTING_H
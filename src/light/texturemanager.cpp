@@ -0,0 +1,303 @@
+#include "texturemanager.h"
+#include "../utils/imagereader.h"
+#include "../utils/renderstats.h"
+#include "../utils/tracing.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+/**
+ * @brief The TextureEntry struct: a texture of the cache, with what its file
+ * looked like when it was loaded
+ */
+struct TextureEntry {
+    // null until decoded, or if the file could not be read
+    std::unique_ptr<Texture> texture;
+    // becomes ready once the texture is decoded, for threads that wait
+    std::shared_future<void> decoded;
+    std::atomic<bool> ready = false;
+    QDateTime modified;
+    qint64 size = 0;
+    // value of textureCacheEpoch when it was last looked up
+    std::atomic<std::uint64_t> lastUsed = 0;
+};
+
+/**
+ * @brief textureEntries: the decoded textures by file, guarded by
+ * textureEntriesMutex, which lookups only hold shared. Entries are never
+ * moved, so a thread can wait for one after letting go of the lock.
+ */
+std::map<std::string, TextureEntry> textureEntries;
+std::shared_mutex textureEntriesMutex;
+// bumped by every refresh, which invalidates the per-thread lookups
+std::atomic<std::uint64_t> textureCacheEpoch = 1;
+
+/**
+ * @brief The ThreadTextureLookups struct: the textures a thread has already
+ * looked up since the last refresh, so that shading a textured shape does
+ * not touch the shared lock once per sample
+ */
+struct ThreadTextureLookups {
+    std::uint64_t epoch = 0;
+    std::unordered_map<std::string, const Texture *> textures;
+};
+
+/**
+ * @brief decodeTexture: decodes an image file and builds its mip pyramid
+ * @param file: the image file
+ * @return the texture, or null if the file cannot be read
+ */
+std::unique_ptr<Texture> decodeTexture(const std::string &file) {
+    TRACE_SPAN("texture load", file);
+    Image *image = loadImageFromFile(file);
+    if (image == nullptr)
+        return nullptr;
+    auto texture = std::make_unique<Texture>();
+    texture->levels.push_back(Texture::Level{
+        image->width, image->height,
+        std::vector<RGBA>(image->data, image->data + (size_t)image->width * image->height)});
+    delete[] image->data;
+    delete image;
+    buildMipPyramid(*texture);
+    return texture;
+}
+
+/**
+ * @brief findTextureEntry: finds the entry of a file, creating it if needed
+ * @param file: the image file
+ * @param done: if the entry is created, the promise its waiters wait on
+ * @param created: set to whether the entry was created, in which case the
+ * caller must decode the texture with loadTextureEntry
+ * @return the entry
+ */
+TextureEntry &findTextureEntry(const std::string &file, std::promise<void> &done, bool &created) {
+    created = false;
+    {
+        std::shared_lock<std::shared_mutex> lock(textureEntriesMutex);
+        auto it = textureEntries.find(file);
+        if (it != textureEntries.end())
+            return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(textureEntriesMutex);
+    auto [it, inserted] = textureEntries.try_emplace(file);
+    if (inserted) {
+        // set up before any other thread can see the entry
+        it->second.decoded = done.get_future().share();
+        created = true;
+    }
+    return it->second;
+}
+
+/**
+ * @brief loadTextureEntry: decodes the texture of a newly created entry and
+ * wakes up the threads waiting for it
+ * @param entry: the entry
+ * @param file: its image file
+ * @param done: the promise behind entry.decoded
+ */
+void loadTextureEntry(TextureEntry &entry, const std::string &file, std::promise<void> &done) {
+    QFileInfo info(QString::fromStdString(file));
+    entry.modified = info.lastModified();
+    entry.size = info.size();
+    entry.texture = decodeTexture(file);
+    entry.ready = true;
+    done.set_value();
+}
+
+/**
+ * @brief getTexture: looks up the texture of a file, decoding it once
+ * @param file: the image file
+ * @return the texture, or null if the file cannot be read
+ */
+const Texture *getTexture(const std::string &file) {
+    thread_local ThreadTextureLookups lookups;
+    std::uint64_t epoch = textureCacheEpoch.load(std::memory_order_acquire);
+    if (lookups.epoch != epoch) {
+        lookups.textures.clear();
+        lookups.epoch = epoch;
+    }
+    auto known = lookups.textures.find(file);
+    if (known != lookups.textures.end())
+        return known->second;
+
+    bool created;
+    std::promise<void> done;
+    TextureEntry *entry = &findTextureEntry(file, done, created);
+    if (created) {
+        // a miss is only counted on a render thread; a texture preloaded by
+        // FramePipeline's loader thread is a hit by the time a render wants it
+        RENDER_STAT(textureCacheMisses++);
+        loadTextureEntry(*entry, file, done);
+    } else if (!entry->ready) {
+        std::shared_future<void> decoded;
+        {
+            std::shared_lock<std::shared_mutex> lock(textureEntriesMutex);
+            decoded = entry->decoded;
+        }
+        decoded.wait();
+    }
+    entry->lastUsed = epoch;
+    lookups.textures.emplace(file, entry->texture.get());
+    return entry->texture.get();
+}
+
+/**
+ * @brief refreshTextureCache: drops the textures whose file changed on disk
+ * since it was loaded, then the least recently used ones beyond maxTextures
+ * @param maxTextures: the number of textures to keep, 0 for no limit
+ */
+void refreshTextureCache(int maxTextures) {
+    std::unique_lock<std::shared_mutex> lock(textureEntriesMutex);
+    textureCacheEpoch++;
+
+    for (auto it = textureEntries.begin(); it != textureEntries.end();) {
+        QFileInfo info(QString::fromStdString(it->first));
+        if (it->second.ready && (info.lastModified() != it->second.modified || info.size() != it->second.size)) {
+            it = textureEntries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    if (maxTextures > 0 && (int)textureEntries.size() > maxTextures) {
+        std::vector<std::pair<std::uint64_t, std::string>> byUse;
+        for (const auto &[file, entry] : textureEntries)
+            byUse.push_back({entry.lastUsed.load(), file});
+        std::sort(byUse.begin(), byUse.end());
+        for (const auto &[lastUsed, file] : byUse) {
+            if ((int)textureEntries.size() <= maxTextures)
+                break;
+            if (textureEntries.at(file).ready)
+                textureEntries.erase(file);
+        }
+    }
+}
+
+/**
+ * @brief preloadTextures: decodes the textures of a scene into the texture
+ * cache, each by whichever thread gets to it first
+ * @param data: the parsed scene
+ */
+void preloadTextures(const RenderData &data) {
+    for (const RenderShapeData &shape : data.shapes) {
+        const SceneFileMap &textureMap = shape.primitive.material.textureMap;
+        if (!textureMap.isUsed)
+            continue;
+        bool created;
+        std::promise<void> done;
+        TextureEntry *entry = &findTextureEntry(textureMap.filename, done, created);
+        if (created) {
+            entry->lastUsed = textureCacheEpoch.load();
+            loadTextureEntry(*entry, textureMap.filename, done);
+        }
+    }
+}
+
+/**
+ * @brief buildMipPyramid: adds the levels below levels[0] of a texture, each
+ * texel averaging a 2x2 block of the level above; an odd last row or column
+ * is folded into its neighbor's block so that no texel is left out
+ * @param texture: the texture, with only levels[0]
+ */
+void buildMipPyramid(Texture &texture) {
+    texture.levels.resize(1);
+    while (texture.levels.back().width > 1 || texture.levels.back().height > 1) {
+        const Texture::Level &above = texture.levels.back();
+        Texture::Level level;
+        level.width = std::max(1, above.width / 2);
+        level.height = std::max(1, above.height / 2);
+        level.texels.resize((size_t)level.width * level.height);
+        for (int y = 0; y < level.height; y++) {
+            int y0 = std::min(2 * y, above.height - 1);
+            int y1 = y == level.height - 1 ? above.height - 1 : std::min(2 * y + 1, above.height - 1);
+            for (int x = 0; x < level.width; x++) {
+                int x0 = std::min(2 * x, above.width - 1);
+                int x1 = x == level.width - 1 ? above.width - 1 : std::min(2 * x + 1, above.width - 1);
+                glm::vec4 sum(0);
+                int count = 0;
+                for (int sy = y0; sy <= y1; sy++) {
+                    for (int sx = x0; sx <= x1; sx++) {
+                        const RGBA &texel = above.texels[(size_t)sy * above.width + sx];
+                        sum += glm::vec4(texel.r, texel.g, texel.b, texel.a);
+                        count++;
+                    }
+                }
+                sum = sum / (float)count + 0.5f;
+                level.texels[(size_t)y * level.width + x] =
+                    RGBA{(std::uint8_t)sum.r, (std::uint8_t)sum.g, (std::uint8_t)sum.b, (std::uint8_t)sum.a};
+            }
+        }
+        texture.levels.push_back(std::move(level));
+    }
+}
+
+/**
+ * @brief wrapTexel: wraps a texel coordinate into [0, size)
+ * @param coordinate: the coordinate, possibly negative or past the edge
+ * @param size: the size of the level along it
+ * @return the wrapped coordinate
+ */
+static int wrapTexel(int coordinate, int size) {
+    int wrapped = coordinate % size;
+    return wrapped < 0 ? wrapped + size : wrapped;
+}
+
+/**
+ * @brief sampleLevel: filters a level of a texture bilinearly
+ * @param level: the level
+ * @param x: horizontal position in texels of the level
+ * @param y: vertical position in texels of the level
+ * @return the color, with components from 0 to 1
+ */
+static glm::vec4 sampleLevel(const Texture::Level &level, float x, float y) {
+    // texel centers are at half-integer positions
+    x -= 0.5f;
+    y -= 0.5f;
+    float fx = std::floor(x), fy = std::floor(y);
+    float tx = x - fx, ty = y - fy;
+    int x0 = wrapTexel((int)fx, level.width), x1 = wrapTexel((int)fx + 1, level.width);
+    int y0 = wrapTexel((int)fy, level.height), y1 = wrapTexel((int)fy + 1, level.height);
+    auto texel = [&](int tx, int ty) {
+        const RGBA &t = level.texels[(size_t)ty * level.width + tx];
+        return glm::vec4(t.r, t.g, t.b, 0);
+    };
+    glm::vec4 top = glm::mix(texel(x0, y0), texel(x1, y0), tx);
+    glm::vec4 bottom = glm::mix(texel(x0, y1), texel(x1, y1), tx);
+    return glm::mix(top, bottom, ty) / 255.f;
+}
+
+/**
+ * @brief sampleTexture: filters a texture trilinearly over its mip pyramid
+ * @param texture: the texture
+ * @param x: horizontal position in texels of level 0
+ * @param y: vertical position in texels of level 0
+ * @param lod: log2 of the texels of level 0 the sample covers
+ * @return the color as an illumination value
+ */
+glm::vec4 sampleTexture(const Texture &texture, float x, float y, float lod) {
+    int last = (int)texture.levels.size() - 1;
+    lod = std::clamp(lod, 0.f, (float)last);
+    int fine = std::min((int)lod, last);
+    int coarse = std::min(fine + 1, last);
+    float blend = lod - fine;
+    auto sampleAt = [&](int index) {
+        const Texture::Level &level = texture.levels[index];
+        float scaleX = (float)level.width / texture.levels[0].width;
+        float scaleY = (float)level.height / texture.levels[0].height;
+        return sampleLevel(level, x * scaleX, y * scaleY);
+    };
+    glm::vec4 color = sampleAt(fine);
+    if (blend > 0 && coarse != fine) {
+        color = glm::mix(color, sampleAt(coarse), blend);
+    }
+    return color;
+}
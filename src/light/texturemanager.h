@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../utils/rgba.h"
+#include "../utils/sceneparser.h"
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The Texture struct: a decoded texture and its mip pyramid
+ */
+struct Texture {
+    struct Level {
+        int width;
+        int height;
+        std::vector<RGBA> texels;
+    };
+    // levels[0] is the image as decoded, each next level the previous one
+    // halved with a 2x2 box filter, down to 1x1
+    std::vector<Level> levels;
+};
+
+// Returns the texture of an image file, decoding it and building its mip
+// pyramid on first use. A thread asking for a texture that another thread is
+// decoding waits for it; lookups of other textures are not held up. Returns
+// null if the file cannot be read. The texture stays valid until
+// refreshTextureCache drops it.
+const Texture *getTexture(const std::string &file);
+
+// Drops the decoded textures whose file changed since it was loaded, and the
+// least recently used ones beyond maxTextures (0 for no limit). Must not be
+// called while a render is running.
+void refreshTextureCache(int maxTextures);
+
+// Decodes the textures of a scene that are not in the texture cache yet, so
+// that its render does not wait for them. Safe to call during a render.
+void preloadTextures(const RenderData &data);
+
+// Builds the mip pyramid over levels[0] of a texture.
+void buildMipPyramid(Texture &texture);
+
+// Filters a texture at (x, y), in texels of level 0 with the texture repeating
+// past its edges. lod is the log2 of the texels of level 0 a sample covers:
+// the two nearest levels are filtered bilinearly and blended (trilinear),
+// and a lod of 0 or less filters level 0 bilinearly. Returns the color as an
+// illumination value.
+glm::vec4 sampleTexture(const Texture &texture, float x, float y, float lod);
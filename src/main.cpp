@@ -3,10 +3,35 @@
 #include <QImage>
 #include <QtCore>
 
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <fstream>
 #include <iostream>
-#include "utils/sceneparser.h"
-#include "raytracer/raytracer.h"
-#include "raytracer/raytracescene.h"
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "raytracer/aovbuffers.h"
+#include "raytracer/framepipeline.h"
+#include "raytracer/partialrender.h"
+#include "raytracer/renderdaemon.h"
+#include "raytracer/renderjob.h"
+#include "utils/imageencoder.h"
+#include "utils/renderconfig.h"
+#include "utils/tracing.h"
+#include "utils/perfcounters.h"
+#include "utils/videostreamwriter.h"
+
+// Set by SIGINT and SIGTERM, which stop the batch at the next tile so that a
+// frame with a checkpoint saves it before the process exits
+static std::atomic<bool> terminationRequested = false;
+
+static void requestTermination(int signal) {
+    terminationRequested = true;
+    // a second signal kills the process as usual
+    std::signal(signal, SIG_DFL);
+}
 
 int main(int argc, char *argv[])
 {
@@ -14,70 +39,326 @@ int main(int argc, char *argv[])
 
     QCommandLineParser parser;
     parser.addHelpOption();
-    parser.addPositionalArgument("config", "Path of the config file.");
+    parser.addPositionalArgument("config", "Path of the config file, or a directory, glob, .txt manifest or template of config files.");
+    QCommandLineOption benchOption("bench", "Report hardware counters, IPC and ray throughput of each phase.");
+    QCommandLineOption framesOption("frames", "Frame range, e.g. 0-59, of a config template such as \"frame%d.ini\" or of an animated scene.", "range");
+    QCommandLineOption serveOption("serve", "Render jobs read as JSON lines from stdin, reporting on them as JSON lines on stdout.");
+    QCommandLineOption sceneCacheOption("scene-cache", "With --serve, the number of scenefiles whose parsed and built scenes are kept (default 4).", "count", "4");
+    QCommandLineOption textureCacheOption("texture-cache", "With --serve, the number of decoded textures that are kept (default 64).", "count", "64");
+    QCommandLineOption tileOption("tile", "Only render the pixels of the rectangle x0,y0,x1,y1 (x1 and y1 exclusive), writing them to a partial render next to the output.", "x0,y0,x1,y1");
+    QCommandLineOption shardOption("shard", "Only render every N-th tile starting at the k-th (from 0), writing them to a partial render next to the output.", "k/N");
+    QCommandLineOption mergeOption("merge", "Assemble the partial renders given as arguments into the image at this path.", "output");
+    QCommandLineOption resumeOption("resume", "Continue each frame from the checkpoint an interrupted render saved, see Settings/checkpoint-interval.");
+    QCommandLineOption videoOption("video", "Append the frames, in order, to a single video stream instead of IO/output: YUV4MPEG2 for a .y4m path, raw RGB24 otherwise, \"-\" for stdout.", "path");
+    QCommandLineOption fpsOption("fps", "With --video, the frame rate recorded in a .y4m stream (default 30).", "rate", "30");
+    QCommandLineOption concurrentFramesOption("concurrent-frames", "In a batch, how many frames render at the same time, sharing the thread pool and textures, 0 to pick from the tiles per frame (default 1).", "count", "1");
+    QCommandLineOption prefetchOption("prefetch", "In a batch, how many frames ahead scenes are parsed, textured and built while the current frame renders, 0 for none (default 1).", "frames", "1");
+    parser.addOption(benchOption);
+    parser.addOption(framesOption);
+    parser.addOption(serveOption);
+    parser.addOption(sceneCacheOption);
+    parser.addOption(textureCacheOption);
+    parser.addOption(tileOption);
+    parser.addOption(shardOption);
+    parser.addOption(mergeOption);
+    parser.addOption(resumeOption);
+    parser.addOption(videoOption);
+    parser.addOption(fpsOption);
+    parser.addOption(prefetchOption);
+    parser.addOption(concurrentFramesOption);
     parser.process(a);
 
+    if (parser.isSet(serveOption)) {
+        // stdout carries the events, so whatever the renders print goes to
+        // stderr instead
+        std::ostream events(std::cout.rdbuf());
+        std::cout.rdbuf(std::cerr.rdbuf());
+        RenderDaemon daemon(events, parser.value(sceneCacheOption).toInt(),
+                            parser.value(textureCacheOption).toInt());
+        int status = daemon.run(std::cin);
+        std::cout.rdbuf(events.rdbuf());
+        a.exit(status);
+        return status;
+    }
+
     auto positionalArgs = parser.positionalArguments();
+
+    if (parser.isSet(mergeOption)) {
+        std::vector<std::string> parts;
+        for (const QString &part : positionalArgs) {
+            parts.push_back(part.toStdString());
+        }
+        std::vector<RGBA> pixels;
+        int width = 0, height = 0;
+        if (!mergePartialRenders(parts, pixels, width, height)) {
+            a.exit(1);
+            return 1;
+        }
+        // the same encoder as a render in a single process with the default
+        // IO/encoder, so that the files are identical
+        QImage image(width, height, QImage::Format_RGBX8888);
+        std::memcpy(image.bits(), pixels.data(), pixels.size() * sizeof(RGBA));
+        QString output = parser.value(mergeOption);
+        if (!saveImage(image, output.toStdString())) {
+            std::cerr << "Error: failed to save image to \"" << output.toStdString() << "\"" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+        std::cout << "Merged " << parts.size() << " partial renders into \"" << output.toStdString() << "\"" << std::endl;
+        a.exit();
+        return 0;
+    }
+
     if (positionalArgs.size() != 1) {
         std::cerr << "Not enough arguments. Please provide a path to a config file (.ini) as a command-line argument." << std::endl;
         a.exit(1);
         return 1;
     }
 
-    QSettings settings( positionalArgs[0], QSettings::IniFormat );
-    QString iScenePath = settings.value("IO/scene").toString();
-    QString oImagePath = settings.value("IO/output").toString();
+    std::vector<FrameJob> jobs = expandFrameJobs(positionalArgs[0], parser.value(framesOption));
+    if (jobs.empty()) {
+        std::cerr << "Error: no config files found for \"" << positionalArgs[0].toStdString() << "\"" << std::endl;
+        a.exit(1);
+        return 1;
+    }
 
-    RenderData metaData;
-    bool success = SceneParser::parse(iScenePath.toStdString(), metaData);
+    // Spans are only recorded when the first frame asks for a trace, which
+    // then covers the whole batch
+    QSettings firstSettings( jobs[0].configPath, QSettings::IniFormat );
+    setTracingEnabled(firstSettings.value("Feature/trace").toBool());
+
+    // Settings/threads caps the threads of a parallel render, all cores by
+    // default, and likewise comes from the first frame for the whole batch
+    int threads = firstSettings.value("Settings/threads").toInt();
+    if (threads > 0) {
+        QThreadPool::globalInstance()->setMaxThreadCount(threads);
+    }
 
-    if (!success) {
-        std::cerr << "Error loading scene: \"" << iScenePath.toStdString() << "\"" << std::endl;
+    // Frames of the same config would overwrite each other without a frame
+    // number in the output
+    QString firstOutput = firstSettings.value("IO/output").toString();
+    int firstFrame = jobs[0].frame >= 0 ? jobs[0].frame : firstSettings.value("Settings/frame").toInt();
+    if (jobs.size() > 1 && jobs[1].configPath == jobs[0].configPath &&
+        substituteFrame(firstOutput, 0) == firstOutput) {
+        std::cerr << "Error: IO/output needs a %d for the frame number to render several frames of \""
+                  << jobs[0].configPath.toStdString() << "\"" << std::endl;
         a.exit(1);
         return 1;
     }
 
-    // Raytracing-relevant code starts here
-
-    int width = settings.value("Canvas/width").toInt();
-    int height = settings.value("Canvas/height").toInt();
+    // In benchmark mode the counters are opened before any render thread
+    // exists, so that every thread inherits them
+    RenderJobContext context;
+    context.resume = parser.isSet(resumeOption);
+    // --bench saves each frame before rendering the next, so that its save
+    // phase times and counts the whole encode
+    context.asyncSave = jobs.size() > 1 && !parser.isSet(benchOption);
+    if (parser.isSet(tileOption)) {
+        QStringList corners = parser.value(tileOption).split(",");
+        glm::ivec4 &region = context.shard.region;
+        if (corners.size() == 4) {
+            region = glm::ivec4(corners[0].toInt(), corners[1].toInt(), corners[2].toInt(), corners[3].toInt());
+        }
+        if (corners.size() != 4 || region.x < 0 || region.y < 0 || region.x >= region.z || region.y >= region.w) {
+            std::cerr << "Error: --tile expects x0,y0,x1,y1 with x0 < x1 and y0 < y1" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+    }
+    if (parser.isSet(shardOption)) {
+        QStringList fraction = parser.value(shardOption).split("/");
+        if (fraction.size() == 2) {
+            context.shard.index = fraction[0].toInt();
+            context.shard.count = fraction[1].toInt();
+        }
+        if (fraction.size() != 2 || context.shard.count < 1 || context.shard.index < 0 ||
+            context.shard.index >= context.shard.count) {
+            std::cerr << "Error: --shard expects k/N with 0 <= k < N" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+    }
 
-    // Extracting data pointer from Qt's image API
-    QImage image = QImage(width, height, QImage::Format_RGBX8888);
-    image.fill(Qt::black);
-    RGBA *data = reinterpret_cast<RGBA *>(image.bits());
+    // With --video, a pipe to stdout carries the frames, so the log goes to
+    // stderr instead
+    std::ostream standardOutput(std::cout.rdbuf());
+    std::ofstream videoFile;
+    std::unique_ptr<VideoStreamWriter> video;
+    if (parser.isSet(videoOption)) {
+        std::string videoPath = parser.value(videoOption).toStdString();
+        if (!context.shard.whole()) {
+            std::cerr << "Error: --video cannot be combined with --tile or --shard" << std::endl;
+            a.exit(1);
+            return 1;
+        }
+        std::ostream *videoStream = &standardOutput;
+        if (videoPath == "-") {
+            std::cout.rdbuf(std::cerr.rdbuf());
+        } else {
+            videoFile.open(videoPath, std::ios::binary | std::ios::trunc);
+            if (!videoFile) {
+                std::cerr << "Error: could not open \"" << videoPath << "\" for writing" << std::endl;
+                a.exit(1);
+                return 1;
+            }
+            videoStream = &videoFile;
+        }
+        video = std::make_unique<VideoStreamWriter>(*videoStream, VideoStreamWriter::formatOf(videoPath),
+                                                    parser.value(fpsOption).toInt());
+        context.video = video.get();
+    }
+    context.cancelled = &terminationRequested;
+    std::signal(SIGINT, requestTermination);
+    std::signal(SIGTERM, requestTermination);
+    std::unique_ptr<PerfCounters> perfCounters;
+    if (parser.isSet(benchOption)) {
+        perfCounters = std::make_unique<PerfCounters>();
+        for (int i = 0; i < PerfCounterValues::EVENT_COUNT; i++) {
+            auto event = (PerfCounterValues::Event)i;
+            if (!perfCounters->read().available[event]) {
+                std::cout << "Warning: hardware counter \"" << PerfCounters::eventName(event) << "\" is unavailable" << std::endl;
+            }
+        }
+        context.perfCounters = perfCounters.get();
+    }
 
-    // Setting up the raytracer
-    RayTracer::Config rtConfig{};
-    rtConfig.enableShadow        = settings.value("Feature/shadows").toBool();
-    rtConfig.enableReflection    = settings.value("Feature/reflect").toBool();
-    rtConfig.enableRefraction    = settings.value("Feature/refract").toBool();
-    rtConfig.enableTextureMap    = settings.value("Feature/texture").toBool();
-    rtConfig.enableTextureFilter = settings.value("Feature/texture-filter").toBool();
-    rtConfig.enableParallelism   = settings.value("Feature/parallel").toBool();
-    rtConfig.enableSuperSample   = settings.value("Feature/super-sample").toBool();
-    rtConfig.enableAcceleration  = settings.value("Feature/acceleration").toBool();
-    rtConfig.enableDepthOfField  = settings.value("Feature/depthoffield").toBool();
-    rtConfig.maxRecursiveDepth   = settings.value("Settings/maximum-recursive-depth").toInt();
-    rtConfig.onlyRenderNormals   = settings.value("Settings/only-render-normals").toBool();
+    // With --concurrent-frames, several frames render at once, each in a
+    // context of its own, and their tiles share the thread pool, so the tiles
+    // of one frame fill in while another finishes its last ones. 0 picks
+    // enough frames to give every thread 4 tiles at a time.
+    int lanes = parser.value(concurrentFramesOption).toInt();
+    if (lanes <= 0) {
+        RayTracer::Config firstConfig = readRayTracerConfig(firstSettings);
+        int tileSize = std::max(1, firstConfig.tileSize);
+        int tilesPerFrame = ((firstSettings.value("Canvas/width").toInt() + tileSize - 1) / tileSize) *
+                            ((firstSettings.value("Canvas/height").toInt() + tileSize - 1) / tileSize);
+        int threads = QThreadPool::globalInstance()->maxThreadCount();
+        lanes = std::clamp((4 * threads + tilesPerFrame - 1) / std::max(1, tilesPerFrame), 1, 8);
+    }
+    lanes = std::min(lanes, (int)jobs.size());
+    if (lanes > 1 && perfCounters) {
+        std::cerr << "Warning: --bench renders one frame at a time" << std::endl;
+        lanes = 1;
+    }
+    std::vector<std::unique_ptr<RenderJobContext>> laneContexts;
+    for (int i = 1; i < lanes; i++) {
+        auto laneContext = std::make_unique<RenderJobContext>();
+        laneContext->resume = context.resume;
+        laneContext->shard = context.shard;
+        laneContext->asyncSave = context.asyncSave;
+        laneContext->video = context.video;
+        laneContext->cancelled = context.cancelled;
+        laneContext->refreshTextures = false;
+        laneContexts.push_back(std::move(laneContext));
+    }
+    if (lanes > 1) {
+        // textures may only be dropped while nothing renders
+        context.refreshTextures = false;
+        std::cout << "Rendering " << lanes << " frames at a time" << std::endl;
+    }
 
-    RayTracer raytracer{ rtConfig };
+    // Frames share the parsed scene, the built scene and the texture cache,
+    // so a batch only pays for them when they change, and load new ones
+    // while the previous frame renders, see FramePipeline
+    QElapsedTimer batchTimer;
+    batchTimer.start();
+    for (size_t i = 0; i < jobs.size(); i++) {
+        jobs[i].index = (int)i;
+    }
+    std::unique_ptr<FramePipeline> pipeline;
+    int prefetch = parser.value(prefetchOption).toInt();
+    if (jobs.size() > 1 && prefetch > 0) {
+        pipeline = std::make_unique<FramePipeline>(jobs, prefetch);
+    }
+    // frames are taken in order, so that a frame of a --video stream never
+    // waits for one that no context took
+    std::mutex nextJobMutex;
+    size_t nextJob = 0;
+    auto takeJob = [&]() -> std::optional<FrameJob> {
+        if (terminationRequested)
+            return std::nullopt;
+        if (pipeline)
+            return pipeline->next();
+        std::lock_guard<std::mutex> lock(nextJobMutex);
+        if (nextJob >= jobs.size())
+            return std::nullopt;
+        return jobs[nextJob++];
+    };
+    std::atomic<int> failedFrames = 0;
+    auto renderJobs = [&](RenderJobContext &laneContext) {
+        while (std::optional<FrameJob> job = takeJob()) {
+            if (jobs.size() > 1) {
+                std::cout << "Rendering \"" << job->configPath.toStdString() << "\"";
+                if (job->frame >= 0) {
+                    std::cout << " at frame " << job->frame;
+                }
+                std::cout << std::endl;
+            }
+            if (!renderFrame(*job, laneContext)) {
+                failedFrames++;
+                if (video) {
+                    video->skipFrame(job->index);
+                }
+            }
+        }
+        waitForPendingSave(laneContext);
+        failedFrames += laneContext.failedSaves;
+    };
+    std::vector<std::thread> laneThreads;
+    for (std::unique_ptr<RenderJobContext> &laneContext : laneContexts) {
+        laneThreads.emplace_back(renderJobs, std::ref(*laneContext));
+    }
+    renderJobs(context);
+    for (std::thread &laneThread : laneThreads) {
+        laneThread.join();
+    }
+    pipeline.reset();
+    if (terminationRequested) {
+        std::cerr << "Stopped by a signal, rerun with --resume to continue" << std::endl;
+    }
+    if (video) {
+        if (video->close()) {
+            std::cout << "Wrote " << video->frameCount() << " frames to \"" << parser.value(videoOption).toStdString() << "\"" << std::endl;
+        } else {
+            std::cerr << "Error: failed to write the video stream" << std::endl;
+            failedFrames++;
+        }
+    }
 
-    RayTraceScene rtScene{ width, height, metaData };
+    if (jobs.size() > 1) {
+        double seconds = batchTimer.nsecsElapsed() / 1e9;
+        std::cout << "Rendered " << jobs.size() - failedFrames << " of " << jobs.size()
+                  << " frames in " << seconds << "s (" << seconds / jobs.size() << "s per frame)" << std::endl;
+    }
 
-    // Note that we're passing `data` as a pointer (to its first element)
-    // Recall from Lab 1 that you can access its elements like this: `data[i]`
-    raytracer.render(data, rtScene);
+    if (perfCounters) {
+        // a batch reports each phase summed over its frames
+        std::vector<BenchPhase> phases;
+        for (const BenchPhase &phase : context.benchPhases) {
+            auto it = std::find_if(phases.begin(), phases.end(), [&](const BenchPhase &p) { return p.name == phase.name; });
+            if (it == phases.end()) {
+                phases.push_back(phase);
+                continue;
+            }
+            it->seconds += phase.seconds;
+            it->rays += phase.rays;
+            for (int i = 0; i < PerfCounterValues::EVENT_COUNT; i++) {
+                it->counters.counts[i] += phase.counters.counts[i];
+            }
+        }
+        printBenchReport(phases);
+    }
 
-    // Saving the image
-    success = image.save(oImagePath);
-    if (!success) {
-        success = image.save(oImagePath, "PNG");
+    if (tracingEnabled()) {
+        std::string tracePath = auxiliaryOutputPath(substituteFrame(firstOutput, firstFrame).toStdString(), "trace", "json");
+        if (saveTrace(tracePath)) {
+            std::cout << "Saved trace to \"" << tracePath << "\"" << std::endl;
+        }
     }
-    if (success) {
-        std::cout << "Saved rendered image to \"" << oImagePath.toStdString() << "\"" << std::endl;
-    } else {
-        std::cerr << "Error: failed to save image to \"" << oImagePath.toStdString() << "\"" << std::endl;
+
+    if (failedFrames > 0) {
+        a.exit(1);
+        return 1;
     }
 
     a.exit();
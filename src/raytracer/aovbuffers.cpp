@@ -0,0 +1,123 @@
+#include "aovbuffers.h"
+#include "../utils/imagewriter.h"
+#include <filesystem>
+#include <iostream>
+
+/**
+ * @brief AOVBuffers::AOVBuffers: allocates zeroed buffers for every output
+ * @param width: width of the image in pixels
+ * @param height: height of the image in pixels
+ */
+AOVBuffers::AOVBuffers(int width, int height)
+    : width_(width), height_(height), normal_(width * height * 3, 0.f),
+    albedo_(width * height * 3, 0.f), motion_(width * height * 3, 0.f),
+    depth_(width * height, 0.f), primitiveId_(width * height, -1.f),
+    materialId_(width * height, -1.f), samples_(width * height, 0.f),
+    hits_(width * height, 0) {}
+
+/**
+ * @brief AOVBuffers::addSample: accumulates the hit information of one sample
+ * @param index: index of the pixel (j * width + i)
+ * @param hitInfo: information about the closest hit of the sample
+ * @param depth: camera space depth of the hit
+ * @param materialId: material ID of the hit shape
+ * @param motion: screen space motion of the hit point, in pixels
+ */
+void AOVBuffers::addSample(int index, const RayHitInfo &hitInfo, float depth,
+                           int materialId, glm::vec2 motion) {
+    samples_[index] += 1.f;
+    if (!hitInfo.hit)
+        return;
+
+    for (int c = 0; c < 3; c++) {
+        normal_[3 * index + c] += hitInfo.normal[c];
+        albedo_[3 * index + c] += hitInfo.albedo[c];
+    }
+    motion_[3 * index] += motion.x;
+    motion_[3 * index + 1] += motion.y;
+    depth_[index] += depth;
+
+    // IDs cannot be averaged, so the first sample to hit something wins
+    if (hits_[index] == 0) {
+        primitiveId_[index] = hitInfo.shapeIndex;
+        materialId_[index] = materialId;
+    }
+    hits_[index]++;
+}
+
+/**
+ * @brief AOVBuffers::addEmptySample: counts a sample that did not hit anything
+ * @param index: index of the pixel (j * width + i)
+ */
+void AOVBuffers::addEmptySample(int index) { samples_[index] += 1.f; }
+
+/**
+ * @brief AOVBuffers::resolve: turns the accumulated sums of a pixel into
+ * averages over the samples that hit a shape
+ * @param index: index of the pixel (j * width + i)
+ */
+void AOVBuffers::resolve(int index) {
+    if (hits_[index] == 0)
+        return;
+
+    float scale = 1.f / hits_[index];
+    for (int c = 0; c < 3; c++) {
+        albedo_[3 * index + c] *= scale;
+        motion_[3 * index + c] *= scale;
+    }
+    depth_[index] *= scale;
+
+    // renormalize the averaged normal
+    glm::vec3 normal(normal_[3 * index], normal_[3 * index + 1],
+                     normal_[3 * index + 2]);
+    if (glm::length(normal) > 0.f)
+        normal = glm::normalize(normal);
+    for (int c = 0; c < 3; c++)
+        normal_[3 * index + c] = normal[c];
+}
+
+/**
+ * @brief AOVBuffers::save: writes each buffer as a float image next to the
+ * beauty image
+ * @param outputPath: path of the beauty image
+ * @return True if every buffer was written, False otherwise
+ */
+bool AOVBuffers::save(const std::string &outputPath) const {
+    bool success = true;
+    success &= saveFloatImage(auxiliaryOutputPath(outputPath, "normal", "pfm"),
+                              width_, height_, 3, normal_.data());
+    success &= saveFloatImage(auxiliaryOutputPath(outputPath, "depth", "pfm"),
+                              width_, height_, 1, depth_.data());
+    success &= saveFloatImage(auxiliaryOutputPath(outputPath, "albedo", "pfm"),
+                              width_, height_, 3, albedo_.data());
+    success &=
+        saveFloatImage(auxiliaryOutputPath(outputPath, "primitiveid", "pfm"),
+                       width_, height_, 1, primitiveId_.data());
+    success &=
+        saveFloatImage(auxiliaryOutputPath(outputPath, "materialid", "pfm"),
+                       width_, height_, 1, materialId_.data());
+    success &= saveFloatImage(auxiliaryOutputPath(outputPath, "samples", "pfm"),
+                              width_, height_, 1, samples_.data());
+    success &= saveFloatImage(auxiliaryOutputPath(outputPath, "motion", "pfm"),
+                              width_, height_, 3, motion_.data());
+    if (success)
+        std::cout << "Saved auxiliary outputs next to \"" << outputPath << "\""
+                  << std::endl;
+    return success;
+}
+
+/**
+ * @brief auxiliaryOutputPath: builds the path of an extra output file that is
+ * stored alongside the beauty image
+ * @param outputPath: path of the beauty image
+ * @param name: name of the auxiliary output
+ * @param extension: file extension of the auxiliary output, without the dot
+ * @return the path with the beauty image's extension replaced
+ */
+std::string auxiliaryOutputPath(const std::string &outputPath,
+                                const std::string &name,
+                                const std::string &extension) {
+    std::filesystem::path path(outputPath);
+    path.replace_extension(name + "." + extension);
+    return path.string();
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The RayHitInfo struct: auxiliary information about the closest hit of
+ * a single camera ray, filled in by traceRay when requested
+ */
+struct RayHitInfo {
+    // hit: whether the ray hit any shape
+    bool hit = false;
+    // shapeIndex: index of the hit shape in RayTraceScene::getShapes()
+    int shapeIndex = -1;
+    // position: hit position in world space
+    glm::vec3 position = glm::vec3(0);
+    // normal: normalized surface normal in world space, facing the ray
+    glm::vec3 normal = glm::vec3(0);
+    // albedo: diffuse surface color, including texturing
+    glm::vec3 albedo = glm::vec3(0);
+    // velocity: world space displacement of the hit point over the shutter
+    glm::vec3 velocity = glm::vec3(0);
+};
+
+/**
+ * @brief The AOVBuffers class: per-pixel arbitrary output variables (normal,
+ * depth, albedo, primitive and material ID, sample count and motion) which are
+ * filled in alongside the beauty image during a render
+ */
+class AOVBuffers {
+public:
+    // constructor allocating buffers for a width x height image
+    AOVBuffers(int width, int height);
+
+    // accumulates one camera ray sample into the pixel at index
+    void addSample(int index, const RayHitInfo &hitInfo, float depth,
+                   int materialId, glm::vec2 motion);
+
+    // records that a sample missed the lens assembly or the scene
+    void addEmptySample(int index);
+
+    // averages the accumulated samples of the pixel at index
+    void resolve(int index);
+
+    // writes every buffer next to the beauty image at outputPath
+    bool save(const std::string &outputPath) const;
+
+private:
+    // width_, height_: dimensions of the buffers
+    int width_;
+    int height_;
+    // normal_, albedo_, motion_: three floats per pixel
+    std::vector<float> normal_;
+    std::vector<float> albedo_;
+    std::vector<float> motion_;
+    // depth_, primitiveId_, materialId_, samples_: one float per pixel
+    std::vector<float> depth_;
+    std::vector<float> primitiveId_;
+    std::vector<float> materialId_;
+    std::vector<float> samples_;
+    // hits_: number of samples per pixel that hit a shape
+    std::vector<int> hits_;
+};
+
+// Returns the path of an auxiliary output written next to the beauty image,
+// e.g. "out/frame.png" with ("normal", "pfm") gives "out/frame.normal.pfm"
+std::string auxiliaryOutputPath(const std::string &outputPath,
+                                const std::string &name,
+                                const std::string &extension);
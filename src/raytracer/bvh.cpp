@@ -0,0 +1,252 @@
+#include "bvh.h"
+#include "../utils/tracing.h"
+
+#include <algorithm>
+
+// Shapes per leaf below which a node is not split
+const int MAX_LEAF_SIZE = 2;
+// Buckets the centers are sorted into to evaluate the SAH of a split
+const int SAH_BUCKETS = 12;
+// Cost of traversing a node relative to one intersection test
+const float TRAVERSAL_COST = 0.5f;
+// Shutter times stay below 1, see the time draw in RayTracer::renderPixel
+const float MAX_SHUTTER_TIME = 1.f;
+
+/**
+ * @brief AABB::expand: grows the box to contain a point
+ * @param point: the point to contain
+ */
+void AABB::expand(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+/**
+ * @brief AABB::expand: grows the box to contain another box
+ * @param box: the box to contain
+ */
+void AABB::expand(const AABB &box) {
+    min = glm::min(min, box.min);
+    max = glm::max(max, box.max);
+}
+
+/**
+ * @brief AABB::surfaceArea: gets the surface area of the box
+ * @return the surface area, 0 for an empty box
+ */
+float AABB::surfaceArea() const {
+    glm::vec3 extent = max - min;
+    if (extent.x < 0 || extent.y < 0 || extent.z < 0)
+        return 0;
+    return 2.f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+/**
+ * @brief AABB::intersects: slab test of a ray against the box
+ * @param origin: origin of the ray
+ * @param inverseDirection: 1 / direction of the ray, per component
+ * @param tMax: the ray only counts up to this distance along direction
+ * @return true if the ray enters the box between 0 and tMax
+ */
+bool AABB::intersects(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                      float tMax) const {
+    glm::vec3 t0 = (min - origin) * inverseDirection;
+    glm::vec3 t1 = (max - origin) * inverseDirection;
+    glm::vec3 tNear = glm::min(t0, t1);
+    glm::vec3 tFar = glm::max(t0, t1);
+    float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.f));
+    float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+    return enter <= exit;
+}
+
+/**
+ * @brief shapeBounds: gets the world space bounds of a shape
+ * @param shape: the shape to bound
+ * @return the bounds of its unit object space box under its CTM
+ */
+AABB shapeBounds(const RenderShapeData &shape) {
+    AABB bounds;
+    if (shape.primitive.type == PrimitiveType::PRIMITIVE_MESH)
+        return bounds;
+
+    // every implicit shape fits in the unit cube centered at the origin;
+    // moving ones sweep it along center2 over the shutter
+    AABB objectBounds{glm::vec3(-0.5f), glm::vec3(0.5f)};
+    if (shape.primitive.type == PrimitiveType::PRIMITIVE_SPHERE_MOVING ||
+        shape.primitive.type == PrimitiveType::PRIMITIVE_CUBE_MOVING ||
+        shape.primitive.type == PrimitiveType::PRIMITIVE_CONE_MOVING ||
+        shape.primitive.type == PrimitiveType::PRIMITIVE_CYLINDER_MOVING) {
+        glm::vec3 offset = shape.primitive.center2 * MAX_SHUTTER_TIME;
+        objectBounds.expand(AABB{glm::vec3(-0.5f) + offset, glm::vec3(0.5f) + offset});
+    }
+
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 point((corner & 1) ? objectBounds.max.x : objectBounds.min.x,
+                        (corner & 2) ? objectBounds.max.y : objectBounds.min.y,
+                        (corner & 4) ? objectBounds.max.z : objectBounds.min.z);
+        bounds.expand(glm::vec3(shape.ctm * glm::vec4(point, 1.f)));
+    }
+    return bounds;
+}
+
+/**
+ * @brief BVH::build: builds the tree over the shapes
+ * @param shapes: the shapes of the scene, indexed as in RayTraceScene::getShapes
+ */
+void BVH::build(const std::vector<RenderShapeData> &shapes) {
+    TRACE_SPAN("BVH::build");
+    std::vector<AABB> bounds;
+    m_shapeIndices.clear();
+    for (int i = 0; i < (int)shapes.size(); i++) {
+        bounds.push_back(shapeBounds(shapes[i]));
+        if (bounds.back().surfaceArea() > 0)
+            m_shapeIndices.push_back(i);
+    }
+
+    m_nodes.clear();
+    m_nodes.reserve(2 * m_shapeIndices.size());
+    if (!m_shapeIndices.empty()) {
+        buildNode(m_shapeIndices, 0, (int)m_shapeIndices.size(), bounds, 0);
+    }
+    m_builtCost = sahCost();
+}
+
+/**
+ * @brief BVH::buildNode: builds the subtree over a range of shapes
+ * @param shapeIndices: the shapes, reordered so that every leaf is a range
+ * @param begin: first shape of the range
+ * @param end: one past the last shape of the range
+ * @param bounds: world bounds of every shape of the scene
+ * @param depth: depth of the subtree's root
+ * @return the index of the subtree's root in m_nodes
+ */
+int BVH::buildNode(std::vector<int> &shapeIndices, int begin, int end,
+                   const std::vector<AABB> &bounds, int depth) {
+    int index = (int)m_nodes.size();
+    m_nodes.emplace_back();
+    Node node;
+    AABB centerBounds;
+    for (int i = begin; i < end; i++) {
+        node.bounds.expand(bounds[shapeIndices[i]]);
+        centerBounds.expand(bounds[shapeIndices[i]].center());
+    }
+
+    int count = end - begin;
+    glm::vec3 centerExtent = centerBounds.max - centerBounds.min;
+    int axis = centerExtent.x > centerExtent.y ? (centerExtent.x > centerExtent.z ? 0 : 2)
+                                               : (centerExtent.y > centerExtent.z ? 1 : 2);
+    if (count <= MAX_LEAF_SIZE || centerExtent[axis] <= 0 || depth >= MAX_DEPTH) {
+        node.first = begin;
+        node.count = count;
+        m_nodes[index] = node;
+        return index;
+    }
+
+    // bucket the centers along the longest axis and split where the SAH is
+    // lowest
+    struct Bucket {
+        int count = 0;
+        AABB bounds;
+    };
+    Bucket buckets[SAH_BUCKETS];
+    auto bucketOf = [&](int shapeIndex) {
+        float offset = (bounds[shapeIndex].center()[axis] - centerBounds.min[axis]) / centerExtent[axis];
+        return std::min((int)(offset * SAH_BUCKETS), SAH_BUCKETS - 1);
+    };
+    for (int i = begin; i < end; i++) {
+        Bucket &bucket = buckets[bucketOf(shapeIndices[i])];
+        bucket.count++;
+        bucket.bounds.expand(bounds[shapeIndices[i]]);
+    }
+
+    float bestCost = FLT_MAX;
+    int bestSplit = 0;
+    for (int split = 0; split < SAH_BUCKETS - 1; split++) {
+        AABB left, right;
+        int leftCount = 0, rightCount = 0;
+        for (int b = 0; b <= split; b++) {
+            left.expand(buckets[b].bounds);
+            leftCount += buckets[b].count;
+        }
+        for (int b = split + 1; b < SAH_BUCKETS; b++) {
+            right.expand(buckets[b].bounds);
+            rightCount += buckets[b].count;
+        }
+        float cost = leftCount * left.surfaceArea() + rightCount * right.surfaceArea();
+        if (leftCount > 0 && rightCount > 0 && cost < bestCost) {
+            bestCost = cost;
+            bestSplit = split;
+        }
+    }
+
+    // a leaf is cheaper than any split
+    float leafCost = count * node.bounds.surfaceArea();
+    float splitCost = TRAVERSAL_COST * node.bounds.surfaceArea() + bestCost;
+    if (bestCost == FLT_MAX || leafCost <= splitCost) {
+        node.first = begin;
+        node.count = count;
+        m_nodes[index] = node;
+        return index;
+    }
+
+    int middle = (int)(std::partition(shapeIndices.begin() + begin, shapeIndices.begin() + end,
+                                      [&](int shapeIndex) { return bucketOf(shapeIndex) <= bestSplit; }) -
+                       shapeIndices.begin());
+
+    // the left child directly follows its parent, so a node only stores
+    // where the right one is
+    buildNode(shapeIndices, begin, middle, bounds, depth + 1);
+    node.first = buildNode(shapeIndices, middle, end, bounds, depth + 1);
+    m_nodes[index] = node;
+    return index;
+}
+
+/**
+ * @brief BVH::refit: updates the bounds of every node, bottom up, from the
+ * current CTMs of the shapes the tree was built over
+ * @param shapes: the shapes of the scene, in the same order as for build
+ */
+void BVH::refit(const std::vector<RenderShapeData> &shapes) {
+    TRACE_SPAN("BVH::refit");
+    // children always come after their parent, so walking backwards visits
+    // them first
+    for (int i = (int)m_nodes.size() - 1; i >= 0; i--) {
+        Node &node = m_nodes[i];
+        node.bounds = AABB();
+        if (node.count > 0) {
+            for (int j = node.first; j < node.first + node.count; j++)
+                node.bounds.expand(shapeBounds(shapes[m_shapeIndices[j]]));
+        } else {
+            node.bounds.expand(m_nodes[i + 1].bounds);
+            node.bounds.expand(m_nodes[node.first].bounds);
+        }
+    }
+}
+
+/**
+ * @brief BVH::needsRebuild: checks whether refits degraded the tree
+ * @param threshold: the cost ratio past which to rebuild, e.g. 1.5
+ * @return true if the SAH cost is more than threshold times the built cost
+ */
+bool BVH::needsRebuild(float threshold) const {
+    return sahCost() > threshold * m_builtCost;
+}
+
+/**
+ * @brief BVH::sahCost: computes the SAH cost of the tree, the expected
+ * number of node traversals and intersection tests of a ray that hits the
+ * root, weighted by TRAVERSAL_COST
+ * @return the cost, 0 for an empty tree
+ */
+float BVH::sahCost() const {
+    if (m_nodes.empty() || m_nodes[0].bounds.surfaceArea() <= 0)
+        return 0;
+
+    float rootArea = m_nodes[0].bounds.surfaceArea();
+    float cost = 0;
+    for (const Node &node : m_nodes) {
+        float probability = node.bounds.surfaceArea() / rootArea;
+        cost += probability * (node.count > 0 ? node.count : TRAVERSAL_COST);
+    }
+    return cost;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "../utils/sceneparser.h"
+
+#include <cfloat>
+#include <glm/glm.hpp>
+#include <vector>
+
+/**
+ * @brief The AABB struct: an axis-aligned bounding box in world space
+ */
+struct AABB {
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+
+    // grows the box to contain a point or another box
+    void expand(const glm::vec3 &point);
+    void expand(const AABB &box);
+
+    // surface area of the box, 0 if it is empty
+    float surfaceArea() const;
+
+    glm::vec3 center() const { return 0.5f * (min + max); }
+
+    // whether a ray enters the box before tMax, given the inverse of its
+    // direction
+    bool intersects(const glm::vec3 &origin, const glm::vec3 &inverseDirection,
+                    float tMax) const;
+};
+
+/**
+ * @brief The BVH class: a bounding volume hierarchy over the shapes of a
+ * scene, built with the surface area heuristic (SAH). When only the CTMs of
+ * the shapes change, e.g. between frames of an animation, refit updates the
+ * bounds and keeps the tree, which gets slower as shapes move away from where
+ * they were when it was built; needsRebuild compares its SAH cost to that of
+ * the build to tell when a rebuild pays off.
+ */
+class BVH {
+public:
+    // deepest level of the tree, which bounds the traversal stack
+    static const int MAX_DEPTH = 48;
+
+    // builds the tree over the world bounds of the shapes
+    void build(const std::vector<RenderShapeData> &shapes);
+
+    // updates the bounds from the current CTMs of the same shapes
+    void refit(const std::vector<RenderShapeData> &shapes);
+
+    // whether refits made the SAH cost grow past threshold times the cost
+    // right after the last build
+    bool needsRebuild(float threshold) const;
+
+    // SAH cost of the tree, in expected intersection tests per ray
+    float sahCost() const;
+
+    // calls visit(shapeIndex) for each shape whose bounds a ray starting at
+    // position in direction enters before tMax, which visit may lower
+    template <typename Visit>
+    void traverse(const glm::vec4 &position, const glm::vec4 &direction,
+                  const float &tMax, Visit &&visit) const;
+
+private:
+    // A node is a leaf when count > 0, with shapes m_shapeIndices[first, first
+    // + count), otherwise its children are the next node and node first
+    struct Node {
+        AABB bounds;
+        int first = 0;
+        int count = 0;
+    };
+
+    int buildNode(std::vector<int> &shapeIndices, int begin, int end,
+                  const std::vector<AABB> &bounds, int depth);
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_shapeIndices;
+    float m_builtCost = 0;
+};
+
+/**
+ * @brief shapeBounds: world space bounds of a shape, including its movement
+ * over the shutter for moving shapes
+ * @param shape: the shape to bound
+ * @return the bounds, empty for shapes that are never hit
+ */
+AABB shapeBounds(const RenderShapeData &shape);
+
+template <typename Visit>
+void BVH::traverse(const glm::vec4 &position, const glm::vec4 &direction,
+                   const float &tMax, Visit &&visit) const {
+    if (m_nodes.empty())
+        return;
+
+    glm::vec3 origin = glm::vec3(position);
+    glm::vec3 inverseDirection = 1.f / glm::vec3(direction);
+
+    // depth first with an explicit stack, left child first
+    int stack[MAX_DEPTH + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        int index = stack[--stackSize];
+        const Node &node = m_nodes[index];
+        if (!node.bounds.intersects(origin, inverseDirection, tMax))
+            continue;
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++)
+                visit(m_shapeIndices[i]);
+        } else {
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = index + 1;
+        }
+    }
+}
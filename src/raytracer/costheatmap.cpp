@@ -0,0 +1,141 @@
+#include "costheatmap.h"
+#include "../utils/cyclecounter.h"
+#include "../utils/imagewriter.h"
+#include "../utils/renderstats.h"
+#include "../utils/rgba.h"
+#include "aovbuffers.h"
+
+#include <QImage>
+#include <QString>
+
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <iostream>
+
+/**
+ * @brief CostHeatmap::CostHeatmap: allocates a zeroed heatmap
+ * @param width: width of the image in pixels
+ * @param height: height of the image in pixels
+ * @param metric: what to measure for each pixel
+ */
+CostHeatmap::CostHeatmap(int width, int height, Metric metric)
+    : width_(width), height_(height), metric_(metric),
+    cost_(width * height, 0.f) {}
+
+/**
+ * @brief intersectionTestCount: total intersection tests of the calling thread
+ * @return the number of tests, or 0 if the counters are compiled out
+ */
+static std::uint64_t intersectionTestCount() {
+    std::uint64_t tests = 0;
+#ifdef AETHER_RENDER_STATS
+    for (std::uint64_t typeTests : threadRenderStats().intersectionTests)
+        tests += typeTests;
+#endif
+    return tests;
+}
+
+/**
+ * @brief CostHeatmap::beginPixel: reads the counter of the metric
+ * @return the counter value before the pixel is rendered
+ */
+std::uint64_t CostHeatmap::beginPixel() const {
+    return metric_ == Metric::TIME ? readCycleCounter()
+                                   : intersectionTestCount();
+}
+
+/**
+ * @brief CostHeatmap::endPixel: records the cost of a pixel
+ * @param index: index of the pixel (j * width + i)
+ * @param begin: counter value returned by beginPixel
+ */
+void CostHeatmap::endPixel(int index, std::uint64_t begin) {
+    cost_[index] = (float)(beginPixel() - begin);
+}
+
+/**
+ * @brief turboColor: maps a value to the Turbo false-color colormap
+ * @param x: value in [0, 1]
+ * @return the color, blue for low values through red for high ones
+ *
+ * citation: polynomial approximation of Turbo by Anton Mikhailov,
+ * https://gist.github.com/mikhailov-work/0d177465a8151eb6ede1768d51d476c7
+ */
+static RGBA turboColor(float x) {
+    const glm::vec4 redVec4(0.13572138, 4.61539260, -42.66032258, 132.13108234);
+    const glm::vec4 greenVec4(0.09140261, 2.19418839, 4.84296658, -14.18503333);
+    const glm::vec4 blueVec4(0.10667330, 12.64194608, -60.58204836, 110.36276771);
+    const glm::vec2 redVec2(-152.94239396, 59.28637943);
+    const glm::vec2 greenVec2(4.27729857, 2.82956604);
+    const glm::vec2 blueVec2(-89.90310912, 27.34824973);
+
+    x = std::clamp(x, 0.f, 1.f);
+    glm::vec4 v4(1.f, x, x * x, x * x * x);
+    glm::vec2 v2 = glm::vec2(v4.z, v4.w) * v4.z;
+    glm::vec3 color(glm::dot(v4, redVec4) + glm::dot(v2, redVec2),
+                    glm::dot(v4, greenVec4) + glm::dot(v2, greenVec2),
+                    glm::dot(v4, blueVec4) + glm::dot(v2, blueVec2));
+    color = 255.f * glm::clamp(color, 0.f, 1.f);
+    return RGBA{(std::uint8_t)color.r, (std::uint8_t)color.g,
+                (std::uint8_t)color.b};
+}
+
+/**
+ * @brief CostHeatmap::save: writes the raw costs as a float image and a
+ * false-color PNG, normalized to the 99th percentile so a few outliers do not
+ * wash out the rest of the image
+ * @param outputPath: path of the beauty image
+ * @return True if both images were written, False otherwise
+ */
+bool CostHeatmap::save(const std::string &outputPath) const {
+    bool success = saveFloatImage(auxiliaryOutputPath(outputPath, "cost", "pfm"),
+                                  width_, height_, 1, cost_.data());
+
+    // find the cost the false colors saturate at
+    std::vector<float> sortedCost = cost_;
+    size_t percentile = sortedCost.empty() ? 0 : (sortedCost.size() - 1) * 99 / 100;
+    std::nth_element(sortedCost.begin(), sortedCost.begin() + percentile,
+                     sortedCost.end());
+    float maxCost = sortedCost.empty() ? 0.f : sortedCost[percentile];
+
+    QImage image(width_, height_, QImage::Format_RGBX8888);
+    RGBA *data = reinterpret_cast<RGBA *>(image.bits());
+    for (int i = 0; i < width_ * height_; i++)
+        data[i] = turboColor(maxCost > 0.f ? cost_[i] / maxCost : 0.f);
+
+    std::string heatmapPath = auxiliaryOutputPath(outputPath, "heatmap", "png");
+    if (!image.save(QString::fromStdString(heatmapPath), "PNG")) {
+        std::cerr << "Failed to save cost heatmap to \"" << heatmapPath << "\""
+                  << std::endl;
+        return false;
+    }
+    std::cout << "Saved cost heatmap to \"" << heatmapPath << "\" ("
+              << (metric_ == Metric::TIME ? "cycles" : "intersection tests")
+              << " per pixel, red at " << maxCost << ")" << std::endl;
+    return success;
+}
+
+/**
+ * @brief CostHeatmap::parseMetric: parses the metric named in a config file
+ * @param name: "time" or "tests"
+ * @param metric: set to the parsed metric on success
+ * @return True if the name is known, False otherwise
+ */
+bool CostHeatmap::parseMetric(const std::string &name, Metric &metric) {
+    if (name == "time") {
+        metric = Metric::TIME;
+        return true;
+    }
+    if (name == "tests") {
+#ifdef AETHER_RENDER_STATS
+        metric = Metric::INTERSECTION_TESTS;
+        return true;
+#else
+        std::cerr << "Counting intersection tests requires AETHER_RENDER_STATS"
+                  << std::endl;
+        return false;
+#endif
+    }
+    std::cerr << "Unknown cost heatmap metric \"" << name << "\"" << std::endl;
+    return false;
+}
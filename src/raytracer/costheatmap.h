@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The CostHeatmap class: records how expensive each pixel was to
+ * render, measured around the per-pixel loop of RayTracer::render, and saves
+ * it as a false-color image
+ */
+class CostHeatmap {
+public:
+    // What is measured for each pixel
+    enum class Metric {
+        // ticks of the CPU cycle counter
+        TIME,
+        // ray-shape intersection tests, requires AETHER_RENDER_STATS
+        INTERSECTION_TESTS,
+    };
+
+    // constructor allocating a width x height heatmap of the given metric
+    CostHeatmap(int width, int height, Metric metric);
+
+    // returns the metric's current counter, to be passed to endPixel
+    std::uint64_t beginPixel() const;
+
+    // stores the cost of the pixel at index, measured since beginPixel
+    void endPixel(int index, std::uint64_t begin);
+
+    // writes the false-color image and the raw costs next to outputPath
+    bool save(const std::string &outputPath) const;
+
+    // parses a metric name ("time" or "tests"), returns false if unknown
+    static bool parseMetric(const std::string &name, Metric &metric);
+
+private:
+    // width_, height_: dimensions of the heatmap
+    int width_;
+    int height_;
+    // metric_: what is measured
+    Metric metric_;
+    // cost_: measured cost of each pixel
+    std::vector<float> cost_;
+};
@@ -0,0 +1,192 @@
+#include "damageregion.h"
+#include "../singleraytrace/tracesingleray.h"
+#include "raytracescene.h"
+
+#include <cfloat>
+#include <cmath>
+
+/**
+ * @brief sameFileMap: checks whether two texture or bump maps are the same
+ * @param a: a map to compare with b
+ * @param b: a map to compare with a
+ * @return true if both map the same file the same way
+ */
+bool sameFileMap(const SceneFileMap &a, const SceneFileMap &b) {
+    return a.isUsed == b.isUsed && a.filename == b.filename &&
+           a.repeatU == b.repeatU && a.repeatV == b.repeatV;
+}
+
+/**
+ * @brief samePrimitive: checks whether two primitives have the same type,
+ * geometry and material
+ * @param a: a primitive to compare with b
+ * @param b: a primitive to compare with a
+ * @return true if the primitives render the same under the same CTM
+ */
+bool samePrimitive(const ScenePrimitive &a, const ScenePrimitive &b) {
+    const SceneMaterial &m = a.material;
+    const SceneMaterial &n = b.material;
+    return a.type == b.type && a.meshfile == b.meshfile && a.center2 == b.center2 &&
+           m.cAmbient == n.cAmbient && m.cDiffuse == n.cDiffuse &&
+           m.cSpecular == n.cSpecular && m.shininess == n.shininess &&
+           m.cReflective == n.cReflective && m.cTransparent == n.cTransparent &&
+           m.ior == n.ior && sameFileMap(m.textureMap, n.textureMap) &&
+           m.blend == n.blend && m.cEmissive == n.cEmissive &&
+           sameFileMap(m.bumpMap, n.bumpMap);
+}
+
+/**
+ * @brief sameLight: checks whether a light is unchanged
+ * @param a: a light to compare with b
+ * @param b: a light to compare with a
+ * @return true if every field that affects shading matches
+ */
+bool sameLight(const SceneLightData &a, const SceneLightData &b) {
+    return a.type == b.type && a.color == b.color && a.function == b.function &&
+           a.pos == b.pos && a.dir == b.dir && a.penumbra == b.penumbra &&
+           a.angle == b.angle && a.width == b.width && a.height == b.height &&
+           a.uvec == b.uvec && a.vvec == b.vvec;
+}
+
+/**
+ * @brief diffScenes: finds what changed between two evaluations of a scene
+ * @param before: the scene as it was rendered
+ * @param after: the scene about to be rendered
+ * @return the changes, full if they may affect every pixel
+ */
+SceneDiff diffScenes(const RenderData &before, const RenderData &after) {
+    SceneDiff diff;
+    const SceneCameraData &camera = before.cameraData;
+    const SceneCameraData &newCamera = after.cameraData;
+    const SceneGlobalData &globals = before.globalData;
+    const SceneGlobalData &newGlobals = after.globalData;
+    if (camera.pos != newCamera.pos || camera.look != newCamera.look ||
+        camera.up != newCamera.up || camera.heightAngle != newCamera.heightAngle ||
+        camera.aperture != newCamera.aperture ||
+        camera.focalLength != newCamera.focalLength || globals.ka != newGlobals.ka ||
+        globals.kd != newGlobals.kd || globals.ks != newGlobals.ks ||
+        globals.kt != newGlobals.kt || before.lights.size() != after.lights.size() ||
+        before.shapes.size() != after.shapes.size()) {
+        diff.full = true;
+        return diff;
+    }
+
+    // a light lights most of the image, so a changed one is not worth bounding
+    for (int i = 0; i < (int)before.lights.size(); i++) {
+        if (!sameLight(before.lights[i], after.lights[i])) {
+            diff.full = true;
+            return diff;
+        }
+    }
+
+    for (int i = 0; i < (int)before.shapes.size(); i++) {
+        const RenderShapeData &shape = before.shapes[i];
+        const RenderShapeData &newShape = after.shapes[i];
+        if (shape.ctm == newShape.ctm && samePrimitive(shape.primitive, newShape.primitive))
+            continue;
+
+        AABB bounds = shapeBounds(shape);
+        bounds.expand(shapeBounds(newShape));
+        // meshes have no bounds to test against
+        if (bounds.surfaceArea() <= 0) {
+            diff.full = true;
+            return diff;
+        }
+        diff.changedBounds.push_back(bounds);
+    }
+    return diff;
+}
+
+/**
+ * @brief lightPathsCross: checks whether a box may now shadow a point, or no
+ * longer shadow it, from any light
+ * @param position: the point
+ * @param lights: the lights of the scene
+ * @param boxes: the boxes to test
+ * @return true if any light's shadow rays from the point may cross a box
+ */
+bool lightPathsCross(const glm::vec3 &position,
+                     const std::vector<SceneLightData> &lights,
+                     const std::vector<AABB> &boxes) {
+    for (const SceneLightData &light : lights) {
+        glm::vec3 direction;
+        float tMax = 1;
+        float lightRadius = 0;
+        if (light.type == LightType::LIGHT_DIRECTIONAL) {
+            direction = -glm::normalize(glm::vec3(light.dir));
+            tMax = FLT_MAX;
+        } else {
+            direction = glm::vec3(light.pos) - position;
+        }
+        if (light.type == LightType::LIGHT_AREA) {
+            // area light samples spread from the light position along each
+            // axis and along uvec and vvec, see phong
+            lightRadius = (light.width + light.height) * std::sqrt(3.f) +
+                          light.width * glm::length(light.uvec) +
+                          light.height * glm::length(light.vvec);
+        }
+
+        glm::vec3 inverseDirection = 1.f / direction;
+        for (AABB bounds : boxes) {
+            bounds.min -= glm::vec3(lightRadius);
+            bounds.max += glm::vec3(lightRadius);
+            if (bounds.intersects(position, inverseDirection, tMax))
+                return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief pathCrosses: follows a primary ray and its reflections through the
+ * scene, as traceRay and phong would at the start of the shutter
+ * @param position: starting position of the ray
+ * @param direction: direction of the ray
+ * @param scene: information about the scene
+ * @param config: configuration of the raytracer
+ * @param boxes: the boxes to test
+ * @return true if a segment of the path, or a shadow ray from one of its hits,
+ * may cross a box
+ */
+bool pathCrosses(glm::vec4 position, glm::vec4 direction,
+                 const RayTraceScene &scene, const RayTracer::Config &config,
+                 const std::vector<AABB> &boxes) {
+    // reflected rays start a little off the surface, which the tested
+    // segment has to include
+    glm::vec4 segmentStart = position;
+    float startOffset = 0;
+    for (int reflections = 0;; reflections++) {
+        float t;
+        int shapeIndex = findClosestHit(position, direction, scene, 0, t);
+        float tMax = shapeIndex >= 0 ? startOffset + t : FLT_MAX;
+        glm::vec3 inverseDirection = 1.f / glm::vec3(direction);
+        for (const AABB &bounds : boxes) {
+            if (bounds.intersects(glm::vec3(segmentStart), inverseDirection, tMax))
+                return true;
+        }
+        if (shapeIndex < 0 || config.onlyRenderNormals)
+            return false;
+
+        // without shadows, a point is lit the same whatever else is around
+        glm::vec4 hit = position + t * direction;
+        if (config.enableShadow && lightPathsCross(glm::vec3(hit), scene.getLights(), boxes))
+            return true;
+
+        const RenderShapeData &shape = scene.getShapes()[shapeIndex];
+        if (!config.enableReflection || reflections >= config.maxRecursiveDepth ||
+            glm::vec3(shape.primitive.material.cReflective) == glm::vec3(0))
+            return false;
+
+        // reflect as phong does
+        glm::vec4 normal =
+            glm::vec4(glm::normalize(shapeNormal(shape, position, direction, t, 0)), 0);
+        glm::vec4 directionToCamera = glm::normalize(-direction);
+        glm::vec4 reflectedRay =
+            2.f * glm::dot(directionToCamera, normal) * normal - directionToCamera;
+        float epsilon = pow(10, -1);
+        segmentStart = hit;
+        startOffset = epsilon;
+        position = hit + reflectedRay * epsilon;
+        direction = reflectedRay;
+    }
+}
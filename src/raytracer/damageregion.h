@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../utils/sceneparser.h"
+#include "bvh.h"
+#include "raytracer.h"
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class RayTraceScene;
+
+/**
+ * @brief The SceneDiff struct: what changed between two evaluations of a
+ * scene, e.g. before and after an edit of the scenefile or between two frames
+ * of an animation
+ */
+struct SceneDiff {
+    // whether every pixel may have changed, because the camera, the global
+    // coefficients, a light or the number of shapes changed
+    bool full = false;
+    // bounds of every changed shape, covering both where it was and where it
+    // is
+    std::vector<AABB> changedBounds;
+
+    bool empty() const { return !full && changedBounds.empty(); }
+};
+
+// Compares the shapes, lights, camera and global coefficients of two
+// evaluated scenes.
+SceneDiff diffScenes(const RenderData &before, const RenderData &after);
+
+// Whether two lights shade the same way.
+bool sameLight(const SceneLightData &a, const SceneLightData &b);
+
+// Whether a shadow ray from position towards any sample of any light may
+// cross one of the boxes.
+bool lightPathsCross(const glm::vec3 &position,
+                     const std::vector<SceneLightData> &lights,
+                     const std::vector<AABB> &boxes);
+
+// Whether the path of a primary ray, following its reflections, or a shadow
+// ray from any point along it may cross one of the boxes, i.e. whether a
+// change inside the boxes can change the color the ray returns.
+bool pathCrosses(glm::vec4 position, glm::vec4 direction,
+                 const RayTraceScene &scene, const RayTracer::Config &config,
+                 const std::vector<AABB> &boxes);
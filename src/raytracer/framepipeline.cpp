@@ -0,0 +1,80 @@
+#include "framepipeline.h"
+#include "../light/texturemanager.h"
+#include "../utils/renderconfig.h"
+#include "../utils/tracing.h"
+
+#include <QFileInfo>
+#include <QSettings>
+
+/**
+ * @brief FramePipeline::FramePipeline: starts loading the frames
+ * @param jobs: the frames to render, in order
+ * @param depth: how many loaded frames may wait for the renderer
+ */
+FramePipeline::FramePipeline(std::vector<FrameJob> jobs, int depth)
+    : m_jobs(std::move(jobs)), m_loaded((size_t)std::max(1, depth)) {
+    m_loader = std::thread(&FramePipeline::loadFrames, this);
+}
+
+/**
+ * @brief FramePipeline::~FramePipeline: stops the loader once it finishes the
+ * frame it is preparing
+ */
+FramePipeline::~FramePipeline() {
+    m_loaded.close();
+    m_loader.join();
+}
+
+/**
+ * @brief FramePipeline::next: takes the next loaded frame
+ * @return the frame, with its scene prepared if it has a new scenefile, or
+ * nothing after the last frame
+ */
+std::optional<FrameJob> FramePipeline::next() {
+    TRACE_SPAN("waitForLoadedFrame");
+    return m_loaded.pop();
+}
+
+/**
+ * @brief FramePipeline::loadFrames: prepares the scene of every frame whose
+ * scenefile differs from the previous frame's, and queues the frames in order
+ *
+ * A scenefile that fails to parse is left for renderFrame, which parses it
+ * again and reports the error.
+ */
+void FramePipeline::loadFrames() {
+    std::string previousPath;
+    QDateTime previousModified;
+    for (FrameJob job : m_jobs) {
+        QSettings settings(job.configPath, QSettings::IniFormat);
+        QString scenePath = settings.value("IO/scene").toString();
+        QDateTime modified = QFileInfo(scenePath).lastModified();
+        if (scenePath.toStdString() != previousPath || modified != previousModified) {
+            TRACE_SPAN("prepareScene", scenePath.toStdString());
+            previousPath = scenePath.toStdString();
+            previousModified = modified;
+
+            auto prepared = std::make_shared<PreparedScene>();
+            prepared->path = previousPath;
+            prepared->modified = modified;
+            if (SceneParser::parse(prepared->path, prepared->data)) {
+                float frame = job.frame >= 0 ? job.frame : settings.value("Settings/frame").toFloat();
+                if (SceneParser::isAnimated(prepared->data)) {
+                    SceneParser::evaluate(prepared->data, frame);
+                }
+                RayTracer::Config config = readRayTracerConfig(settings);
+                if (config.enableTextureMap) {
+                    preloadTextures(prepared->data);
+                }
+                prepared->scene = std::make_unique<RayTraceScene>(settings.value("Canvas/width").toInt(),
+                                                                  settings.value("Canvas/height").toInt(),
+                                                                  prepared->data);
+                prepared->scene->setAcceleration(config.enableAcceleration, config.bvhRebuildThreshold);
+                job.prepared = std::move(prepared);
+            }
+        }
+        if (!m_loaded.push(std::move(job)))
+            return;
+    }
+    m_loaded.close();
+}
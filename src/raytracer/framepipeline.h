@@ -0,0 +1,46 @@
+#pragma once
+
+#include "../utils/boundedqueue.h"
+#include "renderjob.h"
+
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief The FramePipeline class: overlaps the loading of the next frames of
+ * a batch with the render of the current one.
+ *
+ * A loader thread works through the frames in order. For each frame whose
+ * scenefile differs from the previous frame's, it parses the scene, evaluates
+ * its keyframes, decodes its textures into the texture cache and builds the
+ * scene and its BVH, then attaches the result to the frame, see
+ * PreparedScene. At most depth frames wait to be rendered, so the loader
+ * blocks, holding no more scenes than that, while rendering is the slower
+ * stage. Saving the image of the previous frame already happens in the
+ * background, see RenderJobContext::asyncSave, so parsing, rendering and
+ * encoding run at the same time.
+ */
+class FramePipeline {
+public:
+    // constructor starting the loader over jobs, with at most depth loaded
+    // frames waiting
+    FramePipeline(std::vector<FrameJob> jobs, int depth);
+
+    // stops the loader, dropping the frames it prepared
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+
+    // Waits for the next frame, in order. Returns nothing after the last.
+    std::optional<FrameJob> next();
+
+private:
+    // prepares the frames and queues them until done or closed
+    void loadFrames();
+
+    std::vector<FrameJob> m_jobs;
+    BoundedQueue<FrameJob> m_loaded;
+    std::thread m_loader;
+};
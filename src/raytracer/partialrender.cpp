@@ -0,0 +1,149 @@
+#include "partialrender.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// First line of a partial render file, bumped whenever its layout changes
+const char *PARTIAL_RENDER_MAGIC = "AETHERPARTIAL 1";
+
+/**
+ * @brief savePartialRender: writes the tiles of a shard
+ * @param path: the file to write
+ * @param key: what identifies the render, see renderCacheKey
+ * @param width: width of the whole image
+ * @param height: height of the whole image
+ * @param tiles: the tiles the shard rendered, as (x0, y0, x1, y1)
+ * @param imageData: the image the shard rendered its tiles in
+ * @return True if the file was written
+ */
+bool savePartialRender(const std::string &path, const std::string &key,
+                       int width, int height,
+                       const std::vector<glm::ivec4> &tiles,
+                       const RGBA *imageData) {
+    // write, then rename, so that a merge never reads a partly written file
+    std::string partialPath = path + ".part";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to open partial render for writing: " << path << std::endl;
+            return false;
+        }
+        out << PARTIAL_RENDER_MAGIC << "\n"
+            << key << "\n"
+            << width << " " << height << " " << tiles.size() << "\n";
+        for (const glm::ivec4 &tile : tiles) {
+            out << tile.x << " " << tile.y << " " << tile.z << " " << tile.w << "\n";
+        }
+
+        // the 8-bit pixels, row by row in tile order, exactly as the image
+        // of a single process would hold them
+        for (const glm::ivec4 &tile : tiles) {
+            for (int j = tile.y; j < tile.w; ++j) {
+                out.write(reinterpret_cast<const char *>(imageData + j * width + tile.x),
+                          (std::streamsize)((tile.z - tile.x) * sizeof(RGBA)));
+            }
+        }
+        out.flush();
+        if (!out) {
+            out.close();
+            std::remove(partialPath.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(partialPath, path, error);
+    return !error;
+}
+
+/**
+ * @brief mergePartialRenders: assembles the shards of an image
+ * @param paths: the partial render files, in any order
+ * @param imageData: filled with the assembled image
+ * @param width: set to the width of the image
+ * @param height: set to the height of the image
+ * @return True if every pixel was rendered by exactly one render, or by
+ * several that agree on it
+ */
+bool mergePartialRenders(const std::vector<std::string> &paths,
+                         std::vector<RGBA> &imageData, int &width, int &height) {
+    std::string firstKey;
+    std::vector<char> covered;
+    for (const std::string &path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        std::string magic, key;
+        int partWidth = 0, partHeight = 0;
+        size_t tileCount = 0;
+        std::getline(in, magic);
+        std::getline(in, key);
+        in >> partWidth >> partHeight >> tileCount;
+        if (!in || magic != PARTIAL_RENDER_MAGIC || partWidth <= 0 || partHeight <= 0) {
+            std::cerr << "Error: \"" << path << "\" is not a partial render" << std::endl;
+            return false;
+        }
+
+        if (covered.empty()) {
+            firstKey = key;
+            width = partWidth;
+            height = partHeight;
+            imageData.assign((size_t)width * height, RGBA{0, 0, 0, 255});
+            covered.assign((size_t)width * height, 0);
+        } else if (key != firstKey || partWidth != width || partHeight != height) {
+            std::cerr << "Error: \"" << path << "\" is a part of another render than \""
+                      << paths[0] << "\"" << std::endl;
+            return false;
+        }
+
+        std::vector<glm::ivec4> tiles(tileCount);
+        for (glm::ivec4 &tile : tiles) {
+            in >> tile.x >> tile.y >> tile.z >> tile.w;
+            if (tile.x < 0 || tile.y < 0 || tile.z > width || tile.w > height ||
+                tile.x > tile.z || tile.y > tile.w) {
+                std::cerr << "Error: \"" << path << "\" has a tile outside the image" << std::endl;
+                return false;
+            }
+        }
+        in.ignore(1);
+
+        std::vector<RGBA> row;
+        for (const glm::ivec4 &tile : tiles) {
+            row.resize(tile.z - tile.x);
+            for (int j = tile.y; j < tile.w; ++j) {
+                in.read(reinterpret_cast<char *>(row.data()),
+                        (std::streamsize)(row.size() * sizeof(RGBA)));
+                if (!in) {
+                    std::cerr << "Error: \"" << path << "\" is truncated" << std::endl;
+                    return false;
+                }
+                for (int i = tile.x; i < tile.z; ++i) {
+                    int index = j * width + i;
+                    const RGBA &pixel = row[i - tile.x];
+                    // overlapping regions are fine as long as they agree, which
+                    // they do when rendered from the same inputs
+                    if (covered[index] && (imageData[index].r != pixel.r ||
+                                           imageData[index].g != pixel.g ||
+                                           imageData[index].b != pixel.b)) {
+                        std::cerr << "Error: \"" << path << "\" disagrees with another part on pixel ("
+                                  << i << ", " << j << ")" << std::endl;
+                        return false;
+                    }
+                    imageData[index] = pixel;
+                    covered[index] = 1;
+                }
+            }
+        }
+    }
+
+    if (covered.empty()) {
+        std::cerr << "Error: no partial renders to merge" << std::endl;
+        return false;
+    }
+    size_t missing = std::count(covered.begin(), covered.end(), 0);
+    if (missing > 0) {
+        std::cerr << "Error: " << missing << " pixels are in none of the partial renders" << std::endl;
+        return false;
+    }
+    return true;
+}
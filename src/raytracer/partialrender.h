@@ -0,0 +1,22 @@
+#pragma once
+
+#include "../utils/rgba.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+// Writes the pixels of the tiles a shard rendered, see RayTracer::Shard,
+// along with the key of the render (see renderCacheKey) and the size of the
+// whole image. Returns whether the file was written.
+bool savePartialRender(const std::string &path, const std::string &key,
+                       int width, int height,
+                       const std::vector<glm::ivec4> &tiles,
+                       const RGBA *imageData);
+
+// Assembles the partial renders of one image into imageData, which is resized
+// to the image. Fails if the partials are of different renders, disagree on a
+// pixel or leave pixels uncovered. Returns whether the image is complete.
+bool mergePartialRenders(const std::vector<std::string> &paths,
+                         std::vector<RGBA> &imageData, int &width, int &height);
@@ -1,11 +1,26 @@
 #include "raytracer.h"
 #include "../lenses/lenseassemblies.h"
 #include "../singleraytrace/tracesingleray.h"
+#include "aovbuffers.h"
+#include "costheatmap.h"
+#include "damageregion.h"
 #include "raytracescene.h"
+#include "rendercheckpoint.h"
+#include "temporalcache.h"
+#include "../utils/pixelrandom.h"
+#include "../utils/tracing.h"
+#include <QtConcurrent>
+#include <algorithm>
 #include <cfloat>
 #include <cmath>
+#include <cstdint>
+#include <numeric>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
 
 /**
  * @brief RayTracer::RayTracer: constructor for the ray tracer class that sets
@@ -14,9 +29,68 @@
  */
 RayTracer::RayTracer(Config config) : m_config(config) {}
 
-void RayTracer::render(RGBA *imageData, const RayTraceScene &scene) {
-    // note that 'data' is a pointer, can access elements like 'data[i]'
+/**
+ * @brief RayTracer::setProgress: sets how the next renders report progress and
+ * learn that they were cancelled
+ * @param progress: if set, called from the render threads after each tile
+ * @param cancelled: if not null, checked before each tile, which is skipped
+ * once it is set
+ */
+void RayTracer::setProgress(ProgressCallback progress, const std::atomic<bool> *cancelled) {
+    m_progress = std::move(progress);
+    m_cancelled = cancelled;
+}
+
+/**
+ * @brief RayTracer::setCheckpoint: sets the checkpoint the next renders resume
+ * from and record their progress in
+ * @param checkpoint: if not null, its finished tiles are skipped and the
+ * tiles rendered are marked as finished in it
+ */
+void RayTracer::setCheckpoint(RenderCheckpoint *checkpoint) {
+    m_checkpoint = checkpoint;
+}
+
+/**
+ * @brief RayTracer::Shard::whole: checks whether the shard is the whole image
+ * @return True if every tile belongs to the shard
+ */
+bool RayTracer::Shard::whole() const {
+    return count <= 1 && region.x <= 0 && region.y <= 0 && region.z == INT_MAX &&
+           region.w == INT_MAX;
+}
+
+/**
+ * @brief RayTracer::setShard: sets the part of the image the next renders
+ * render
+ * @param shard: the region and the slice of its tiles to render
+ */
+void RayTracer::setShard(const Shard &shard) {
+    m_shard = shard;
+}
 
+/**
+ * @brief RayTracer::setPrimitiveCosts: sets whether the next renders count
+ * the work done for each shape
+ * @param primitiveCosts: true to fill RenderStats::primitiveCosts
+ */
+void RayTracer::setPrimitiveCosts(bool primitiveCosts) {
+    m_primitiveCosts = primitiveCosts;
+}
+
+/**
+ * @brief generatePrimaryRay: computes the camera ray through a point on the
+ * image and sends it through the lens assembly
+ * @param scene: the scene being rendered
+ * @param x: horizontal image coordinate in pixels, pixel i has its center at
+ * i + 0.5
+ * @param y: vertical image coordinate in pixels, pixel j has its center at
+ * j + 0.5
+ * @return the world space position and direction of the ray as well as a
+ * boolean indicating if the ray passed through the lenses
+ */
+std::tuple<glm::vec4, glm::vec4, bool>
+generatePrimaryRay(const RayTraceScene &scene, float x, float y) {
     // define constants for future computation
     // note that here, k is the depth
     int k = 1;
@@ -25,76 +99,455 @@ void RayTracer::render(RGBA *imageData, const RayTraceScene &scene) {
     // using aspect ratio to get the width of the view plane
     float viewPlaneWidth = scene.getCamera().getAspectRatio() * viewPlaneHeight;
 
-    const int samplesPerPixel = 100;
-    // iterate through each pixel and trace a ray
-
-    for (int j = 0; j < scene.height(); ++j) {
-        for (int i = 0; i < scene.width(); ++i) {
-            // relevant formula: y = viewPlaneHeight * (((H - 1 - j +
-            // 0.5) / H) - 0.5)
-            float y = viewPlaneHeight *
-                      (((scene.height() - 1.f - j + 0.5f) / scene.height()) - 0.5f);
-            // relevant formula: x = viewPlaneWidth * (((i + 0.5) / W) -
-            // 0.5)
-            float x = viewPlaneWidth * ((i + 0.5f) / scene.width() - 0.5f);
-
-            // get uvk, eye, and d in homogenous coordinates
-            glm::vec4 uvk = glm::vec4(x, y, -k, 1);
-            glm::vec4 eye = glm::vec4(0, 0, 0, 1);
-            glm::vec4 direction = uvk - eye;
-            glm::vec4 accumulatedColor = glm::vec4(0, 0, 0, 255);
-
-            // move lens through the lens assembly, switching z direction to move to
-            // camera lens space
-            direction.z *= -1.f;
-            auto [newDirection, newPosition, inLens] =
-                computeLensesAdjustedDirection(direction);
-            if (inLens) { // if ray within the lens, trace it
-                direction = glm::vec4(newDirection, 0);
-                // convert back to regular camera space
-                direction.z *= -1.f;
-                eye = glm::vec4(newPosition, 1);
-                // convert back to regular camera space
-                eye.z *= -1.f;
-
-                // transform the ray into world space from camera space
-                glm::vec4 transformedEye =
-                    scene.getCamera().getViewMatrixInverse() * eye;
-                glm::vec4 transformedD =
-                    scene.getCamera().getViewMatrixInverse() * direction;
-
-                // trace the ray and set the correct image value
-                for (int k = 0; k < samplesPerPixel; k++) {
-                    float open = (float)(k) / (float)samplesPerPixel;
-                    float close = (float)(k + 1) / (float)samplesPerPixel;
-                    double rayTime =
-                        open +
-                                     (static_cast<double>(arc4random()) / RAND_MAX) * (close - open);
-                    RGBA color = traceRay(transformedEye, transformedD, scene, m_config,
-                                          0, rayTime);
-                    accumulatedColor.r += color.r;
-                    accumulatedColor.b += color.b;
-                    accumulatedColor.g += color.g;
+    // relevant formula: y = viewPlaneHeight * (((H - 1 - j + 0.5) / H) - 0.5)
+    float viewPlaneY =
+        viewPlaneHeight * (((scene.height() - y) / scene.height()) - 0.5f);
+    // relevant formula: x = viewPlaneWidth * (((i + 0.5) / W) - 0.5)
+    float viewPlaneX = viewPlaneWidth * (x / scene.width() - 0.5f);
+
+    // get uvk, eye, and d in homogenous coordinates
+    glm::vec4 uvk = glm::vec4(viewPlaneX, viewPlaneY, -k, 1);
+    glm::vec4 eye = glm::vec4(0, 0, 0, 1);
+    glm::vec4 direction = uvk - eye;
+
+    // move lens through the lens assembly, switching z direction to move to
+    // camera lens space
+    direction.z *= -1.f;
+    auto [newDirection, newPosition, inLens] =
+        computeLensesAdjustedDirection(direction);
+    if (!inLens)
+        return {glm::vec4(0), glm::vec4(0), false};
+
+    direction = glm::vec4(newDirection, 0);
+    // convert back to regular camera space
+    direction.z *= -1.f;
+    eye = glm::vec4(newPosition, 1);
+    // convert back to regular camera space
+    eye.z *= -1.f;
+
+    // transform the ray into world space from camera space
+    return {scene.getCamera().getViewMatrixInverse() * eye,
+            scene.getCamera().getViewMatrixInverse() * direction, true};
+}
+
+/**
+ * @brief screenSpaceMotion: estimates how far a moving hit point travels on the
+ * image over the shutter interval
+ * @param scene: the scene being rendered
+ * @param i: column of the pixel the hit was seen through
+ * @param j: row of the pixel the hit was seen through
+ * @param hitInfo: the hit, including its world space velocity
+ * @return the motion in pixels, positive x to the right and positive y down
+ *
+ * The lens assembly makes the camera projection non-linear, so the motion is
+ * found by expressing the velocity in terms of how the rays of neighboring
+ * pixels spread at the depth of the hit.
+ */
+glm::vec2 screenSpaceMotion(const RayTraceScene &scene, int i, int j,
+                            const RayHitInfo &hitInfo) {
+    if (hitInfo.velocity == glm::vec3(0))
+        return glm::vec2(0);
+
+    // point on a pixel ray at the camera space depth of the hit
+    glm::mat4 view = scene.getCamera().getViewMatrix();
+    float hitDepth = (view * glm::vec4(hitInfo.position, 1)).z;
+    auto pointAtHitDepth = [&](float x, float y, glm::vec3 &point) {
+        auto [position, direction, inLens] = generatePrimaryRay(scene, x, y);
+        glm::vec4 cameraPosition = view * position;
+        glm::vec4 cameraDirection = view * direction;
+        if (!inLens || cameraDirection.z == 0)
+            return false;
+        float t = (hitDepth - cameraPosition.z) / cameraDirection.z;
+        point = glm::vec3(position + t * direction);
+        return true;
+    };
+
+    glm::vec3 center, right, down;
+    if (!pointAtHitDepth(i + 0.5f, j + 0.5f, center) ||
+        !pointAtHitDepth(i + 1.5f, j + 0.5f, right) ||
+        !pointAtHitDepth(i + 0.5f, j + 1.5f, down))
+        return glm::vec2(0);
+
+    // solve velocity = a * dx + b * dy in the least squares sense
+    glm::vec3 dx = right - center;
+    glm::vec3 dy = down - center;
+    glm::mat2 normalMatrix(glm::dot(dx, dx), glm::dot(dx, dy), glm::dot(dx, dy),
+                           glm::dot(dy, dy));
+    if (glm::determinant(normalMatrix) == 0)
+        return glm::vec2(0);
+    return glm::inverse(normalMatrix) *
+           glm::vec2(glm::dot(dx, hitInfo.velocity),
+                     glm::dot(dy, hitInfo.velocity));
+}
+
+/**
+ * @brief shutterStratumStride: picks the step used to walk the shutter strata
+ * of a pixel, the integer closest to samplesPerPixel / golden ratio that is
+ * coprime with samplesPerPixel, so every stratum is still visited exactly once
+ * @param samplesPerPixel: the number of strata
+ * @return the stride
+ */
+int shutterStratumStride(int samplesPerPixel) {
+    int stride = std::max(1, (int)std::lround(samplesPerPixel * 0.618034));
+    while (std::gcd(stride, samplesPerPixel) != 1)
+        stride++;
+    return stride;
+}
+
+/**
+ * @brief RayTracer::renderPixel: traces every sample of a single pixel
+ * @param imageData: the image being filled
+ * @param scene: the scene to render
+ * @param aovs: if not null, filled with the auxiliary outputs of the pixel
+ * @param heatmap: if not null, filled with the cost of the pixel
+ * @param temporalCache: if not null, the pixel reuses the previous frame's
+ * result when it can and records its own for the next frame
+ * @param i: column of the pixel
+ * @param j: row of the pixel
+ */
+void RayTracer::renderPixel(RGBA *imageData, const RayTraceScene &scene,
+                            AOVBuffers *aovs, CostHeatmap *heatmap,
+                            TemporalCache *temporalCache, int i, int j) const {
+    const int samplesPerPixel = std::max(1, m_config.samplesPerPixel);
+    const int shutterStride = shutterStratumStride(samplesPerPixel);
+    const bool adaptive = m_config.adaptiveThreshold > 0;
+    glm::mat4 view = scene.getCamera().getViewMatrix();
+
+    glm::vec4 accumulatedColor = glm::vec4(0, 0, 0, 255);
+    int index = j * scene.width() + i;
+    seedPixelRandom(m_config.seed, (std::uint32_t)index);
+    // imageData may only hold the rows from m_firstRow on, see renderRows
+    RGBA &output = imageData[index - m_firstRow * scene.width()];
+    std::uint64_t pixelCostBegin =
+        heatmap != nullptr ? heatmap->beginPixel() : 0;
+
+    auto [transformedEye, transformedD, inLens] =
+        generatePrimaryRay(scene, i + 0.5f, j + 0.5f);
+
+    // find the point the pixel sees, and reuse the previous frame's result
+    // if it saw the same one
+    int cacheShape = -1;
+    glm::vec3 cachePosition = glm::vec3(0);
+    float cacheFootprint = 0;
+    if (temporalCache != nullptr && aovs == nullptr && inLens) {
+        float t;
+        cacheShape = findClosestHit(transformedEye, transformedD, scene, 0, t);
+        if (cacheShape >= 0) {
+            cachePosition = glm::vec3(transformedEye + t * transformedD);
+            // the lens assembly bends the rays, so the size of the pixel at
+            // the point is its distance to the ray of the next pixel
+            auto [nextEye, nextD, nextInLens] = generatePrimaryRay(scene, i + 1.5f, j + 0.5f);
+            if (nextInLens) {
+                cacheFootprint = glm::length(glm::cross(cachePosition - glm::vec3(nextEye),
+                                                        glm::normalize(glm::vec3(nextD))));
+            }
+            RGBA radiance;
+            int age;
+            if (temporalCache->lookup(cacheShape, glm::vec3(transformedEye),
+                                      cachePosition, radiance, age)) {
+                RENDER_STAT(reusedPixels++);
+                output = radiance;
+                temporalCache->store(index, cacheShape, cachePosition, cacheFootprint,
+                                     radiance, age + 1);
+                if (heatmap != nullptr)
+                    heatmap->endPixel(index, pixelCostBegin);
+                return;
+            }
+        }
+    }
+
+    if (inLens) { // if ray within the lens, trace it
+        RENDER_STAT(pixels++);
+        // running sums of the sample luma, for adaptive sampling
+        float lumaSum = 0;
+        float lumaSquaredSum = 0;
+        int samplesTaken = 0;
+
+        // trace the ray and set the correct image value
+        for (int k = 0; k < samplesPerPixel; k++) {
+            double rayTime;
+            if (m_config.stratifiedTime) {
+                // visit the shutter strata in a strided order so that a pixel
+                // stopped early by adaptive sampling still covers the shutter
+                int stratum = (int)(((long long)k * shutterStride) % samplesPerPixel);
+                float open = (float)(stratum) / (float)samplesPerPixel;
+                float close = (float)(stratum + 1) / (float)samplesPerPixel;
+                rayTime = open + pixelRandom() * (close - open);
+            } else {
+                rayTime = pixelRandom();
+            }
+            RENDER_STAT(primaryRays++);
+            RENDER_STAT(samples++);
+            RayHitInfo hitInfo;
+            RGBA color = traceRay(transformedEye, transformedD, scene, m_config,
+                                  0, rayTime, aovs != nullptr ? &hitInfo : nullptr);
+            accumulatedColor.r += color.r;
+            accumulatedColor.b += color.b;
+            accumulatedColor.g += color.g;
+            samplesTaken++;
+
+            // record the auxiliary outputs of the sample
+            if (aovs != nullptr && hitInfo.hit) {
+                aovs->addSample(
+                    index, hitInfo,
+                    -(view * glm::vec4(hitInfo.position, 1)).z,
+                    scene.getMaterialIds()[hitInfo.shapeIndex],
+                    screenSpaceMotion(scene, i, j, hitInfo));
+            } else if (aovs != nullptr) {
+                aovs->addEmptySample(index);
+            }
+
+            // stop once the standard error of the mean luma is below the
+            // threshold, checking every few samples
+            if (adaptive) {
+                float sampleLuma = 0.299f * color.r + 0.587f * color.g + 0.114f * color.b;
+                lumaSum += sampleLuma;
+                lumaSquaredSum += sampleLuma * sampleLuma;
+                if (samplesTaken >= m_config.adaptiveMinSamples && samplesTaken % 4 == 0) {
+                    float mean = lumaSum / samplesTaken;
+                    float variance = std::max(0.f, lumaSquaredSum / samplesTaken - mean * mean);
+                    if (std::sqrt(variance / samplesTaken) < m_config.adaptiveThreshold)
+                        break;
                 }
+            }
+        }
+
+        accumulatedColor /= (float)(samplesTaken);
+        RGBA finalColor;
+        for (int i = 0; i < 3; i++) {
+            accumulatedColor[i] =
+                (int)std::min(255.f, std::max(0.f, accumulatedColor[i]));
+        }
+        finalColor.r = accumulatedColor.r;
+        finalColor.g = accumulatedColor.g;
+        finalColor.b = accumulatedColor.b;
+        finalColor.a = 255;
+
+        // trace the ray and set the correct image value
+        output = finalColor;
+
+    } else {
+        // set the color to white if ray is outside of the camera
+        output = RGBA{255, 255, 255};
+    }
 
-                accumulatedColor /= (float)(samplesPerPixel);
-                RGBA finalColor;
-                for (int i = 0; i < 3; i++) {
-                    accumulatedColor[i] =
-                        (int)std::min(255.f, std::max(0.f, accumulatedColor[i]));
+    if (temporalCache != nullptr)
+        temporalCache->store(index, cacheShape, cachePosition, cacheFootprint,
+                             output, 0);
+    if (aovs != nullptr)
+        aovs->resolve(index);
+    if (heatmap != nullptr)
+        heatmap->endPixel(index, pixelCostBegin);
+}
+
+/**
+ * @brief RayTracer::splitIntoTiles: splits the image into square tiles, which
+ * are the unit of work handed to the threads when parallelism is enabled
+ * @param scene: the scene to render
+ * @return the tiles, as (x0, y0, x1, y1) with x1 and y1 exclusive
+ */
+std::vector<glm::ivec4> RayTracer::splitIntoTiles(const RayTraceScene &scene) const {
+    int tileSize = std::max(1, m_config.tileSize);
+    std::vector<glm::ivec4> tiles;
+    for (int y = 0; y < scene.height(); y += tileSize) {
+        for (int x = 0; x < scene.width(); x += tileSize) {
+            tiles.push_back(glm::ivec4(x, y, std::min(x + tileSize, scene.width()),
+                                       std::min(y + tileSize, scene.height())));
+        }
+    }
+    return tiles;
+}
+
+/**
+ * @brief RayTracer::shardTiles: picks the tiles of the shard
+ * @param scene: the scene to render
+ * @return the tiles of the image inside the shard's region, clipped to it,
+ * keeping every count-th one from the index-th
+ *
+ * Tiles are dealt out in turn rather than in blocks, so that each shard gets
+ * a share of the expensive parts of the image.
+ */
+std::vector<glm::ivec4> RayTracer::shardTiles(const RayTraceScene &scene) const {
+    std::vector<glm::ivec4> tiles = splitIntoTiles(scene);
+    if (m_shard.whole())
+        return tiles;
+
+    std::vector<glm::ivec4> shard;
+    int inRegion = 0;
+    for (const glm::ivec4 &tile : tiles) {
+        glm::ivec4 clipped(std::max(tile.x, m_shard.region.x), std::max(tile.y, m_shard.region.y),
+                           std::min(tile.z, m_shard.region.z), std::min(tile.w, m_shard.region.w));
+        if (clipped.x >= clipped.z || clipped.y >= clipped.w)
+            continue;
+        if (inRegion++ % std::max(1, m_shard.count) == m_shard.index)
+            shard.push_back(clipped);
+    }
+    return shard;
+}
+
+/**
+ * @brief RayTracer::renderTiles: renders some tiles of the image
+ * @param imageData: the image being filled
+ * @param scene: the scene to render
+ * @param tiles: the tiles to render
+ * @param aovs: if not null, filled with the auxiliary outputs of the tiles
+ * @param heatmap: if not null, filled with the cost of the tiles
+ * @param temporalCache: if not null, used and filled by every pixel
+ */
+void RayTracer::renderTiles(RGBA *imageData, const RayTraceScene &scene,
+                            std::vector<glm::ivec4> &tiles, AOVBuffers *aovs,
+                            CostHeatmap *heatmap, TemporalCache *temporalCache) {
+    // iterate through each pixel of a tile and trace a ray
+    std::atomic<int> tilesDone = 0;
+    m_stats = RenderStats{};
+    std::mutex statsMutex;
+    auto renderTile = [&](const glm::ivec4 &tile) {
+        if (m_cancelled != nullptr && m_cancelled->load(std::memory_order_relaxed))
+            return;
+        // a tile restored from a checkpoint already holds its final pixels
+        if (m_checkpoint == nullptr || !m_checkpoint->isDone(tile)) {
+            TRACE_SPAN_LAZY("tile", std::to_string(tile.x) + "," + std::to_string(tile.y));
+#ifdef AETHER_RENDER_STATS
+            // the tile counts on its own, then adds its counts to the render's
+            RenderStats tileStats;
+            if (m_primitiveCosts)
+                tileStats.primitiveCosts.resize(scene.getShapes().size());
+            RenderStatsScope statsScope(tileStats);
+#endif
+            for (int j = tile.y; j < tile.w; ++j) {
+                for (int i = tile.x; i < tile.z; ++i) {
+                    renderPixel(imageData, scene, aovs, heatmap, temporalCache, i, j);
                 }
-                finalColor.r = accumulatedColor.r;
-                finalColor.g = accumulatedColor.g;
-                finalColor.b = accumulatedColor.b;
-                finalColor.a = 255;
+            }
+#ifdef AETHER_RENDER_STATS
+            {
+                std::lock_guard<std::mutex> lock(statsMutex);
+                m_stats.merge(tileStats);
+            }
+#endif
+            if (m_checkpoint != nullptr)
+                m_checkpoint->markDone(tile, imageData);
+        }
+        int done = ++tilesDone;
+        if (m_progress)
+            m_progress(done, (int)tiles.size());
+    };
+
+    if (m_config.enableParallelism) {
+        QtConcurrent::blockingMap(tiles, renderTile);
+    } else {
+        for (const glm::ivec4 &tile : tiles) {
+            renderTile(tile);
+        }
+    }
+}
 
-                // trace the ray and set the correct image value
-                imageData[j * scene.width() + i] = finalColor;
+void RayTracer::render(RGBA *imageData, const RayTraceScene &scene,
+                       AOVBuffers *aovs, CostHeatmap *heatmap,
+                       TemporalCache *temporalCache) {
+    // note that 'data' is a pointer, can access elements like 'data[i]'
+    TRACE_SPAN("render");
+    if (temporalCache != nullptr)
+        temporalCache->beginFrame(scene);
 
-            } else {
-                // set the color to white if ray is outside of the camera
-                imageData[j * scene.width() + i] = RGBA{255, 255, 255};
+    std::vector<glm::ivec4> tiles = shardTiles(scene);
+    renderTiles(imageData, scene, tiles, aovs, heatmap, temporalCache);
+
+    if (temporalCache != nullptr)
+        temporalCache->endFrame();
+}
+
+/**
+ * @brief RayTracer::renderRows: renders a band of rows into a buffer of its
+ * own, for images too large to hold in memory at once
+ * @param rowData: filled with the rows, the first row at rowData[0]
+ * @param scene: the scene to render
+ * @param firstRow: the first row of the band
+ * @param lastRow: the row after the last one of the band
+ */
+void RayTracer::renderRows(RGBA *rowData, const RayTraceScene &scene, int firstRow,
+                           int lastRow) {
+    TRACE_SPAN_LAZY("renderRows", std::to_string(firstRow));
+    int tileSize = std::max(1, m_config.tileSize);
+    std::vector<glm::ivec4> tiles;
+    for (int y = firstRow; y < lastRow; y += tileSize) {
+        for (int x = 0; x < scene.width(); x += tileSize) {
+            tiles.push_back(glm::ivec4(x, y, std::min(x + tileSize, scene.width()),
+                                       std::min(y + tileSize, lastRow)));
+        }
+    }
+
+    // checkpoints index the whole image, which rowData is not
+    RenderCheckpoint *checkpoint = std::exchange(m_checkpoint, nullptr);
+    RenderStats previousStats = m_stats;
+    m_firstRow = firstRow;
+    renderTiles(rowData, scene, tiles, nullptr, nullptr, nullptr);
+    m_firstRow = 0;
+    m_checkpoint = checkpoint;
+
+    // the statistics cover every band since the one at the top
+    if (firstRow > 0) {
+        previousStats.merge(m_stats);
+        m_stats = previousStats;
+    }
+}
+
+/**
+ * @brief RayTracer::renderDamage: re-renders the tiles a change to the scene
+ * can reach, leaving the rest of the image as it was
+ * @param imageData: the image of the scene before the change, updated in place
+ * @param scene: the scene after the change
+ * @param diff: what changed, see diffScenes
+ * @return the number of tiles that were rendered
+ */
+int RayTracer::renderDamage(RGBA *imageData, const RayTraceScene &scene,
+                            const SceneDiff &diff) {
+    TRACE_SPAN("renderDamage");
+    std::vector<glm::ivec4> tiles = splitIntoTiles(scene);
+    if (!diff.full) {
+        // the probe only follows rays at the start of the shutter, so a shape
+        // moving over it counts as changed everywhere it goes
+        std::vector<AABB> boxes = diff.changedBounds;
+        if (!boxes.empty()) {
+            for (const RenderShapeData &shape : scene.getShapes()) {
+                if (shape.primitive.type == PrimitiveType::PRIMITIVE_SPHERE_MOVING ||
+                    shape.primitive.type == PrimitiveType::PRIMITIVE_CUBE_MOVING ||
+                    shape.primitive.type == PrimitiveType::PRIMITIVE_CONE_MOVING ||
+                    shape.primitive.type == PrimitiveType::PRIMITIVE_CYLINDER_MOVING)
+                    boxes.push_back(shapeBounds(shape));
             }
         }
+
+        // a tile is damaged as soon as the path of one of its pixels can
+        // reach a changed shape
+        auto undamaged = [&](const glm::ivec4 &tile) {
+            for (int j = tile.y; j < tile.w; ++j) {
+                for (int i = tile.x; i < tile.z; ++i) {
+                    auto [position, direction, inLens] =
+                        generatePrimaryRay(scene, i + 0.5f, j + 0.5f);
+                    if (inLens && pathCrosses(position, direction, scene, m_config, boxes))
+                        return false;
+                }
+            }
+            return true;
+        };
+        if (boxes.empty()) {
+            tiles.clear();
+        } else if (m_config.enableParallelism) {
+            QtConcurrent::blockingFilter(tiles, [&](const glm::ivec4 &tile) {
+                return !undamaged(tile);
+            });
+        } else {
+            std::erase_if(tiles, undamaged);
+        }
     }
+
+    renderTiles(imageData, scene, tiles, nullptr, nullptr, nullptr);
+    return (int)tiles.size();
 }
+
+/**
+ * @brief RayTracer::getStats: getter for the m_stats field
+ * @return the statistics of the last render
+ */
+const RenderStats &RayTracer::getStats() const { return m_stats; }
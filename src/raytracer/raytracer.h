@@ -2,12 +2,25 @@
 
 #include <glm/glm.hpp>
 
+#include "../utils/renderstats.h"
 #include "../utils/rgba.h"
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <functional>
 #include <random>
+#include <tuple>
+#include <vector>
 
-// A forward declaration for the RaytraceScene class
+// Forward declarations for the RaytraceScene, AOVBuffers, CostHeatmap,
+// TemporalCache and RenderCheckpoint classes and the SceneDiff struct
 
 class RayTraceScene;
+class AOVBuffers;
+class CostHeatmap;
+class TemporalCache;
+class RenderCheckpoint;
+struct SceneDiff;
 
 // A class representing a ray-tracer
 
@@ -25,17 +38,131 @@ public:
         bool enableDepthOfField = false;
         int maxRecursiveDepth = 4;
         bool onlyRenderNormals = false;
+        // side length in pixels of the tiles the image is rendered in
+        int tileSize = 32;
+        // samples per pixel; each gets its own stratum of the shutter when
+        // stratifiedTime is set, and a uniformly random time otherwise
+        int samplesPerPixel = 100;
+        bool stratifiedTime = true;
+        // area lights are sampled once per cell of an areaLightGrid x
+        // areaLightGrid grid, jittered within the cell when
+        // stratifiedAreaLight is set and anywhere on the light otherwise
+        int areaLightGrid = 6;
+        bool stratifiedAreaLight = true;
+        // when above 0, a pixel stops sampling once the standard error of its
+        // mean luma (0-255) drops below this, after at least
+        // adaptiveMinSamples samples
+        float adaptiveThreshold = 0;
+        int adaptiveMinSamples = 16;
+        // with enableAcceleration, the BVH refit between animation frames is
+        // rebuilt once its SAH cost exceeds this times the cost after a build
+        float bvhRebuildThreshold = 1.5f;
+        // seed of the random numbers of the samples, see pixelRandom
+        std::uint32_t seed = 0;
+
+        bool operator==(const Config &) const = default;
     };
 
+    // The part of the image one of several processes renders: the tiles that
+    // overlap region, clipped to it, and of those every count-th starting at
+    // the index-th. The default shard is the whole image.
+    struct Shard {
+        glm::ivec4 region = glm::ivec4(0, 0, INT_MAX, INT_MAX);
+        int index = 0;
+        int count = 1;
+
+        bool whole() const;
+    };
+
+    // Called from the render threads each time a tile is done, with the
+    // number of tiles done and to render.
+    using ProgressCallback = std::function<void(int tilesDone, int tilesTotal)>;
+
 public:
     RayTracer(Config config);
 
+    // Reports the progress of the next renders, and skips their remaining
+    // tiles once cancelled is set. Either may be empty.
+    void setProgress(ProgressCallback progress, const std::atomic<bool> *cancelled);
+
+    // Makes the next renders skip the tiles the checkpoint has as finished,
+    // and record in it those they finish. May be null.
+    void setCheckpoint(RenderCheckpoint *checkpoint);
+
+    // Makes the next renders only render the tiles of a shard.
+    void setShard(const Shard &shard);
+
+    // Makes the next renders attribute their work to each shape, see
+    // RenderStats::primitiveCosts. Off by default, as it costs a table of
+    // every shape per tile.
+    void setPrimitiveCosts(bool primitiveCosts);
+
+    // Returns the tiles render() renders, those of the shard, as (x0, y0, x1,
+    // y1) with x1 and y1 exclusive.
+    std::vector<glm::ivec4> shardTiles(const RayTraceScene &scene) const;
+
     // Renders the scene synchronously.
-    // The ray-tracer will render the scene and fill imageData in-place.
+    // The ray-tracer will render the scene and fill imageData in-place, one
+    // tile at a time, spreading the tiles over the global thread pool when
+    // parallelism is enabled.
     // @param imageData The pointer to the imageData to be filled.
     // @param scene The scene to be rendered.
-    void render(RGBA *imageData, const RayTraceScene &scene);
+    // @param aovs If not null, filled with auxiliary outputs in the same pass.
+    // @param heatmap If not null, filled with the cost of each pixel.
+    // @param temporalCache If not null, pixels that see the same unchanged
+    // point as in the previous frame reuse its result.
+    void render(RGBA *imageData, const RayTraceScene &scene,
+                AOVBuffers *aovs = nullptr, CostHeatmap *heatmap = nullptr,
+                TemporalCache *temporalCache = nullptr);
+
+    // Renders the rows firstRow to lastRow (exclusive) into rowData, whose
+    // first row is firstRow, so that an image can be rendered band by band
+    // without holding all of it. Statistics add up over the bands of an image
+    // from the band at row 0. Shards, checkpoints, auxiliary outputs and the
+    // temporal cache do not apply.
+    void renderRows(RGBA *rowData, const RayTraceScene &scene, int firstRow,
+                    int lastRow);
+
+    // Re-renders only the tiles whose primary, reflection or shadow rays can
+    // reach what changed in the scene, leaving the rest of the image as the
+    // previous render left it. Returns the number of tiles rendered.
+    // @param imageData The image of the scene before the change.
+    // @param scene The scene after the change.
+    // @param diff What changed, see diffScenes.
+    int renderDamage(RGBA *imageData, const RayTraceScene &scene,
+                     const SceneDiff &diff);
+
+    // Returns the statistics of the last render, merged over all threads.
+    const RenderStats &getStats() const;
 
 private:
+    // Splits the image into tiles of tileSize pixels.
+    std::vector<glm::ivec4> splitIntoTiles(const RayTraceScene &scene) const;
+
+    // Renders the pixels of the tiles, spread over the global thread pool when
+    // parallelism is enabled.
+    void renderTiles(RGBA *imageData, const RayTraceScene &scene,
+                     std::vector<glm::ivec4> &tiles, AOVBuffers *aovs,
+                     CostHeatmap *heatmap, TemporalCache *temporalCache);
+
+    // Traces every sample of pixel (i, j) and writes its outputs.
+    void renderPixel(RGBA *imageData, const RayTraceScene &scene,
+                     AOVBuffers *aovs, CostHeatmap *heatmap,
+                     TemporalCache *temporalCache, int i, int j) const;
+
     const Config m_config;
+    RenderStats m_stats;
+    ProgressCallback m_progress;
+    const std::atomic<bool> *m_cancelled = nullptr;
+    RenderCheckpoint *m_checkpoint = nullptr;
+    Shard m_shard;
+    bool m_primitiveCosts = false;
+    // the row imageData starts at, see renderRows
+    int m_firstRow = 0;
 };
+
+// Computes the world space primary ray through the point (x, y) of the image,
+// given in pixels, after it passes through the lens assembly.
+// Returns the ray position, direction and whether it made it through the lenses.
+std::tuple<glm::vec4, glm::vec4, bool>
+generatePrimaryRay(const RayTraceScene &scene, float x, float y);
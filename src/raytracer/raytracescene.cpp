@@ -1,8 +1,26 @@
 #include "raytracescene.h"
 #include "../utils/sceneparser.h"
+#include "../utils/tracing.h"
 #include <iostream>
 #include <stdexcept>
 
+/**
+ * @brief sameMaterial: checks whether two materials shade identically
+ * @param a: a material to compare with b
+ * @param b: a material to compare with a
+ * @return true if every shading-relevant field matches, false otherwise
+ */
+bool sameMaterial(const SceneMaterial &a, const SceneMaterial &b) {
+    return a.cAmbient == b.cAmbient && a.cDiffuse == b.cDiffuse &&
+           a.cSpecular == b.cSpecular && a.shininess == b.shininess &&
+           a.cReflective == b.cReflective &&
+           a.cTransparent == b.cTransparent && a.ior == b.ior &&
+           a.blend == b.blend && a.textureMap.isUsed == b.textureMap.isUsed &&
+           a.textureMap.filename == b.textureMap.filename &&
+           a.textureMap.repeatU == b.textureMap.repeatU &&
+           a.textureMap.repeatV == b.textureMap.repeatV;
+}
+
 /**
  * @brief RayTraceScene::RayTraceScene: creates a class instance, sets the class
  * fields
@@ -12,6 +30,7 @@
  */
 RayTraceScene::RayTraceScene(int width, int height,
                              const RenderData &metaData) {
+    TRACE_SPAN("RayTraceScene");
     // set initial fields
     width_ = width;
     height_ = height;
@@ -26,6 +45,71 @@ RayTraceScene::RayTraceScene(int width, int height,
     // set remaning fields
     lights_ = metaData.lights;
     shapes_ = metaData.shapes;
+
+    // assign material IDs, reusing the ID of the first identical material
+    std::vector<const SceneMaterial *> uniqueMaterials;
+    for (const RenderShapeData &shape : shapes_) {
+        int id = 0;
+        while (id < (int)uniqueMaterials.size() &&
+               !sameMaterial(*uniqueMaterials[id], shape.primitive.material))
+            id++;
+        if (id == (int)uniqueMaterials.size())
+            uniqueMaterials.push_back(&shape.primitive.material);
+        materialIds_.push_back(id);
+    }
+}
+
+/**
+ * @brief RayTraceScene::updateAnimation: moves the scene to another frame
+ * without rebuilding it, copying only what keyframes can change
+ * @param metaData: the metadata the scene was built from, evaluated at the
+ * new frame
+ */
+void RayTraceScene::updateAnimation(const RenderData &metaData) {
+    TRACE_SPAN("RayTraceScene::updateAnimation");
+    const SceneCameraData &cameraData = metaData.cameraData;
+    camera_ = Camera(cameraData.pos, cameraData.look, cameraData.up,
+                     camera_.getAspectRatio(), cameraData.heightAngle);
+
+    for (const AnimatedNodeData &node : metaData.animatedNodes) {
+        for (int shape : node.shapes) {
+            shapes_[shape].ctm = metaData.shapes[shape].ctm;
+            shapes_[shape].inverseCTM = metaData.shapes[shape].inverseCTM;
+        }
+        for (int light : node.lights)
+            lights_[light] = metaData.lights[light];
+    }
+
+    // refitting keeps the tree, which is cheaper than a build until the
+    // shapes have moved far enough from where they were built
+    if (bvh_ && !metaData.animatedNodes.empty()) {
+        bvh_->refit(shapes_);
+        if (bvh_->needsRebuild(bvhRebuildThreshold_))
+            bvh_->build(shapes_);
+    }
+}
+
+/**
+ * @brief RayTraceScene::setAcceleration: builds or drops the BVH
+ * @param enabled: whether rays should traverse a BVH
+ * @param rebuildThreshold: SAH cost ratio past which a refit BVH is rebuilt
+ */
+void RayTraceScene::setAcceleration(bool enabled, float rebuildThreshold) {
+    bvhRebuildThreshold_ = rebuildThreshold;
+    if (!enabled) {
+        bvh_.reset();
+    } else if (!bvh_) {
+        bvh_.emplace();
+        bvh_->build(shapes_);
+    }
+}
+
+/**
+ * @brief RayTraceScene::getAcceleration: getter for the bvh_ field
+ * @return the BVH, or null if acceleration is disabled
+ */
+const BVH *RayTraceScene::getAcceleration() const {
+    return bvh_ ? &*bvh_ : nullptr;
 }
 
 /**
@@ -69,3 +153,11 @@ const std::vector<SceneLightData> &RayTraceScene::getLights() const {
 const std::vector<RenderShapeData> &RayTraceScene::getShapes() const {
     return shapes_;
 }
+
+/**
+ * @brief RayTraceScene::getMaterialIds: getter for the materialIds_ field
+ * @return the materialIds_ field of the class
+ */
+const std::vector<int> &RayTraceScene::getMaterialIds() const {
+    return materialIds_;
+}
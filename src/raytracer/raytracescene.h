@@ -2,9 +2,12 @@
 
 
 #include "../camera/camera.h"
+#include "bvh.h"
 #include "../utils/scenedata.h"
 #include "../utils/sceneparser.h"
 
+#include <optional>
+
 /**
  * @brief The RayTraceScene class: class for with scene information for raytracing purposes
  */
@@ -13,6 +16,19 @@ public:
     // constructor with information to set fields
     RayTraceScene(int width, int height, const RenderData &metaData);
 
+    // moves the camera, lights and animated shapes to those of metaData, the
+    // scene this was constructed from evaluated at another frame, refitting
+    // the BVH if there is one
+    void updateAnimation(const RenderData &metaData);
+
+    // builds a BVH over the shapes when enabled, or drops it; refits that
+    // make its SAH cost grow past rebuildThreshold times the cost after the
+    // build trigger a rebuild
+    void setAcceleration(bool enabled, float rebuildThreshold);
+
+    // The getter of the BVH over the shapes, null without acceleration
+    const BVH *getAcceleration() const;
+
     // The getter of the width of the scene
     const int &width() const;
 
@@ -31,6 +47,10 @@ public:
     // getter for shapes of the scene
     const std::vector<RenderShapeData> &getShapes() const;
 
+    // getter for the material ID of each shape, shapes with identical
+    // materials share an ID
+    const std::vector<int> &getMaterialIds() const;
+
 private:
     // width_: width of the scene
     int width_;
@@ -44,4 +64,10 @@ private:
     std::vector<SceneLightData> lights_;
     // shapes_: shapes in the scene
     std::vector<RenderShapeData> shapes_;
+    // materialIds_: material ID of each shape in shapes_
+    std::vector<int> materialIds_;
+    // bvh_: acceleration structure over shapes_, if enabled
+    std::optional<BVH> bvh_;
+    // bvhRebuildThreshold_: SAH cost ratio past which a refit BVH is rebuilt
+    float bvhRebuildThreshold_ = 1.5f;
 };
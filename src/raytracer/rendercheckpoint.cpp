@@ -0,0 +1,207 @@
+#include "rendercheckpoint.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// First line of a checkpoint file, bumped whenever its layout changes
+const char *CHECKPOINT_MAGIC = "AETHERCHECKPOINT 1";
+
+/**
+ * @brief RenderCheckpoint::RenderCheckpoint: creates the checkpoint of a
+ * render with no finished tile
+ * @param path: the checkpoint file
+ * @param key: what identifies the render, see renderCacheKey
+ * @param width: width of the image
+ * @param height: height of the image
+ * @param tileSize: side length of the tiles, see RayTracer::Config
+ * @param interval: seconds between saves while rendering, 0 for none
+ */
+RenderCheckpoint::RenderCheckpoint(std::string path, std::string key, int width,
+                                   int height, int tileSize, double interval)
+    : m_path(std::move(path)), m_key(std::move(key)), m_width(width),
+      m_height(height), m_tileSize(std::max(1, tileSize)), m_interval(interval) {
+    m_tilesX = (m_width + m_tileSize - 1) / m_tileSize;
+    m_tilesY = (m_height + m_tileSize - 1) / m_tileSize;
+    m_done.assign((size_t)m_tilesX * m_tilesY, 0);
+    m_lastSave = std::chrono::steady_clock::now();
+}
+
+/**
+ * @brief RenderCheckpoint::tileIndex: finds a tile in the order of
+ * RayTracer::splitIntoTiles
+ * @param tile: the tile, as (x0, y0, x1, y1)
+ * @return its index
+ */
+int RenderCheckpoint::tileIndex(const glm::ivec4 &tile) const {
+    return (tile.y / m_tileSize) * m_tilesX + tile.x / m_tileSize;
+}
+
+/**
+ * @brief RenderCheckpoint::tileAt: gets the pixels of a tile
+ * @param index: the index of the tile
+ * @return the tile, as (x0, y0, x1, y1) with x1 and y1 exclusive
+ */
+glm::ivec4 RenderCheckpoint::tileAt(int index) const {
+    int x = (index % m_tilesX) * m_tileSize;
+    int y = (index / m_tilesX) * m_tileSize;
+    return glm::ivec4(x, y, std::min(x + m_tileSize, m_width),
+                      std::min(y + m_tileSize, m_height));
+}
+
+int RenderCheckpoint::tileCount() const { return (int)m_done.size(); }
+
+const std::string &RenderCheckpoint::path() const { return m_path; }
+
+/**
+ * @brief RenderCheckpoint::restore: loads the finished tiles of the file
+ * @param imageData: the image, whose restored tiles are overwritten
+ * @return the number of tiles restored, 0 if the file is missing, damaged or
+ * was saved for another render
+ */
+int RenderCheckpoint::restore(RGBA *imageData) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ifstream in(m_path, std::ios::binary);
+    if (!in)
+        return 0;
+
+    std::string magic, key, done;
+    int width = 0, height = 0, tileSize = 0;
+    std::getline(in, magic);
+    std::getline(in, key);
+    in >> width >> height >> tileSize;
+    in.ignore(1);
+    std::getline(in, done);
+    if (!in || magic != CHECKPOINT_MAGIC || key != m_key || width != m_width ||
+        height != m_height || tileSize != m_tileSize || done.size() != m_done.size()) {
+        std::cerr << "Warning: ignoring checkpoint \"" << m_path
+                  << "\", which was saved for another render" << std::endl;
+        return 0;
+    }
+
+    // the pixels of the finished tiles follow, row by row in tile order; the
+    // image is only touched once they have all been read
+    std::vector<RGBA> pixels;
+    std::vector<int> restored;
+    for (int index = 0; index < (int)done.size(); index++) {
+        if (done[index] != '1')
+            continue;
+        glm::ivec4 tile = tileAt(index);
+        size_t begin = pixels.size();
+        pixels.resize(begin + (size_t)(tile.z - tile.x) * (tile.w - tile.y));
+        in.read(reinterpret_cast<char *>(pixels.data() + begin),
+                (std::streamsize)((pixels.size() - begin) * sizeof(RGBA)));
+        restored.push_back(index);
+    }
+    if (!in) {
+        std::cerr << "Warning: ignoring truncated checkpoint \"" << m_path << "\"" << std::endl;
+        return 0;
+    }
+
+    const RGBA *source = pixels.data();
+    for (int index : restored) {
+        glm::ivec4 tile = tileAt(index);
+        for (int j = tile.y; j < tile.w; ++j) {
+            std::copy(source, source + (tile.z - tile.x), imageData + j * m_width + tile.x);
+            source += tile.z - tile.x;
+        }
+        m_done[index] = 1;
+    }
+    return (int)restored.size();
+}
+
+/**
+ * @brief RenderCheckpoint::isDone: checks whether a tile is finished
+ * @param tile: the tile, as (x0, y0, x1, y1)
+ * @return True if it holds its final pixels
+ */
+bool RenderCheckpoint::isDone(const glm::ivec4 &tile) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_done[tileIndex(tile)] != 0;
+}
+
+/**
+ * @brief RenderCheckpoint::markDone: records a finished tile, and saves the
+ * checkpoint once the interval has elapsed
+ * @param tile: the tile, as (x0, y0, x1, y1)
+ * @param imageData: the image being rendered
+ */
+void RenderCheckpoint::markDone(const glm::ivec4 &tile, const RGBA *imageData) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_done[tileIndex(tile)] = 1;
+    if (m_interval <= 0)
+        return;
+    std::chrono::duration<double> sinceSave = std::chrono::steady_clock::now() - m_lastSave;
+    if (sinceSave.count() >= m_interval && !saveLocked(imageData)) {
+        std::cerr << "Warning: failed to save checkpoint \"" << m_path << "\"" << std::endl;
+    }
+}
+
+/**
+ * @brief RenderCheckpoint::save: writes the finished tiles to the file
+ * @param imageData: the image being rendered
+ * @return True if the checkpoint was written
+ */
+bool RenderCheckpoint::save(const RGBA *imageData) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return saveLocked(imageData);
+}
+
+/**
+ * @brief RenderCheckpoint::saveLocked: writes the finished tiles, with
+ * m_mutex held
+ * @param imageData: the image being rendered
+ * @return True if the checkpoint was written
+ */
+bool RenderCheckpoint::saveLocked(const RGBA *imageData) {
+    m_lastSave = std::chrono::steady_clock::now();
+
+    // only finished tiles are read, the other threads may be writing the rest
+    std::string done(m_done.size(), '0');
+    for (size_t index = 0; index < m_done.size(); index++) {
+        if (m_done[index])
+            done[index] = '1';
+    }
+
+    // write, then rename, so that a render killed while saving leaves the
+    // previous checkpoint intact
+    std::string partialPath = m_path + ".part";
+    {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        out << CHECKPOINT_MAGIC << "\n"
+            << m_key << "\n"
+            << m_width << " " << m_height << " " << m_tileSize << "\n"
+            << done << "\n";
+        for (int index = 0; index < (int)m_done.size(); index++) {
+            if (!m_done[index])
+                continue;
+            glm::ivec4 tile = tileAt(index);
+            for (int j = tile.y; j < tile.w; ++j) {
+                out.write(reinterpret_cast<const char *>(imageData + j * m_width + tile.x),
+                          (std::streamsize)((tile.z - tile.x) * sizeof(RGBA)));
+            }
+        }
+        out.flush();
+        if (!out) {
+            out.close();
+            std::remove(partialPath.c_str());
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(partialPath, m_path, error);
+    return !error;
+}
+
+/**
+ * @brief RenderCheckpoint::remove: deletes the checkpoint file
+ */
+void RenderCheckpoint::remove() {
+    std::error_code error;
+    std::filesystem::remove(m_path, error);
+    std::filesystem::remove(m_path + ".part", error);
+}
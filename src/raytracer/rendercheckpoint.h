@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../utils/rgba.h"
+
+#include <glm/glm.hpp>
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The RenderCheckpoint class: the tiles of a render that are finished,
+ * saved to a file as the render goes, so that a render killed before its
+ * image is saved can resume rather than start over.
+ *
+ * Every pixel takes all its samples, from a sequence seeded by its index,
+ * before its tile is finished, so a finished tile holds its final pixels and
+ * nothing else needs saving: the tiles a resumed render restores are exactly
+ * those an uninterrupted one would have rendered.
+ */
+class RenderCheckpoint {
+public:
+    // constructor for the checkpoint at path of a width x height render in
+    // tiles of tileSize pixels, saved every interval seconds while rendering,
+    // or only when asked if interval is 0. key identifies the render, see
+    // renderCacheKey.
+    RenderCheckpoint(std::string path, std::string key, int width, int height,
+                     int tileSize, double interval);
+
+    // Restores into imageData the finished tiles of the checkpoint file, if
+    // it was saved for the same render. Returns the number of tiles restored.
+    int restore(RGBA *imageData);
+
+    // Whether a tile of the render was finished, before or since the restore.
+    bool isDone(const glm::ivec4 &tile) const;
+
+    // Records a finished tile, and saves the checkpoint if the interval
+    // elapsed since it was last saved. Called from the render threads.
+    void markDone(const glm::ivec4 &tile, const RGBA *imageData);
+
+    // Saves the finished tiles now. Returns whether the file was written.
+    bool save(const RGBA *imageData);
+
+    // Deletes the checkpoint file, once the image it was for is saved.
+    void remove();
+
+    // The number of tiles of the render.
+    int tileCount() const;
+
+    const std::string &path() const;
+
+private:
+    int tileIndex(const glm::ivec4 &tile) const;
+    glm::ivec4 tileAt(int index) const;
+    bool saveLocked(const RGBA *imageData);
+
+    std::string m_path;
+    std::string m_key;
+    int m_width;
+    int m_height;
+    int m_tileSize;
+    int m_tilesX;
+    int m_tilesY;
+    double m_interval;
+
+    // guards everything below, the render threads finish tiles concurrently
+    mutable std::mutex m_mutex;
+    std::vector<char> m_done;
+    std::chrono::steady_clock::time_point m_lastSave;
+};
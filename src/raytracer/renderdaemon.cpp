@@ -0,0 +1,267 @@
+#include "renderdaemon.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QSettings>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+
+/**
+ * @brief RenderDaemon::RenderDaemon: creates an idle daemon
+ * @param events: the stream events are written to
+ * @param maxScenes: the scenefiles whose parsed and built scenes are kept
+ * @param maxTextures: the decoded textures that are kept, 0 for all
+ */
+RenderDaemon::RenderDaemon(std::ostream &events, int maxScenes, int maxTextures)
+    : m_events(events), m_maxScenes(std::max(1, maxScenes)), m_maxTextures(maxTextures) {}
+
+/**
+ * @brief RenderDaemon::emitEvent: writes an event as one JSON line
+ * @param event: the event
+ */
+void RenderDaemon::emitEvent(const QJsonObject &event) {
+    std::lock_guard<std::mutex> lock(m_eventsMutex);
+    m_events << QJsonDocument(event).toJson(QJsonDocument::Compact).toStdString() << std::endl;
+}
+
+/**
+ * @brief RenderDaemon::run: reads requests and renders jobs until the input
+ * ends or asks to quit
+ * @param requests: the stream of JSON lines to read
+ * @return 0 if every job succeeded or was cancelled, 1 otherwise
+ */
+int RenderDaemon::run(std::istream &requests) {
+    std::thread worker(&RenderDaemon::workerLoop, this);
+
+    std::string line;
+    while (std::getline(requests, line)) {
+        if (line.find_first_not_of(" \t\r") == std::string::npos)
+            continue;
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(QByteArray::fromStdString(line), &error);
+        if (!document.isObject()) {
+            emitEvent({{"event", "error"},
+                       {"message", "not a JSON object: " + error.errorString()}});
+            continue;
+        }
+        if (!handleRequest(document.object()))
+            break;
+    }
+
+    // the jobs still queued are rendered before exiting
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closing = true;
+    }
+    m_wakeup.notify_all();
+    worker.join();
+    return m_failedJobs > 0 ? 1 : 0;
+}
+
+/**
+ * @brief RenderDaemon::handleRequest: queues, cancels or quits
+ * @param request: the parsed request
+ * @return false if the request asks the daemon to quit
+ */
+bool RenderDaemon::handleRequest(const QJsonObject &request) {
+    QString type = request["type"].toString("render");
+    if (type == "quit") {
+        return false;
+    }
+
+    if (type == "cancel") {
+        QString id = request["id"].toString();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto queued = std::find_if(m_queue.begin(), m_queue.end(),
+                                   [&](const std::shared_ptr<Job> &job) { return job->id == id; });
+        if (queued != m_queue.end()) {
+            m_queue.erase(queued);
+            lock.unlock();
+            emitEvent({{"event", "cancelled"}, {"id", id}});
+        } else if (m_running && m_running->id == id) {
+            // the event is emitted once the render stops
+            m_running->cancelled = true;
+        } else {
+            lock.unlock();
+            emitEvent({{"event", "error"}, {"id", id}, {"message", "no such job"}});
+        }
+        return true;
+    }
+
+    if (type != "render" || !request["config"].isString()) {
+        emitEvent({{"event", "error"},
+                   {"message", "expected a render request with a \"config\""}});
+        return true;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->frame.configPath = request["config"].toString();
+    job->frame.frame = (float)request["frame"].toDouble(-1);
+    job->priority = request["priority"].toInt(0);
+    job->overrides = request["overrides"].toObject();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        job->sequence = m_sequence++;
+        job->id = request["id"].toString(QString("job%1").arg((qulonglong)job->sequence));
+        m_queue.push_back(job);
+    }
+    emitEvent({{"event", "queued"}, {"id", job->id}});
+    m_wakeup.notify_one();
+    return true;
+}
+
+/**
+ * @brief RenderDaemon::workerLoop: renders the highest priority queued job,
+ * the oldest among equals, until the daemon closes with an empty queue
+ */
+void RenderDaemon::workerLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wakeup.wait(lock, [&]() { return !m_queue.empty() || m_closing; });
+            if (m_queue.empty())
+                return;
+            auto next = std::min_element(m_queue.begin(), m_queue.end(),
+                                         [](const std::shared_ptr<Job> &a, const std::shared_ptr<Job> &b) {
+                                             if (a->priority != b->priority)
+                                                 return a->priority > b->priority;
+                                             return a->sequence < b->sequence;
+                                         });
+            job = *next;
+            m_queue.erase(next);
+            m_running = job;
+        }
+        runJob(*job);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running.reset();
+    }
+}
+
+/**
+ * @brief RenderDaemon::contextFor: finds the state kept for a scenefile
+ * @param scenePath: the scenefile of the job
+ * @return the context to render the job with
+ *
+ * Contexts are keyed by the content of the scenefile and its directory, which
+ * meshes are relative to, so that copies of a scene share one. An edited
+ * scenefile keeps the context of its path, which it can re-render partially.
+ */
+RenderJobContext &RenderDaemon::contextFor(const QString &scenePath) {
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QFileInfo info(scenePath);
+    hash.addData(info.absolutePath().toUtf8());
+    QFile file(scenePath);
+    if (file.open(QFile::ReadOnly)) {
+        hash.addData(&file);
+    }
+    QByteArray digest = hash.result();
+
+    auto it = std::find_if(m_scenes.begin(), m_scenes.end(),
+                           [&](const SceneContext &scene) { return scene.digest == digest; });
+    if (it != m_scenes.end()) {
+        // the same content, so the parsed scene holds whatever its path
+        it->context.scenePath = scenePath.toStdString();
+        it->context.sceneModified = info.lastModified();
+    } else {
+        it = std::find_if(m_scenes.begin(), m_scenes.end(), [&](const SceneContext &scene) {
+            return scene.context.scenePath == scenePath.toStdString();
+        });
+    }
+
+    if (it == m_scenes.end()) {
+        if ((int)m_scenes.size() >= m_maxScenes) {
+            m_scenes.pop_back();
+        }
+        m_scenes.emplace_front();
+        it = m_scenes.begin();
+        it->context.maxTextures = m_maxTextures;
+    } else {
+        m_scenes.splice(m_scenes.begin(), m_scenes, it);
+    }
+    it->digest = digest;
+    return it->context;
+}
+
+/**
+ * @brief RenderDaemon::runJob: renders a job, reporting its progress
+ * @param job: the job
+ */
+void RenderDaemon::runJob(Job &job) {
+    emitEvent({{"event", "started"}, {"id", job.id}});
+    QElapsedTimer timer;
+    timer.start();
+
+    auto fail = [&](const QString &message) {
+        m_failedJobs++;
+        emitEvent({{"event", "failed"}, {"id", job.id}, {"message", message}});
+    };
+    if (!QFileInfo::exists(job.frame.configPath)) {
+        fail("config file not found");
+        return;
+    }
+
+    // overrides go into a copy of the config file, which renderFrame reads
+    FrameJob frame = job.frame;
+    QTemporaryFile overridden(QDir::temp().filePath("aether-ray-job-XXXXXX.ini"));
+    if (!job.overrides.isEmpty()) {
+        QFile config(job.frame.configPath);
+        if (!config.open(QFile::ReadOnly) || !overridden.open() ||
+            overridden.write(config.readAll()) < 0) {
+            fail("could not apply the overrides");
+            return;
+        }
+        overridden.close();
+        frame.configPath = overridden.fileName();
+        QSettings settings(frame.configPath, QSettings::IniFormat);
+        for (const QString &key : job.overrides.keys()) {
+            settings.setValue(key, job.overrides[key].toVariant());
+        }
+        settings.sync();
+    }
+
+    QSettings settings(frame.configPath, QSettings::IniFormat);
+    float frameNumber = frame.frame >= 0 ? frame.frame : settings.value("Settings/frame").toFloat();
+    QString output = substituteFrame(settings.value("IO/output").toString(), (int)frameNumber);
+
+    // Settings/threads caps the threads of the job's render; jobs run one at
+    // a time, so the cap never changes under a render
+    int threads = settings.value("Settings/threads").toInt();
+    QThreadPool::globalInstance()->setMaxThreadCount(threads > 0 ? threads : QThread::idealThreadCount());
+
+    RenderJobContext &context = contextFor(settings.value("IO/scene").toString());
+    context.cancelled = &job.cancelled;
+    context.progress = [&](int tilesDone, int tilesTotal) {
+        // one event per percent, whichever render thread gets there first
+        int percent = tilesTotal > 0 ? tilesDone * 100 / tilesTotal : 100;
+        int reported = job.reportedPercent.load();
+        while (percent > reported) {
+            if (job.reportedPercent.compare_exchange_weak(reported, percent)) {
+                emitEvent({{"event", "progress"}, {"id", job.id}, {"percent", percent}});
+                break;
+            }
+        }
+    };
+    bool success = renderFrame(frame, context);
+    context.cancelled = nullptr;
+    context.progress = nullptr;
+
+    double seconds = timer.nsecsElapsed() / 1e9;
+    if (job.cancelled) {
+        emitEvent({{"event", "cancelled"}, {"id", job.id}, {"seconds", seconds}});
+    } else if (success) {
+        emitEvent({{"event", "done"}, {"id", job.id}, {"output", output}, {"seconds", seconds}});
+    } else {
+        fail("render failed, see the log");
+    }
+}
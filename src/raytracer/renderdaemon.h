@@ -0,0 +1,102 @@
+#pragma once
+
+#include "renderjob.h"
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief The RenderDaemon class: a long-running renderer that takes jobs as
+ * JSON lines and reports on them as JSON lines, so that a pipeline submitting
+ * many small jobs pays for process startup, scene parsing, texture decoding
+ * and BVH builds once rather than per job.
+ *
+ * Requests, one JSON object per line:
+ *   {"type": "render", "id": "a", "config": "x.ini", "frame": 3,
+ *    "priority": 1, "overrides": {"Canvas/width": 320}}
+ *   {"type": "cancel", "id": "a"}
+ *   {"type": "quit"}
+ * Only "config" is required for a render. Jobs with a higher priority run
+ * first, in submission order for equal priorities. Overrides replace keys of
+ * the config file for this job only.
+ *
+ * Events, one JSON object per line: queued, started, progress (with a
+ * percent), done (with the output and seconds), failed, cancelled, and
+ * error for requests that could not be understood.
+ *
+ * Jobs run one at a time, each spread over the global thread pool. The parsed
+ * and built scenes of the most recently used scenefiles are kept, keyed by
+ * their content, and decoded textures are kept until their file changes or
+ * they are the least recently used beyond a limit.
+ */
+class RenderDaemon {
+public:
+    // constructor for a daemon writing its events to events, keeping the
+    // scenes of maxScenes scenefiles and maxTextures decoded textures
+    RenderDaemon(std::ostream &events, int maxScenes, int maxTextures);
+
+    // handles requests until the end of the input or a quit request, then
+    // finishes the queued jobs. Returns 0, or 1 if any job failed.
+    int run(std::istream &requests);
+
+private:
+    struct Job {
+        QString id;
+        FrameJob frame;
+        QJsonObject overrides;
+        int priority = 0;
+        std::uint64_t sequence = 0;
+        std::atomic<bool> cancelled = false;
+        std::atomic<int> reportedPercent = -1;
+    };
+
+    // the state kept for one scenefile, see RenderJobContext
+    struct SceneContext {
+        QByteArray digest;
+        RenderJobContext context;
+    };
+
+    // handles one request, returns false for a quit request
+    bool handleRequest(const QJsonObject &request);
+
+    // renders the queued jobs, by priority, until the daemon closes
+    void workerLoop();
+
+    // renders one job and reports on it
+    void runJob(Job &job);
+
+    // the context of a scenefile, created or reused in least recently used
+    // order
+    RenderJobContext &contextFor(const QString &scenePath);
+
+    // writes one event line
+    void emitEvent(const QJsonObject &event);
+
+    std::ostream &m_events;
+    std::mutex m_eventsMutex;
+    int m_maxScenes;
+    int m_maxTextures;
+
+    // the queue, guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+    std::vector<std::shared_ptr<Job>> m_queue;
+    std::shared_ptr<Job> m_running;
+    std::uint64_t m_sequence = 0;
+    bool m_closing = false;
+
+    // only used by the worker, most recently used first
+    std::list<SceneContext> m_scenes;
+    int m_failedJobs = 0;
+};
@@ -0,0 +1,616 @@
+#include "renderjob.h"
+#include "../light/texturemanager.h"
+#include "../utils/renderconfig.h"
+#include "../utils/imageencoder.h"
+#include "../utils/renderstats.h"
+#include "../utils/streamingimagewriter.h"
+#include "../utils/tracing.h"
+#include "../utils/videostreamwriter.h"
+#include "aovbuffers.h"
+#include "costheatmap.h"
+#include "damageregion.h"
+#include "partialrender.h"
+#include "raytracer.h"
+#include "rendercheckpoint.h"
+#include "resultcache.h"
+
+#include <QCollator>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSettings>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <memory>
+
+// a %d or zero padded %04d standing for the frame number
+static const QRegularExpression frameField("%(0\\d+)?d");
+
+/**
+ * @brief substituteFrame: puts a frame number in a path
+ * @param path: the path, with a %d or %04d for the frame number
+ * @param frame: the frame number
+ * @return the path with the frame number, or path if it has no %d
+ */
+QString substituteFrame(const QString &path, int frame) {
+    QRegularExpressionMatch field = frameField.match(path);
+    if (!field.hasMatch())
+        return path;
+    int width = field.captured(1).isEmpty() ? 0 : field.captured(1).toInt();
+    QString result = path;
+    result.replace(field.capturedStart(), field.capturedLength(),
+                   QString("%1").arg(frame, width, 10, QChar('0')));
+    return result;
+}
+
+/**
+ * @brief shardOutputPath: names the partial render of a shard
+ * @param outputPath: the output of the whole image
+ * @param shard: the shard
+ * @return the path of its partial render, next to the output
+ */
+std::string shardOutputPath(const std::string &outputPath, const RayTracer::Shard &shard) {
+    std::string name;
+    if (shard.region != glm::ivec4(0, 0, INT_MAX, INT_MAX)) {
+        name = "tile" + std::to_string(shard.region.x) + "-" + std::to_string(shard.region.y) +
+               "-" + std::to_string(shard.region.z) + "-" + std::to_string(shard.region.w);
+    }
+    if (shard.count > 1) {
+        name += (name.empty() ? "shard" : ".shard") + std::to_string(shard.index) + "of" +
+                std::to_string(shard.count);
+    }
+    return auxiliaryOutputPath(outputPath, name, "bin");
+}
+
+/**
+ * @brief saveFrameImage: encodes and saves the image of a frame
+ * @param image: the image
+ * @param outputPath: where to save it
+ * @param qtEncoder: whether to save with QImage::save, see saveImage
+ * @param replaceLink: whether the output may be a hard link into the result
+ * cache, which must not be overwritten in place
+ * @return True if the image was saved
+ */
+bool saveFrameImage(const QImage &image, const std::string &outputPath, bool qtEncoder,
+                    bool replaceLink) {
+    TRACE_SPAN("saveImage", outputPath);
+    if (replaceLink) {
+        QFile::remove(QString::fromStdString(outputPath));
+    }
+    return saveImage(image, outputPath, qtEncoder);
+}
+
+/**
+ * @brief finishFrameSave: reports on the save of a frame's image, and once it
+ * is saved, drops its checkpoint and adds it to the result cache
+ * @param saved: whether the image was saved
+ * @param outputPath: where it was saved
+ * @param resultCache: the result cache directory, empty for none
+ * @param cacheKey: the key of the image in the result cache, empty for none
+ * @param checkpoint: if not null, the checkpoint of the render
+ * @return saved
+ */
+bool finishFrameSave(bool saved, const std::string &outputPath, const std::string &resultCache,
+                     const std::string &cacheKey, RenderCheckpoint *checkpoint) {
+    if (!saved) {
+        std::cerr << "Error: failed to save image to \"" << outputPath << "\"" << std::endl;
+        return false;
+    }
+    std::cout << "Saved rendered image to \"" << outputPath << "\"" << std::endl;
+    if (checkpoint) {
+        checkpoint->remove();
+    }
+    if (!cacheKey.empty() && !storeCachedRender(resultCache, cacheKey, outputPath)) {
+        std::cerr << "Warning: failed to add \"" << outputPath << "\" to the result cache" << std::endl;
+    }
+    return true;
+}
+
+/**
+ * @brief appendVideoFrame: appends the image of a frame to the video stream,
+ * after the frames before it in the batch, and once it is written, drops its
+ * checkpoint
+ * @param video: the video stream
+ * @param index: the position of the frame in the batch
+ * @param image: the image
+ * @param checkpoint: if not null, the checkpoint of the render
+ * @return True if the frame was written
+ */
+bool appendVideoFrame(VideoStreamWriter &video, int index, const QImage &image,
+                      RenderCheckpoint *checkpoint) {
+    TRACE_SPAN("appendVideoFrame");
+    if (!video.writeFrame(index, reinterpret_cast<const RGBA *>(image.constBits()), image.width(),
+                          image.height()))
+        return false;
+    std::cout << "Appended frame " << index << " of the batch to the video stream" << std::endl;
+    if (checkpoint) {
+        checkpoint->remove();
+    }
+    return true;
+}
+
+/**
+ * @brief waitForPendingSave: waits for the image of the previous frame to be
+ * saved, when it was saved in the background
+ * @param context: the state of the batch
+ * @return False if that save failed, which is also counted in
+ * context.failedSaves
+ */
+bool waitForPendingSave(RenderJobContext &context) {
+    if (!context.pendingSave.valid())
+        return true;
+    TRACE_SPAN("waitForPendingSave");
+    if (context.pendingSave.get())
+        return true;
+    context.failedSaves++;
+    return false;
+}
+
+/**
+ * @brief renderBands: renders an image one row of tiles at a time, writing
+ * each to the output as soon as it is rendered, so that only a band of the
+ * image is ever in memory
+ * @param raytracer: the ray tracer to render with
+ * @param scene: the scene to render
+ * @param outputPath: the image to write, in a format StreamingImageWriter
+ * supports
+ * @param tileSize: the height of a band, one row of tiles
+ * @param context: where progress is reported and cancellation is read
+ * @return True if every band was rendered and the image was written
+ */
+bool renderBands(RayTracer &raytracer, const RayTraceScene &scene,
+                 const std::string &outputPath, int tileSize, const RenderJobContext &context) {
+    StreamingImageWriter writer(outputPath, scene.width(), scene.height());
+    if (!writer.open())
+        return false;
+
+    // progress is reported over the whole image rather than each band
+    int bandHeight = std::max(1, tileSize);
+    int tilesPerBand = (scene.width() + bandHeight - 1) / bandHeight;
+    int bandCount = (scene.height() + bandHeight - 1) / bandHeight;
+    int tilesBefore = 0;
+    RayTracer::ProgressCallback progress;
+    if (context.progress) {
+        progress = [&](int tilesDone, int) {
+            context.progress(tilesBefore + tilesDone, tilesPerBand * bandCount);
+        };
+    }
+    raytracer.setProgress(progress, context.cancelled);
+
+    std::vector<RGBA> band((size_t)scene.width() * bandHeight);
+    for (int y = 0; y < scene.height(); y += bandHeight) {
+        int rows = std::min(bandHeight, scene.height() - y);
+        raytracer.renderRows(band.data(), scene, y, y + rows);
+        // an unfinished image is dropped along with the writer
+        if (context.cancelled != nullptr && context.cancelled->load())
+            return false;
+        if (!writer.writeRows(band.data(), rows))
+            return false;
+        tilesBefore += tilesPerBand;
+    }
+    return writer.close();
+}
+
+/**
+ * @brief renderFrame: renders one frame of a config file
+ * @param job: the config file (.ini) and frame to render
+ * @param context: state shared with the other frames of the batch
+ * @return True if the image was rendered and saved, False otherwise
+ */
+bool renderFrame(const FrameJob &job, RenderJobContext &context) {
+    TRACE_SPAN("frame", job.configPath.toStdString());
+
+    QSettings settings( job.configPath, QSettings::IniFormat );
+    float frame = job.frame >= 0 ? job.frame : settings.value("Settings/frame").toFloat();
+    QString iScenePath = settings.value("IO/scene").toString();
+    QString oImagePath = substituteFrame(settings.value("IO/output").toString(), (int)frame);
+
+    // Wall time of each phase, reported with the render statistics
+    RenderPhaseTimes phaseTimes;
+    QElapsedTimer phaseTimer;
+    PerfCounterValues phaseCounters;
+    auto startPhase = [&]() {
+        phaseTimer.restart();
+        if (context.perfCounters) {
+            phaseCounters = context.perfCounters->read();
+        }
+    };
+    auto endPhase = [&](const char *name, std::uint64_t rays = 0) {
+        double seconds = phaseTimer.nsecsElapsed() / 1e9;
+        if (context.perfCounters) {
+            context.benchPhases.push_back(BenchPhase{name, seconds, context.perfCounters->read() - phaseCounters, rays});
+        }
+        return seconds;
+    };
+    startPhase();
+    if (context.refreshTextures) {
+        refreshTextureCache(context.maxTextures);
+    }
+
+    // Only parse the scenefile if it is not the one of the previous frame
+    QDateTime sceneModified = QFileInfo(iScenePath).lastModified();
+    bool sceneChanged = iScenePath.toStdString() != context.scenePath ||
+                        sceneModified != context.sceneModified;
+    if (sceneChanged) {
+        context.scene.reset();
+        context.temporalCache.reset();
+        context.scenePath.clear();
+        if (job.prepared && job.prepared->path == iScenePath.toStdString() &&
+            job.prepared->modified == sceneModified) {
+            // loaded while the previous frame rendered
+            context.sceneData = std::move(job.prepared->data);
+            context.scene = std::move(job.prepared->scene);
+        } else {
+            context.sceneData = RenderData();
+            if (!SceneParser::parse(iScenePath.toStdString(), context.sceneData)) {
+                std::cerr << "Error loading scene: \"" << iScenePath.toStdString() << "\"" << std::endl;
+                return false;
+            }
+        }
+        context.scenePath = iScenePath.toStdString();
+        context.sceneModified = sceneModified;
+    }
+
+    // Only the groups and camera that have keyframes move between frames
+    bool animated = SceneParser::isAnimated(context.sceneData);
+    if (animated) {
+        SceneParser::evaluate(context.sceneData, frame);
+    }
+    phaseTimes.parse = endPhase("parse");
+
+    // Raytracing-relevant code starts here
+
+    int width = settings.value("Canvas/width").toInt();
+    int height = settings.value("Canvas/height").toInt();
+
+    // With IO/streaming, an image in a format that can be written a band of
+    // rows at a time is never held in memory as a whole, unless the frame
+    // goes to a --video stream
+    bool streaming = settings.value("IO/streaming").toBool() && context.shard.whole() && !context.video;
+    if (streaming && !StreamingImageWriter::supports(oImagePath.toStdString())) {
+        std::cerr << "Warning: IO/streaming needs a .png, .ppm or .pnm output, rendering in memory" << std::endl;
+        streaming = false;
+    }
+
+    // The framebuffer is kept between frames of the same size
+    if (streaming) {
+        context.image = QImage();
+        context.renderedSceneData.reset();
+    } else if (context.image.width() != width || context.image.height() != height) {
+        context.image = QImage(width, height, QImage::Format_RGBX8888);
+        context.renderedSceneData.reset();
+    }
+    QImage &image = context.image;
+
+    // Setting up the raytracer
+    RayTracer::Config rtConfig = readRayTracerConfig(settings);
+
+    // The hash of everything the image depends on, see renderCacheKey, only
+    // computed when needed
+    std::string inputKey;
+    auto renderKey = [&]() -> const std::string & {
+        if (inputKey.empty()) {
+            inputKey = renderCacheKey(context.sceneData, rtConfig, width, height);
+        }
+        return inputKey;
+    };
+
+    // A shard only writes the pixels of its tiles, so outputs of the whole
+    // image and state kept for the next frame are left out
+    bool sharded = !context.shard.whole();
+    bool wholeImageOnly = sharded || streaming;
+
+    // With IO/result-cache, a frame whose inputs were rendered before is taken
+    // from the cache instead. Only the image is cached, so frames with optional
+    // outputs are always rendered.
+    QString resultCache = settings.value("IO/result-cache").toString();
+    bool optionalOutputs = settings.value("Feature/aovs").toBool() ||
+                           !settings.value("Settings/cost-heatmap").toString().isEmpty() ||
+                           settings.value("Feature/stats").toBool() ||
+                           settings.value("Feature/primitive-report").toBool();
+    std::string cacheKey;
+    if (sharded && optionalOutputs) {
+        std::cerr << "Warning: optional outputs are not written by a shard" << std::endl;
+    } else if (streaming && (settings.value("Feature/aovs").toBool() || !settings.value("Settings/cost-heatmap").toString().isEmpty())) {
+        std::cerr << "Warning: auxiliary outputs and the cost heatmap are not written with IO/streaming" << std::endl;
+    }
+    if (!resultCache.isEmpty() && !optionalOutputs && !sharded && !context.video) {
+        cacheKey = renderKey();
+        if (fetchCachedRender(resultCache.toStdString(), cacheKey, oImagePath.toStdString())) {
+            std::cout << "Reused cached render for \"" << oImagePath.toStdString() << "\"" << std::endl;
+            return true;
+        }
+    }
+
+    RayTracer raytracer{ rtConfig };
+    raytracer.setProgress(context.progress, context.cancelled);
+    raytracer.setShard(context.shard);
+    raytracer.setPrimitiveCosts(settings.value("Feature/primitive-report").toBool());
+
+    startPhase();
+    if (!context.scene || context.scene->width() != width || context.scene->height() != height) {
+        context.scene = std::make_unique<RayTraceScene>(width, height, context.sceneData);
+        context.temporalCache.reset();
+    } else if (animated) {
+        context.scene->updateAnimation(context.sceneData);
+    }
+    context.scene->setAcceleration(rtConfig.enableAcceleration, rtConfig.bvhRebuildThreshold);
+    const RayTraceScene &rtScene = *context.scene;
+    phaseTimes.sceneBuild = endPhase("scene-build");
+
+    // Auxiliary outputs are filled in the same pass as the image when enabled
+    std::unique_ptr<AOVBuffers> aovs;
+    if (settings.value("Feature/aovs").toBool() && !wholeImageOnly) {
+        aovs = std::make_unique<AOVBuffers>(width, height);
+    }
+
+    // Note that we're passing `data` as a pointer (to its first element)
+    // Recall from Lab 1 that you can access its elements like this: `data[i]`
+    // The per-pixel cost heatmap measures either "time" or intersection "tests"
+    std::unique_ptr<CostHeatmap> heatmap;
+    QString heatmapMetric = settings.value("Settings/cost-heatmap").toString();
+    if (!heatmapMetric.isEmpty() && !wholeImageOnly) {
+        CostHeatmap::Metric metric;
+        if (CostHeatmap::parseMetric(heatmapMetric.toStdString(), metric)) {
+            heatmap = std::make_unique<CostHeatmap>(width, height, metric);
+        }
+    }
+
+    // Pixels that see the same unchanged point as in the previous frame reuse
+    // its result, which only holds if the frame is rendered the same way
+    int temporalMaxAge = settings.value("Settings/temporal-max-age", 8).toInt();
+    if (!settings.value("Feature/temporal-reuse").toBool() || temporalMaxAge <= 0 || wholeImageOnly) {
+        context.temporalCache.reset();
+    } else if (aovs) {
+        std::cerr << "Warning: Feature/temporal-reuse is ignored with Feature/aovs" << std::endl;
+        context.temporalCache.reset();
+    } else if (!context.temporalCache || !(context.temporalConfig == rtConfig) ||
+               context.temporalCache->maxAge() != temporalMaxAge) {
+        context.temporalCache = std::make_unique<TemporalCache>(temporalMaxAge);
+        context.temporalConfig = rtConfig;
+    }
+
+    // With Feature/partial-rerender, the image still shows the last render,
+    // and only the tiles that what changed since can reach are rendered again
+    bool partialRerender = settings.value("Feature/partial-rerender").toBool() && !wholeImageOnly;
+    bool damageOnly = partialRerender && context.renderedSceneData &&
+                      context.renderedConfig == rtConfig && !aovs && !heatmap &&
+                      !context.temporalCache;
+
+    // With Settings/checkpoint-interval, the finished tiles are saved next to
+    // the output every so many seconds, and a cancelled render saves them too;
+    // with --resume, the render restores them rather than render them again.
+    // Only the image is checkpointed, so renders with other outputs are not.
+    double checkpointInterval = settings.value("Settings/checkpoint-interval", 0).toDouble();
+    std::unique_ptr<RenderCheckpoint> checkpoint;
+    if ((checkpointInterval > 0 || context.resume) && !damageOnly && !streaming) {
+        if (aovs || heatmap || context.temporalCache) {
+            std::cerr << "Warning: checkpoints are ignored with Feature/aovs, Settings/cost-heatmap and Feature/temporal-reuse" << std::endl;
+        } else {
+            // shards of the same image each have their own
+            std::string checkpointNextTo = sharded ? shardOutputPath(oImagePath.toStdString(), context.shard)
+                                                   : oImagePath.toStdString();
+            checkpoint = std::make_unique<RenderCheckpoint>(
+                auxiliaryOutputPath(checkpointNextTo, "checkpoint", "bin"),
+                renderKey(), width, height, rtConfig.tileSize, checkpointInterval);
+        }
+    }
+
+    // Extracting data pointer from Qt's image API only now: bits() detaches
+    // the image from a previous frame still being saved, which a frame taken
+    // from the result cache must not pay for
+    RGBA *data = reinterpret_cast<RGBA *>(image.bits());
+
+    startPhase();
+    bool streamed = false;
+    if (streaming) {
+        streamed = renderBands(raytracer, rtScene, oImagePath.toStdString(), rtConfig.tileSize, context);
+    } else if (damageOnly) {
+        SceneDiff diff = diffScenes(*context.renderedSceneData, context.sceneData);
+        int tiles = raytracer.renderDamage(data, rtScene, diff);
+        std::cout << "Re-rendered " << tiles << " tiles reached by scene changes" << std::endl;
+    } else {
+        image.fill(Qt::black);
+        if (checkpoint && context.resume) {
+            int restored = checkpoint->restore(data);
+            std::cout << "Resumed " << restored << " of " << checkpoint->tileCount()
+                      << " tiles from \"" << checkpoint->path() << "\"" << std::endl;
+        }
+        raytracer.setCheckpoint(checkpoint.get());
+        raytracer.render(data, rtScene, aovs.get(), heatmap.get(), context.temporalCache.get());
+    }
+    if (partialRerender) {
+        context.renderedSceneData = context.sceneData;
+        context.renderedConfig = rtConfig;
+    } else {
+        context.renderedSceneData.reset();
+    }
+    if (context.perfCounters) {
+        // inherited counters only include a thread's events once it exits
+        QThreadPool::globalInstance()->waitForDone();
+    }
+    std::uint64_t renderRays = 0;
+#ifdef AETHER_RENDER_STATS
+    const RenderStats &renderStats = raytracer.getStats();
+    renderRays = renderStats.primaryRays + renderStats.reflectionRays + renderStats.shadowRays;
+#endif
+    phaseTimes.render = endPhase("render", renderRays);
+
+    // A cancelled render leaves tiles unrendered, which later frames must not
+    // build on
+    if (context.cancelled != nullptr && context.cancelled->load()) {
+        context.renderedSceneData.reset();
+        context.temporalCache.reset();
+        std::cout << "Cancelled rendering \"" << oImagePath.toStdString() << "\"" << std::endl;
+        if (checkpoint && checkpoint->save(data)) {
+            std::cout << "Saved checkpoint to \"" << checkpoint->path() << "\"" << std::endl;
+        }
+        return false;
+    }
+
+    // Saving the image, or the tiles of a shard
+    bool success;
+    startPhase();
+    if (sharded) {
+        std::string shardPath = shardOutputPath(oImagePath.toStdString(), context.shard);
+        TRACE_SPAN("savePartialRender", shardPath);
+        success = savePartialRender(shardPath, renderKey(), width, height,
+                                    raytracer.shardTiles(rtScene), data);
+        phaseTimes.save = endPhase("save");
+        if (success) {
+            std::cout << "Saved partial render to \"" << shardPath << "\"" << std::endl;
+            if (checkpoint) {
+                checkpoint->remove();
+            }
+        } else {
+            std::cerr << "Error: failed to save partial render to \"" << shardPath << "\"" << std::endl;
+        }
+        return success;
+    }
+    // IO/encoder = qt saves with QImage::save rather than the parallel PNG,
+    // QOI, PPM and PFM encoders
+    bool qtEncoder = settings.value("IO/encoder").toString() == "qt";
+    if (streaming) {
+        // the bands were written as they were rendered
+        success = finishFrameSave(streamed, oImagePath.toStdString(), resultCache.toStdString(),
+                                  cacheKey, checkpoint.get());
+    } else if (context.video && context.asyncSave) {
+        // frames are appended in order, since each waits for the previous one
+        waitForPendingSave(context);
+        std::shared_ptr<RenderCheckpoint> savedCheckpoint = std::move(checkpoint);
+        context.pendingSave = std::async(std::launch::async,
+                                         [video = context.video, index = job.index, image = QImage(image),
+                                          savedCheckpoint]() {
+                                             return appendVideoFrame(*video, index, image, savedCheckpoint.get());
+                                         });
+        success = true;
+    } else if (context.video) {
+        success = appendVideoFrame(*context.video, job.index, image, checkpoint.get());
+    } else if (context.asyncSave) {
+        // the image stays shared with the save until the next frame writes
+        // to it, which then renders into a copy
+        waitForPendingSave(context);
+        std::shared_ptr<RenderCheckpoint> savedCheckpoint = std::move(checkpoint);
+        context.pendingSave = std::async(
+            std::launch::async,
+            [image = QImage(image), outputPath = oImagePath.toStdString(),
+             resultCacheDirectory = resultCache.toStdString(), cacheKey, qtEncoder, savedCheckpoint]() {
+                bool saved = saveFrameImage(image, outputPath, qtEncoder, !resultCacheDirectory.empty());
+                return finishFrameSave(saved, outputPath, resultCacheDirectory, cacheKey,
+                                       savedCheckpoint.get());
+            });
+        success = true;
+    } else {
+        bool saved = saveFrameImage(image, oImagePath.toStdString(), qtEncoder, !resultCache.isEmpty());
+        success = finishFrameSave(saved, oImagePath.toStdString(), resultCache.toStdString(),
+                                  cacheKey, checkpoint.get());
+    }
+    // a save in the background is only launched here, and timed as such
+    phaseTimes.backgroundSave = !streaming && context.asyncSave;
+    phaseTimes.save = endPhase(phaseTimes.backgroundSave ? "save-launch" : "save");
+
+    if (aovs && !aovs->save(oImagePath.toStdString())) {
+        std::cerr << "Error: failed to save auxiliary outputs next to \"" << oImagePath.toStdString() << "\"" << std::endl;
+    }
+
+    if (heatmap && !heatmap->save(oImagePath.toStdString())) {
+        std::cerr << "Error: failed to save cost heatmap next to \"" << oImagePath.toStdString() << "\"" << std::endl;
+    }
+
+#ifdef AETHER_RENDER_STATS
+    if (settings.value("Feature/stats").toBool()) {
+        std::string statsPath = auxiliaryOutputPath(oImagePath.toStdString(), "stats", "json");
+        if (saveRenderStats(statsPath, raytracer.getStats(), phaseTimes)) {
+            std::cout << "Saved render statistics to \"" << statsPath << "\"" << std::endl;
+        }
+    }
+    if (settings.value("Feature/primitive-report").toBool()) {
+        std::string reportPath = auxiliaryOutputPath(oImagePath.toStdString(), "primitives", "txt");
+        if (savePrimitiveCostReport(reportPath, raytracer.getStats(), rtScene.getShapes())) {
+            std::cout << "Saved primitive cost report to \"" << reportPath << "\"" << std::endl;
+        }
+    }
+#endif
+
+    return success;
+}
+
+/**
+ * @brief sortNumerically: sorts paths so that embedded numbers compare by
+ * value, e.g. frame2.ini before frame10.ini
+ * @param paths: the paths to sort in place
+ */
+void sortNumerically(QStringList &paths) {
+    QCollator collator;
+    collator.setNumericMode(true);
+    std::sort(paths.begin(), paths.end(), [&](const QString &a, const QString &b) {
+        return collator.compare(a, b) < 0;
+    });
+}
+
+/**
+ * @brief expandFrameJobs: lists the frames named by the command-line argument
+ * @param argument: a config file, directory, glob, manifest or template
+ * @param frames: a frame range such as "0-59", or empty
+ * @return the frames to render in order, empty if none were found
+ */
+std::vector<FrameJob> expandFrameJobs(const QString &argument, const QString &frames) {
+    std::vector<FrameJob> jobs;
+
+    // a template, or a single animated config, rendered at each frame
+    if (!frames.isEmpty()) {
+        QStringList range = frames.split("-");
+        int first = range[0].toInt();
+        int last = range.size() > 1 ? range[1].toInt() : first;
+        for (int frame = first; frame <= last; frame++) {
+            jobs.push_back(FrameJob{substituteFrame(argument, frame), (float)frame});
+        }
+        return jobs;
+    }
+
+    QStringList paths;
+    QFileInfo info(argument);
+    if (info.isDir()) {
+        // a directory of config files
+        QDir dir(argument);
+        for (const QString &name : dir.entryList({"*.ini"}, QDir::Files)) {
+            paths.append(dir.filePath(name));
+        }
+        sortNumerically(paths);
+    } else if (argument.contains('*') || argument.contains('?') || argument.contains('[')) {
+        // a glob over the file names of a directory
+        QDir dir = info.dir();
+        for (const QString &name : dir.entryList({info.fileName()}, QDir::Files)) {
+            paths.append(dir.filePath(name));
+        }
+        sortNumerically(paths);
+    } else if (info.suffix() == "txt") {
+        // a manifest with a config file per line, relative to the manifest
+        QFile manifest(argument);
+        if (!manifest.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            std::cerr << "Error: could not open \"" << argument.toStdString() << "\"" << std::endl;
+            return jobs;
+        }
+        QTextStream in(&manifest);
+        while (!in.atEnd()) {
+            QString line = in.readLine().trimmed();
+            if (line.isEmpty() || line.startsWith("#"))
+                continue;
+            paths.append(QDir::isAbsolutePath(line) ? line : info.dir().filePath(line));
+        }
+    } else {
+        // a single config file
+        paths.append(argument);
+    }
+
+    for (const QString &path : paths) {
+        jobs.push_back(FrameJob{path});
+    }
+    return jobs;
+}
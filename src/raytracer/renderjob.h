@@ -0,0 +1,142 @@
+#pragma once
+
+#include "../utils/perfcounters.h"
+#include "../utils/sceneparser.h"
+#include "raytracer.h"
+#include "raytracescene.h"
+#include "temporalcache.h"
+
+#include <QDateTime>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class VideoStreamWriter;
+
+/**
+ * @brief The RenderJobContext struct: state kept between the frames of a
+ * batch, so that a frame only pays for what changed since the previous one.
+ * Textures stay decoded in the texture cache of texturemanager.cpp, shared by every
+ * context of the process.
+ */
+struct RenderJobContext {
+    // if not null, every phase is measured with these counters
+    PerfCounters *perfCounters = nullptr;
+    std::vector<BenchPhase> benchPhases;
+
+    // if set, called from the render threads as tiles complete
+    RayTracer::ProgressCallback progress;
+    // if not null, the render stops at the next tile once it is set, and the
+    // frame is not saved
+    const std::atomic<bool> *cancelled = nullptr;
+
+    // with --resume, frames restore the finished tiles of their checkpoint,
+    // see Settings/checkpoint-interval, rather than render them again
+    bool resume = false;
+
+    // with --tile or --shard, frames only render the tiles of the shard and
+    // write them to a partial render next to the output, see
+    // shardOutputPath, which --merge assembles into the image
+    RayTracer::Shard shard;
+
+    // in a batch, a frame's image is encoded and saved in the background
+    // while the next frame renders; its result is collected by the next save
+    // or waitForPendingSave, and failures are counted in failedSaves
+    bool asyncSave = false;
+    std::future<bool> pendingSave;
+    int failedSaves = 0;
+
+    // with --video, frames are appended to this stream in order instead of
+    // being saved to IO/output, in the background like the saves above
+    VideoStreamWriter *video = nullptr;
+
+    // the decoded textures kept between frames, 0 for all of them; those
+    // whose file changed are reloaded either way
+    int maxTextures = 0;
+    // whether frames refresh the texture cache before rendering, which a
+    // context rendering while others do must not, see refreshTextureCache
+    bool refreshTextures = true;
+
+    // the last parsed scenefile, reused while its path and modification time
+    // stay the same
+    std::string scenePath;
+    QDateTime sceneModified;
+    RenderData sceneData;
+
+    // the last built scene, reused for the same scenefile and canvas size
+    std::unique_ptr<RayTraceScene> scene;
+
+    // the framebuffer, reallocated only when the canvas size changes, and
+    // released while frames stream with IO/streaming
+    QImage image;
+
+    // with Feature/temporal-reuse, the results of the previous frame, dropped
+    // whenever the scenefile, canvas size or ray tracer config changes
+    std::unique_ptr<TemporalCache> temporalCache;
+    RayTracer::Config temporalConfig;
+
+    // with Feature/partial-rerender, the evaluated scene and config the image
+    // shows, which the next frame is compared with to only re-render the tiles
+    // that changed
+    std::optional<RenderData> renderedSceneData;
+    RayTracer::Config renderedConfig;
+};
+
+/**
+ * @brief The PreparedScene struct: a scenefile parsed, evaluated at a frame
+ * and built ahead of the render of that frame, see FramePipeline
+ */
+struct PreparedScene {
+    // the scenefile and its modification time when it was parsed
+    std::string path;
+    QDateTime modified;
+    RenderData data;
+    // built for the canvas size and acceleration settings of the frame
+    std::unique_ptr<RayTraceScene> scene;
+};
+
+/**
+ * @brief The FrameJob struct: a config file to render, and the frame to
+ * evaluate the keyframes of its scene at
+ */
+struct FrameJob {
+    QString configPath;
+    // the frame, or -1 for the Settings/frame of the config file
+    float frame = -1;
+    // the position of the frame in its batch, which orders a --video stream,
+    // or -1 outside of a batch
+    int index = -1;
+    // if set, the scene of the frame, which renderFrame takes instead of
+    // parsing and building it when the scenefile is still the same
+    std::shared_ptr<PreparedScene> prepared;
+};
+
+// Renders the frame described by a config file, writing the image and any
+// optional outputs it enables. Returns whether the image was written.
+bool renderFrame(const FrameJob &job, RenderJobContext &context);
+
+// Waits for the background save of the previous frame, if any. Returns false
+// if it failed.
+bool waitForPendingSave(RenderJobContext &context);
+
+// Expands the config argument of the executable into the frames to render,
+// in order. The argument is a config file, a directory of them, a glob
+// pattern such as "iniFrames/*.ini", a .txt manifest listing one config per
+// line, or a template such as "iniFrames/frame%d.ini" expanded over frames, a
+// range such as "0-59". A single config file with a range renders its
+// animated scene at each frame. Directories and globs are sorted numerically,
+// so frame2 comes before frame10.
+std::vector<FrameJob> expandFrameJobs(const QString &argument, const QString &frames);
+
+// Returns the path of the partial render of a shard of outputPath, e.g.
+// "out/frame.shard2of8.bin" or "out/frame.tile0-0-512-512.bin".
+std::string shardOutputPath(const std::string &outputPath, const RayTracer::Shard &shard);
+
+// Replaces the %d or zero padded %04d in a path with a frame number, leaving
+// paths without one unchanged.
+QString substituteFrame(const QString &path, int frame);
@@ -0,0 +1,222 @@
+#include "resultcache.h"
+#include "../utils/tracing.h"
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <type_traits>
+
+// Bumped whenever the renderer changes what it draws for the same inputs, so
+// that images cached by older versions are not reused
+const char *RESULT_CACHE_VERSION = "aether-ray-result-5";
+
+/**
+ * @brief The RenderKeyHasher struct: feeds the inputs of a render into a
+ * SHA-256 in a fixed layout, one field at a time so that struct padding never
+ * reaches the hash
+ */
+struct RenderKeyHasher {
+    QCryptographicHash hash{QCryptographicHash::Sha256};
+    // digests of the files already hashed, since textures are shared
+    std::map<std::string, QByteArray> fileDigests;
+
+    template <typename T> void add(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(&value), sizeof(T)));
+    }
+
+    void add(const std::string &value) {
+        add((std::uint64_t)value.size());
+        hash.addData(QByteArray::fromRawData(value.data(), (qsizetype)value.size()));
+    }
+
+    // the contents of a file rather than its name, so that editing a
+    // texture in place invalidates the renders that use it
+    void addFile(const std::string &path) {
+        add(path);
+        auto it = fileDigests.find(path);
+        if (it == fileDigests.end()) {
+            QByteArray digest;
+            QFile file(QString::fromStdString(path));
+            if (file.open(QFile::ReadOnly)) {
+                QCryptographicHash fileHash(QCryptographicHash::Sha256);
+                fileHash.addData(&file);
+                digest = fileHash.result();
+            }
+            it = fileDigests.emplace(path, digest).first;
+        }
+        add((std::uint64_t)it->second.size());
+        hash.addData(it->second);
+    }
+
+    void addFileMap(const SceneFileMap &map) {
+        add(map.isUsed);
+        if (map.isUsed) {
+            addFile(map.filename);
+            add(map.repeatU);
+            add(map.repeatV);
+        }
+    }
+};
+
+/**
+ * @brief renderCacheKey: hashes everything the image of a render depends on
+ * @param data: the scene, evaluated at the frame being rendered
+ * @param config: the configuration of the ray tracer
+ * @param width: width of the canvas
+ * @param height: height of the canvas
+ * @return the key, as 64 hex digits
+ */
+std::string renderCacheKey(const RenderData &data, const RayTracer::Config &config,
+                           int width, int height) {
+    TRACE_SPAN("renderCacheKey");
+    RenderKeyHasher hasher;
+    hasher.add(std::string(RESULT_CACHE_VERSION));
+    hasher.add(width);
+    hasher.add(height);
+
+    // parallelism, tiling and acceleration only change how fast the same
+    // image is rendered, so they are left out
+    hasher.add(config.enableShadow);
+    hasher.add(config.enableReflection);
+    hasher.add(config.enableRefraction);
+    hasher.add(config.enableTextureMap);
+    hasher.add(config.enableTextureFilter);
+    hasher.add(config.enableSuperSample);
+    hasher.add(config.enableDepthOfField);
+    hasher.add(config.maxRecursiveDepth);
+    hasher.add(config.onlyRenderNormals);
+    hasher.add(config.samplesPerPixel);
+    hasher.add(config.stratifiedTime);
+    hasher.add(config.areaLightGrid);
+    hasher.add(config.stratifiedAreaLight);
+    hasher.add(config.adaptiveThreshold);
+    hasher.add(config.adaptiveMinSamples);
+    hasher.add(config.seed);
+
+    hasher.add(data.globalData.ka);
+    hasher.add(data.globalData.kd);
+    hasher.add(data.globalData.ks);
+    hasher.add(data.globalData.kt);
+
+    // the camera as evaluated at the frame, its keyframes are already applied
+    const SceneCameraData &camera = data.cameraData;
+    hasher.add(camera.pos);
+    hasher.add(camera.look);
+    hasher.add(camera.up);
+    hasher.add(camera.heightAngle);
+    hasher.add(camera.aperture);
+    hasher.add(camera.focalLength);
+
+    hasher.add((std::uint64_t)data.lights.size());
+    for (const SceneLightData &light : data.lights) {
+        hasher.add(light.type);
+        hasher.add(light.color);
+        hasher.add(light.function);
+        hasher.add(light.pos);
+        hasher.add(light.dir);
+        hasher.add(light.penumbra);
+        hasher.add(light.angle);
+        hasher.add(light.width);
+        hasher.add(light.height);
+        hasher.add(light.uvec);
+        hasher.add(light.vvec);
+    }
+
+    hasher.add((std::uint64_t)data.shapes.size());
+    for (const RenderShapeData &shape : data.shapes) {
+        const ScenePrimitive &primitive = shape.primitive;
+        const SceneMaterial &material = primitive.material;
+        hasher.add(primitive.type);
+        hasher.add(primitive.center2);
+        hasher.add(!primitive.meshfile.empty());
+        if (!primitive.meshfile.empty())
+            hasher.addFile(primitive.meshfile);
+        hasher.add(shape.ctm);
+        hasher.add(material.cAmbient);
+        hasher.add(material.cDiffuse);
+        hasher.add(material.cSpecular);
+        hasher.add(material.shininess);
+        hasher.add(material.cReflective);
+        hasher.add(material.cTransparent);
+        hasher.add(material.ior);
+        hasher.addFileMap(material.textureMap);
+        hasher.add(material.blend);
+        hasher.add(material.cEmissive);
+        hasher.addFileMap(material.bumpMap);
+    }
+
+    return hasher.hash.result().toHex().toStdString();
+}
+
+/**
+ * @brief cachedRenderPath: gets where the image of a key is cached
+ * @param cacheDirectory: the cache directory
+ * @param key: the key of the render
+ * @param outputPath: the output the image is for, whose extension it takes
+ * @return the path of the cached image
+ */
+QString cachedRenderPath(const std::string &cacheDirectory, const std::string &key,
+                         const std::string &outputPath) {
+    QString suffix = QFileInfo(QString::fromStdString(outputPath)).suffix();
+    return QDir(QString::fromStdString(cacheDirectory))
+        .filePath(QString::fromStdString(key) + "." + suffix);
+}
+
+/**
+ * @brief fetchCachedRender: puts a cached image at the output path
+ * @param cacheDirectory: the cache directory
+ * @param key: the key of the render, see renderCacheKey
+ * @param outputPath: where the image should be
+ * @return True if the image was in the cache and is now at outputPath
+ */
+bool fetchCachedRender(const std::string &cacheDirectory, const std::string &key,
+                       const std::string &outputPath) {
+    QString cachedPath = cachedRenderPath(cacheDirectory, key, outputPath);
+    if (!QFileInfo::exists(cachedPath))
+        return false;
+
+    // a hard link costs nothing, and the renderer never writes the output in
+    // place while the cache is on; across file systems, fall back to a copy
+    QString output = QString::fromStdString(outputPath);
+    QFile::remove(output);
+    std::error_code error;
+    std::filesystem::create_hard_link(cachedPath.toStdString(), outputPath, error);
+    if (error && !QFile::copy(cachedPath, output))
+        return false;
+    return true;
+}
+
+/**
+ * @brief storeCachedRender: adds a rendered image to the cache
+ * @param cacheDirectory: the cache directory, created if needed
+ * @param key: the key of the render, see renderCacheKey
+ * @param outputPath: where the image was saved
+ * @return True if the image is in the cache
+ */
+bool storeCachedRender(const std::string &cacheDirectory, const std::string &key,
+                       const std::string &outputPath) {
+    QString cachedPath = cachedRenderPath(cacheDirectory, key, outputPath);
+    if (QFileInfo::exists(cachedPath))
+        return true;
+    if (!QDir().mkpath(QString::fromStdString(cacheDirectory)))
+        return false;
+
+    // copy, then rename, so that a concurrent render never reuses a partly
+    // written image
+    QString partialPath = cachedPath + ".part";
+    QFile::remove(partialPath);
+    if (!QFile::copy(QString::fromStdString(outputPath), partialPath))
+        return false;
+    if (!QFile::rename(partialPath, cachedPath)) {
+        QFile::remove(partialPath);
+        return QFileInfo::exists(cachedPath);
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../utils/sceneparser.h"
+#include "raytracer.h"
+
+#include <string>
+
+// Computes the key of a render in the result cache: a SHA-256 over the
+// evaluated scene, the settings of the ray tracer that change its output, the
+// canvas size and the contents of every texture and mesh the scene refers to,
+// as a hex string. Equal keys mean the renders are interchangeable.
+std::string renderCacheKey(const RenderData &data, const RayTracer::Config &config,
+                           int width, int height);
+
+// Puts the cached image of a key at outputPath, as a hard link or else a
+// copy. The cached image has the file extension of outputPath, so PNG and PPM
+// outputs are cached separately. Returns false if there is none.
+bool fetchCachedRender(const std::string &cacheDirectory, const std::string &key,
+                       const std::string &outputPath);
+
+// Adds the image saved at outputPath to the cache under a key. Returns whether
+// it was stored.
+bool storeCachedRender(const std::string &cacheDirectory, const std::string &key,
+                       const std::string &outputPath);
@@ -0,0 +1,205 @@
+#include "temporalcache.h"
+#include "../utils/tracing.h"
+#include "damageregion.h"
+#include "raytracescene.h"
+
+#include <algorithm>
+#include <cfloat>
+
+/**
+ * @brief isMoving: checks whether a shape moves over the shutter
+ * @param shape: the shape to check
+ * @return true for the moving primitives
+ */
+bool isMoving(const RenderShapeData &shape) {
+    return shape.primitive.type == PrimitiveType::PRIMITIVE_SPHERE_MOVING ||
+           shape.primitive.type == PrimitiveType::PRIMITIVE_CUBE_MOVING ||
+           shape.primitive.type == PrimitiveType::PRIMITIVE_CONE_MOVING ||
+           shape.primitive.type == PrimitiveType::PRIMITIVE_CYLINDER_MOVING;
+}
+
+/**
+ * @brief viewIndependent: checks whether a shape looks the same from every
+ * direction, so that its result can be reused by a moving camera
+ * @param shape: the shape to check
+ * @param globalData: the global coefficients of the scene
+ * @return true if the shape has no specular, reflective or transparent term
+ * and does not move over the shutter
+ */
+bool viewIndependent(const RenderShapeData &shape, const SceneGlobalData &globalData) {
+    const SceneMaterial &material = shape.primitive.material;
+    bool specular = globalData.ks != 0 && glm::vec3(material.cSpecular) != glm::vec3(0);
+    bool reflective = glm::vec3(material.cReflective) != glm::vec3(0);
+    bool transparent = glm::vec3(material.cTransparent) != glm::vec3(0);
+    return !specular && !reflective && !transparent && !isMoving(shape);
+}
+
+/**
+ * @brief TemporalCache::TemporalCache: creates an empty cache
+ * @param maxAge: frames in a row a result may be reused for
+ */
+TemporalCache::TemporalCache(int maxAge) : m_maxAge(maxAge) {}
+
+/**
+ * @brief TemporalCache::maxAge: getter for the m_maxAge field
+ * @return the frames in a row a result may be reused for
+ */
+int TemporalCache::maxAge() const { return m_maxAge; }
+
+/**
+ * @brief TemporalCache::beginFrame: finds what changed since the previous
+ * frame
+ * @param scene: the scene of the frame about to be rendered
+ */
+void TemporalCache::beginFrame(const RayTraceScene &scene) {
+    TRACE_SPAN("TemporalCache::beginFrame");
+    const std::vector<RenderShapeData> &shapes = scene.getShapes();
+    int pixels = scene.width() * scene.height();
+
+    // nothing carries over from a different scene, canvas or lighting
+    m_valid = (int)m_previous.size() == pixels &&
+              m_previousCTMs.size() == shapes.size() &&
+              m_previousLights.size() == scene.getLights().size();
+    for (int i = 0; m_valid && i < (int)m_previousLights.size(); i++)
+        m_valid = sameLight(m_previousLights[i], scene.getLights()[i]);
+
+    // shapes that moved are neither reused nor trusted not to cast new
+    // shadows, anywhere between where they were and where they are
+    m_reusableShapes.assign(shapes.size(), false);
+    m_movedBounds.clear();
+    m_movingBounds.clear();
+    for (int i = 0; m_valid && i < (int)shapes.size(); i++) {
+        bool moved = shapes[i].ctm != m_previousCTMs[i];
+        if (moved) {
+            RenderShapeData previous = shapes[i];
+            previous.ctm = m_previousCTMs[i];
+            AABB bounds = shapeBounds(previous);
+            bounds.expand(shapeBounds(shapes[i]));
+            m_movedBounds.push_back(bounds);
+            // meshes have no bounds to test shadows against
+            if (bounds.surfaceArea() <= 0)
+                m_valid = false;
+        }
+        m_reusableShapes[i] = !moved && viewIndependent(shapes[i], scene.getGlobalData());
+        if (isMoving(shapes[i]))
+            m_movingBounds.push_back(shapeBounds(shapes[i]));
+    }
+
+    m_lights = scene.getLights();
+    m_previousLights = scene.getLights();
+    m_previousCTMs.clear();
+    for (const RenderShapeData &shape : shapes)
+        m_previousCTMs.push_back(shape.ctm);
+    m_current.assign(pixels, Entry());
+}
+
+/**
+ * @brief TemporalCache::cellKey: hashes the coordinates of a grid cell
+ * @param cell: the integer coordinates of the cell
+ * @return the key, which may collide for cells far apart
+ */
+std::uint64_t TemporalCache::cellKey(const glm::ivec3 &cell) const {
+    const std::uint64_t mask = (1u << 21) - 1;
+    return (((std::uint64_t)cell.x & mask) << 42) |
+           (((std::uint64_t)cell.y & mask) << 21) | ((std::uint64_t)cell.z & mask);
+}
+
+/**
+ * @brief TemporalCache::lookup: finds the previous frame's result for a point
+ * @param shapeIndex: the shape the point is on
+ * @param origin: where the point is seen from, in world space
+ * @param position: the point, in world space
+ * @param radiance: set to the previous result if one can be reused
+ * @param age: set to the frames in a row the result has been reused for
+ * @return true if the previous frame saw the point and its result still holds
+ */
+bool TemporalCache::lookup(int shapeIndex, const glm::vec3 &origin,
+                           const glm::vec3 &position, RGBA &radiance,
+                           int &age) const {
+    if (!m_valid || shapeIndex < 0 || !m_reusableShapes[shapeIndex])
+        return false;
+
+    // a shape moving over the shutter may cover the point for part of it
+    glm::vec3 inverseDirection = 1.f / (position - origin);
+    for (const AABB &bounds : m_movingBounds) {
+        if (bounds.intersects(origin, inverseDirection, 1))
+            return false;
+    }
+
+    // the closest point of the previous frame on the same shape, within half
+    // of its pixel
+    const Entry *closest = nullptr;
+    float closestDistance = FLT_MAX;
+    glm::ivec3 cell = glm::ivec3(glm::floor(position / m_cellSize));
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dz = -1; dz <= 1; dz++) {
+                std::uint64_t key = cellKey(cell + glm::ivec3(dx, dy, dz));
+                auto it = std::lower_bound(m_previousCells.begin(), m_previousCells.end(),
+                                           std::make_pair(key, -1));
+                for (; it != m_previousCells.end() && it->first == key; it++) {
+                    const Entry &entry = m_previous[it->second];
+                    float distance = glm::length(entry.position - position);
+                    if (entry.shapeIndex == shapeIndex && distance < 0.5f * entry.footprint &&
+                        distance < closestDistance) {
+                        closest = &entry;
+                        closestDistance = distance;
+                    }
+                }
+            }
+        }
+    }
+    if (closest == nullptr || closest->age >= m_maxAge ||
+        lightPathsCross(position, m_lights, m_movedBounds))
+        return false;
+
+    radiance = closest->radiance;
+    age = closest->age;
+    return true;
+}
+
+/**
+ * @brief TemporalCache::store: records the result of a pixel
+ * @param index: index of the pixel in the image
+ * @param shapeIndex: the shape the pixel saw, -1 if it cannot be reused
+ * @param position: the point the pixel saw, in world space
+ * @param footprint: the width of the pixel at the point
+ * @param radiance: the result of the pixel
+ * @param age: frames in a row the result has been reused for
+ */
+void TemporalCache::store(int index, int shapeIndex, const glm::vec3 &position,
+                          float footprint, RGBA radiance, int age) {
+    m_current[index] = Entry{shapeIndex, position, footprint, radiance, age};
+}
+
+/**
+ * @brief TemporalCache::endFrame: sorts the results of the frame into grid
+ * cells for the lookups of the next frame
+ */
+void TemporalCache::endFrame() {
+    TRACE_SPAN("TemporalCache::endFrame");
+    m_previous.swap(m_current);
+    m_current.clear();
+
+    // cells as wide as a typical pixel footprint, so that a lookup only has
+    // to search the neighboring cells
+    std::vector<float> footprints;
+    for (const Entry &entry : m_previous) {
+        if (entry.shapeIndex >= 0)
+            footprints.push_back(entry.footprint);
+    }
+    if (!footprints.empty()) {
+        std::nth_element(footprints.begin(), footprints.begin() + footprints.size() / 2,
+                         footprints.end());
+        m_cellSize = std::max(footprints[footprints.size() / 2], 1e-6f);
+    }
+
+    m_previousCells.clear();
+    for (int i = 0; i < (int)m_previous.size(); i++) {
+        if (m_previous[i].shapeIndex >= 0) {
+            glm::ivec3 cell = glm::ivec3(glm::floor(m_previous[i].position / m_cellSize));
+            m_previousCells.push_back({cellKey(cell), i});
+        }
+    }
+    std::sort(m_previousCells.begin(), m_previousCells.end());
+}
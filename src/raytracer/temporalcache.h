@@ -0,0 +1,87 @@
+#pragma once
+
+#include "../utils/rgba.h"
+#include "../utils/scenedata.h"
+#include "bvh.h"
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <utility>
+#include <vector>
+
+class RayTraceScene;
+
+/**
+ * @brief The TemporalCache class: keeps the result of every pixel of the
+ * previous frame of an animation with the surface point the pixel saw. A pixel
+ * of the next frame that sees the same point reuses the result instead of
+ * being rendered, as long as the point is on a shape that did not move, its
+ * shading does not depend on the view (no specular, reflection or
+ * refraction), and no light or moved shape can change its lighting.
+ *
+ * Points are matched in world space rather than by projecting them into the
+ * previous camera, since the lens assembly makes that projection non-linear.
+ */
+class TemporalCache {
+public:
+    // constructor for a cache whose results are reused for at most maxAge
+    // frames in a row before the pixel is rendered again
+    explicit TemporalCache(int maxAge);
+
+    // compares the scene with that of the previous frame to find what can be
+    // reused, to be called before rendering a frame
+    void beginFrame(const RayTraceScene &scene);
+
+    // looks up the previous frame's result for the point position on shape
+    // shapeIndex, seen from origin, returns false if the pixel has to be
+    // rendered
+    bool lookup(int shapeIndex, const glm::vec3 &origin,
+                const glm::vec3 &position, RGBA &radiance, int &age) const;
+
+    // records the result of the pixel at index for the next frame; footprint
+    // is the size of the pixel at the point, and shapeIndex -1 means the
+    // pixel cannot be reused
+    void store(int index, int shapeIndex, const glm::vec3 &position,
+               float footprint, RGBA radiance, int age);
+
+    // makes the results stored during the frame available to the next one
+    void endFrame();
+
+    // the number of frames in a row a result may be reused for
+    int maxAge() const;
+
+private:
+    struct Entry {
+        int shapeIndex = -1;
+        glm::vec3 position = glm::vec3(0);
+        float footprint = 0;
+        RGBA radiance;
+        int age = 0;
+    };
+
+    // key of the grid cell containing a position
+    std::uint64_t cellKey(const glm::ivec3 &cell) const;
+
+    int m_maxAge;
+
+    // the previous frame: its pixels, sorted into grid cells of side
+    // m_cellSize for the lookups
+    std::vector<Entry> m_previous;
+    std::vector<std::pair<std::uint64_t, int>> m_previousCells;
+    float m_cellSize = 1;
+
+    // the frame being rendered
+    std::vector<Entry> m_current;
+
+    // what changed since the previous frame
+    bool m_valid = false;
+    std::vector<bool> m_reusableShapes;
+    std::vector<AABB> m_movedBounds;
+    // shapes that move over the shutter, which a probe at one time may miss
+    std::vector<AABB> m_movingBounds;
+    std::vector<SceneLightData> m_lights;
+
+    // the scene of the previous frame, to compare with
+    std::vector<glm::mat4> m_previousCTMs;
+    std::vector<SceneLightData> m_previousLights;
+};
@@ -7,7 +7,7 @@
  * @param direction: the direction of the ray in object space
  * @return the t value for the parameterized ray that intersects the sphere
  */
-auto ConeIntersect(glm::vec3 point, glm::vec3 direction) {
+inline auto ConeIntersect(glm::vec3 point, glm::vec3 direction) {
     return ShapeIntersect{[=]() {
         // vector of t values to consider
         std::vector<float> tValues = std::vector<float>();
@@ -77,7 +77,7 @@ auto ConeIntersect(glm::vec3 point, glm::vec3 direction) {
  * @param intersection: the intersection point in object space
  * @return a normal vector to the object in object space
  */
-auto ConeNormal(glm::vec3 intersection) {
+inline auto ConeNormal(glm::vec3 intersection) {
     return ShapeNormal{[=]() {
         // define constants
         float x = intersection[0], y = intersection[1], z = intersection[2];
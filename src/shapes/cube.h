@@ -7,7 +7,7 @@
  * @param direction: the direction of the ray in object space
  * @return the t value for the parameterized ray that intersects the sphere
  */
-auto CubeIntersect(glm::vec3 point, glm::vec3 direction) {
+inline auto CubeIntersect(glm::vec3 point, glm::vec3 direction) {
     return ShapeIntersect{[=]() {
         // define useful constants and vector of potential t values
         float px = point[0], py = point[1], pz = point[2];
@@ -86,7 +86,7 @@ auto CubeIntersect(glm::vec3 point, glm::vec3 direction) {
  * @param intersection: the intersection point in object space
  * @return a normal vector to the object in object space
  */
-auto CubeNormal(glm::vec3 intersection) {
+inline auto CubeNormal(glm::vec3 intersection) {
     return ShapeNormal{[=]() {
         // define constants
         float x = intersection[0], y = intersection[1], z = intersection[2];
@@ -116,7 +116,7 @@ auto CubeNormal(glm::vec3 intersection) {
  * @param direction: the direction of the ray in object space
  * @return the t value for the parameterized ray that intersects the sphere
  */
-auto movingCubeIntersect(glm::vec3 point, glm::vec3 direction, double time, glm::vec3 center2) {
+inline auto movingCubeIntersect(glm::vec3 point, glm::vec3 direction, double time, glm::vec3 center2) {
     return ShapeIntersect{[=]() {
         // define useful constants and vector of potential t values
 
@@ -199,7 +199,7 @@ auto movingCubeIntersect(glm::vec3 point, glm::vec3 direction, double time, glm:
  * @param intersection: the intersection point in object space
  * @return a normal vector to the object in object space
  */
-auto movingCubeNormal(glm::vec3 intersection, double time, glm::vec3 center2) {
+inline auto movingCubeNormal(glm::vec3 intersection, double time, glm::vec3 center2) {
     return ShapeNormal{[=]() {
         // define constants
         glm::vec3 center_direc = (center2 - glm::vec3(0, 0, 0)); // assuming all are centered in the origin in object space.
@@ -8,7 +8,7 @@
  * @param direction: the direction of the ray in object space
  * @return the t value for the parameterized ray that intersects the sphere
  */
-auto SphereIntersect(glm::vec3 point, glm::vec3 direction) {
+inline auto SphereIntersect(glm::vec3 point, glm::vec3 direction) {
     return ShapeIntersect{[=]() {
         // define useful constants
         float px = point[0], py = point[1], pz = point[2];
@@ -46,7 +46,7 @@ auto SphereIntersect(glm::vec3 point, glm::vec3 direction) {
  * @param intersection: the intersection point in object space
  * @return a normal vector to the object in object space
  */
-auto SphereNormal(glm::vec3 intersection) {
+inline auto SphereNormal(glm::vec3 intersection) {
     return ShapeNormal{[=]() {
         // compute and return the object normal
         return glm::vec4(2.f * intersection[0], 2.f * intersection[1],
@@ -65,7 +65,7 @@ auto SphereNormal(glm::vec3 intersection) {
 
 
 
-auto movingSphereIntersect(glm::vec3 point, glm::vec3 direction, double time, glm::vec3 center2) {
+inline auto movingSphereIntersect(glm::vec3 point, glm::vec3 direction, double time, glm::vec3 center2) {
     return ShapeIntersect{[=]() {
         // define useful constants
         // compute the current center.
@@ -104,7 +104,7 @@ auto movingSphereIntersect(glm::vec3 point, glm::vec3 direction, double time, gl
  * @param intersection: the intersection point in object space
  * @return a normal vector to the object in object space
  */
-auto movingSphereNormal(glm::vec3 intersection, double time, glm::vec3 center2) {
+inline auto movingSphereNormal(glm::vec3 intersection, double time, glm::vec3 center2) {
     return ShapeNormal{[=]() {
         // using time compute the current center.
         // compute and return the object normal
@@ -7,12 +7,14 @@
 #include "../utils/scenedata.h"
 #include "raytracer/raytracescene.h"
 
+#include "../raytracer/bvh.h"
 #include "../raytracer/raytracescene.h"
 #include "../shapes/cone.h"
 #include "../shapes/cube.h"
 #include "../shapes/cylinder.h"
 #include "../shapes/shapeoverall.h"
 #include "../shapes/sphere.h"
+#include "../utils/renderstats.h"
 #include "../utils/scenedata.h"
 #include <cfloat>
 #include <cmath>
@@ -21,42 +23,20 @@
 #include <iostream>
 
 /**
- * @brief traceRay: traces a single ray and tracks intersections with implicitly
- * defined objects in a scene
+ * @brief intersectShape: intersects a ray with a single shape
+ * @param primitiveShape: the shape to intersect
+ * @param shapeIndex: index of the shape in the scene, for the statistics
  * @param position: starting position of the ray
  * @param direction: direction of the ray
- * @param scene: information about the scene
- * @param config: configuration of the raytracer
- * @param completedReflections: how many reflections the current ray has already
- * undergone
  * @param time: with potential object movement
- * @return the color in the scene that the ray hits
+ * @return the distance along direction to the intersection, -1 if none
  */
-RGBA traceRay(glm::vec4 position, glm::vec4 direction,
-              const RayTraceScene &scene, const RayTracer::Config &config,
-              int completedReflections, double time) {
-  // default return color is black
-  RGBA toReturnColor = RGBA{0, 0, 0};
-
-  // include variables to store information about minimum
-  bool hitObject = false;
-  float minT = FLT_MAX;
-  glm::mat4 minTCTM;
-  PrimitiveType minTType;
-  SceneMaterial minTMaterial;
-  glm::mat4 inverseMinTCTM;
-  glm::vec3 min_center2;
-  PrimitiveType shapeType;
-
-  // go through each shape and get minimum intersection
-  for (const RenderShapeData &primitiveShape : scene.getShapes()) {
+float intersectShape(const RenderShapeData &primitiveShape, int shapeIndex,
+                     glm::vec4 position, glm::vec4 direction, double time) {
     // transform ray into object space
-      // FIX FROM INTERSECT MENTOR MEETING: I am no longer truncating the ctm
-      // inverse here for direction
-      glm::vec4 objectPosition = primitiveShape.inverseCTM * position;
+    glm::vec4 objectPosition = primitiveShape.inverseCTM * position;
     glm::vec4 objectDirection = primitiveShape.inverseCTM * direction;
 
-      // define starting minimum and go through each shape
     float potentialMinT = -1;
     switch (primitiveShape.primitive.type) {
     case PrimitiveType::PRIMITIVE_CUBE: {
@@ -80,8 +60,8 @@ RGBA traceRay(glm::vec4 position, glm::vec4 direction,
     case PrimitiveType::PRIMITIVE_SPHERE_MOVING: {
         potentialMinT =
             movingSphereIntersect(objectPosition, objectDirection, time,
-                                              primitiveShape.primitive.center2)
-                            .getIntersection();
+                                  primitiveShape.primitive.center2)
+                .getIntersection();
         break;
     }
     case PrimitiveType::PRIMITIVE_CUBE_MOVING: {
@@ -101,6 +81,108 @@ RGBA traceRay(glm::vec4 position, glm::vec4 direction,
         break;
     }
 
+    RENDER_STAT(intersectionTests[(int)primitiveShape.primitive.type]++);
+    RENDER_STAT(countPrimitive(shapeIndex, &PrimitiveCost::tests));
+    if (potentialMinT != -1.f) {
+        RENDER_STAT(intersectionHits[(int)primitiveShape.primitive.type]++);
+        RENDER_STAT(countPrimitive(shapeIndex, &PrimitiveCost::hits));
+    }
+    return potentialMinT;
+}
+
+/**
+ * @brief shapeNormal: computes the surface normal of a shape where a ray hits it
+ * @param shape: the shape that was hit
+ * @param position: starting position of the ray
+ * @param direction: direction of the ray
+ * @param t: distance along direction to the hit
+ * @param time: with potential object movement
+ * @return the world space normal, facing the ray but not normalized
+ */
+glm::vec3 shapeNormal(const RenderShapeData &shape, glm::vec4 position,
+                      glm::vec4 direction, float t, double time) {
+    // get object position and direction
+    glm::vec4 objectNormal = glm::vec4(0);
+    glm::vec4 objectHit = shape.inverseCTM * position + t * (shape.inverseCTM * direction);
+
+    // compute normal based on type of shape
+    switch (shape.primitive.type) {
+    case PrimitiveType::PRIMITIVE_CUBE:
+        objectNormal = CubeNormal(objectHit).getObjectNormal();
+        break;
+    case PrimitiveType::PRIMITIVE_CONE:
+        objectNormal = ConeNormal(objectHit).getObjectNormal();
+        break;
+    case PrimitiveType::PRIMITIVE_CYLINDER:
+        objectNormal = CylinderNormal(objectHit).getObjectNormal();
+        break;
+    case PrimitiveType::PRIMITIVE_SPHERE:
+        objectNormal = SphereNormal(objectHit).getObjectNormal();
+        break;
+    case PrimitiveType::PRIMITIVE_SPHERE_MOVING:
+        objectNormal = movingSphereNormal(objectHit, time, shape.primitive.center2)
+                           .getObjectNormal();
+        break;
+    case PrimitiveType::PRIMITIVE_CUBE_MOVING:
+        objectNormal = movingCubeNormal(objectHit, time, shape.primitive.center2)
+                           .getObjectNormal();
+        break;
+    case PrimitiveType::PRIMITIVE_MESH:
+        // unimplemented
+        break;
+    case PrimitiveType::PRIMITIVE_CONE_MOVING:
+        // unimplemented
+        break;
+    case PrimitiveType::PRIMITIVE_CYLINDER_MOVING:
+        // unimplemented
+        break;
+    }
+
+    // transform the normal into world space, ensure proper direction
+    glm::vec3 normal = glm::inverse(glm::transpose(glm::mat3(shape.ctm))) *
+                       glm::vec3(objectNormal);
+    if (glm::dot(normal, glm::vec3(-direction)) < 0) {
+        normal = -normal;
+    }
+    return normal;
+}
+
+/**
+ * @brief traceRay: traces a single ray and tracks intersections with implicitly
+ * defined objects in a scene
+ * @param position: starting position of the ray
+ * @param direction: direction of the ray
+ * @param scene: information about the scene
+ * @param config: configuration of the raytracer
+ * @param completedReflections: how many reflections the current ray has already
+ * undergone
+ * @param time: with potential object movement
+ * @param hitInfo: if not null, filled in with auxiliary information about the
+ * closest hit
+ * @return the color in the scene that the ray hits
+ */
+RGBA traceRay(glm::vec4 position, glm::vec4 direction,
+              const RayTraceScene &scene, const RayTracer::Config &config,
+              int completedReflections, double time, RayHitInfo *hitInfo) {
+  // default return color is black
+  RGBA toReturnColor = RGBA{0, 0, 0};
+
+  // include variables to store information about minimum
+  bool hitObject = false;
+  float minT = FLT_MAX;
+  glm::mat4 minTCTM;
+  PrimitiveType minTType;
+  SceneMaterial minTMaterial;
+  glm::mat4 inverseMinTCTM;
+  glm::vec3 min_center2;
+  int minTShapeIndex = -1;
+
+  // test a shape, keeping it if it is the closest so far
+  const std::vector<RenderShapeData> &shapes = scene.getShapes();
+  auto testShape = [&](int shapeIndex) {
+    const RenderShapeData &primitiveShape = shapes[shapeIndex];
+    float potentialMinT = intersectShape(primitiveShape, shapeIndex, position, direction, time);
+
     // if a new minimum was found, update the stored information
     if (potentialMinT != -1.f && potentialMinT < minT) {
       hitObject = true;
@@ -109,6 +191,7 @@ RGBA traceRay(glm::vec4 position, glm::vec4 direction,
       minTType = primitiveShape.primitive.type;
       minTMaterial = primitiveShape.primitive.material;
       inverseMinTCTM = primitiveShape.inverseCTM;
+      minTShapeIndex = shapeIndex;
       if (PrimitiveType::PRIMITIVE_SPHERE_MOVING ==
               primitiveShape.primitive.type ||
           PrimitiveType::PRIMITIVE_CUBE_MOVING ==
@@ -120,74 +203,63 @@ RGBA traceRay(glm::vec4 position, glm::vec4 direction,
           min_center2 = primitiveShape.primitive.center2;
       }
     }
+  };
+
+  // go through the shapes the BVH cannot rule out, or through each shape,
+  // and get minimum intersection
+  if (const BVH *bvh = scene.getAcceleration()) {
+    bvh->traverse(position, direction, minT, testShape);
+  } else {
+    for (int shapeIndex = 0; shapeIndex < (int)shapes.size(); shapeIndex++) {
+      testShape(shapeIndex);
+    }
   }
 
   // if an object was hit, do the lighting computation
   if (hitObject) {
       // get object position and direction
-      glm::vec4 objectNormal;
       glm::vec4 objectPosition = inverseMinTCTM * position;
       glm::vec4 objectDirection = inverseMinTCTM * direction;
+      glm::vec3 normal = shapeNormal(shapes[minTShapeIndex], position, direction, minT, time);
 
-      // compute normal based on type of shape
-      switch (minTType) {
-      case PrimitiveType::PRIMITIVE_CUBE: {
-          objectNormal =
-              CubeNormal(objectPosition + minT * objectDirection).getObjectNormal();
-          break;
-      }
-      case PrimitiveType::PRIMITIVE_CONE: {
-          objectNormal =
-              ConeNormal(objectPosition + minT * objectDirection).getObjectNormal();
-          break;
-      }
-      case PrimitiveType::PRIMITIVE_CYLINDER: {
-          objectNormal = CylinderNormal(objectPosition + minT * objectDirection)
-                             .getObjectNormal();
-          break;
-      }
-      case PrimitiveType::PRIMITIVE_SPHERE: {
-          objectNormal = SphereNormal(objectPosition + minT * objectDirection)
-                             .getObjectNormal();
-          break;
-      }
-      case PrimitiveType::PRIMITIVE_SPHERE_MOVING: {
-          objectNormal =
-              movingSphereNormal((objectPosition + minT * objectDirection), time,
-                                            min_center2)
-                             .getObjectNormal();
-          break;
-      }
-      case PrimitiveType::PRIMITIVE_CUBE_MOVING: {
-          objectNormal = movingCubeNormal((objectPosition + minT * objectDirection),
-                                          time, min_center2)
-                             .getObjectNormal();
-          break;
-      }
-      case PrimitiveType::PRIMITIVE_MESH:
-          // unimplemented
-          break;
-      case PrimitiveType::PRIMITIVE_CONE_MOVING:
-          // unimplemented
-          break;
-      case PrimitiveType::PRIMITIVE_CYLINDER_MOVING:
-          // unimplemented
-          break;
+      // the radius a pixel covers at the hit in object space, which picks the
+      // mip level of filtered textures; reflected and refracted rays only
+      // count their last segment
+      float pixelSpread = 2 * std::tan(scene.getCamera().getHeightAngle() / 2) / scene.height();
+      float textureFootprint = 0.5f * pixelSpread * minT * glm::length(glm::vec3(objectDirection));
+
+      // record auxiliary information about the hit if requested
+      if (hitInfo != nullptr) {
+          hitInfo->hit = true;
+          hitInfo->shapeIndex = minTShapeIndex;
+          hitInfo->position = position + minT * direction;
+          hitInfo->normal = glm::normalize(normal);
+          hitInfo->albedo =
+              getAlbedo(minTMaterial, config, minTType,
+                        objectPosition + minT * objectDirection, time, min_center2,
+                        textureFootprint);
+          if (minTType == PrimitiveType::PRIMITIVE_SPHERE_MOVING ||
+              minTType == PrimitiveType::PRIMITIVE_CUBE_MOVING) {
+              // moving shapes travel by center2 in object space over the shutter
+              hitInfo->velocity = minTCTM * glm::vec4(min_center2, 0.f);
+          }
       }
 
-      // transform the normal into world space, ensure proper direction
-      glm::vec3 normal = glm::inverse(glm::transpose(glm::mat3(minTCTM))) *
-                         glm::vec3(objectNormal);
-      if (glm::dot(normal, glm::vec3(-direction)) < 0) {
-          normal = -normal;
+      // visualize the normal instead of shading when asked to
+      if (config.onlyRenderNormals) {
+          glm::vec3 color = 255.f * (0.5f * glm::normalize(normal) + 0.5f);
+          return RGBA{(std::uint8_t)color.r, (std::uint8_t)color.g,
+                      (std::uint8_t)color.b};
       }
 
       // compute the lighting
+      RENDER_STAT(countPrimitive(minTShapeIndex, &PrimitiveCost::shades));
       toReturnColor =
           phong(position + minT * direction, glm::vec4(normal, 0), -direction,
                             minTMaterial, scene.getLights(), scene.getGlobalData(), scene,
                             config, completedReflections, minTType,
-                            objectPosition + minT * objectDirection, time, min_center2);
+                            objectPosition + minT * objectDirection, time, min_center2,
+                            textureFootprint);
   }
 
   // return the color hit by the ray
@@ -195,78 +267,70 @@ RGBA traceRay(glm::vec4 position, glm::vec4 direction,
 }
 
 /**
- * @brief traceShadowRay: traces a single ray and tracks intersections with
- * implicitly defined objects in a scene
+ * @brief findClosestHit: finds the closest shape along a ray
  * @param position: starting position of the ray
  * @param direction: direction of the ray
  * @param scene: information about the scene
  * @param time: with potential object movement
- * @return the distance of the closest object from the current one
+ * @param t: set to the distance along direction to the hit, if any
+ * @return the index of the closest shape hit, -1 if none
  */
-float traceShadowRay(glm::vec4 position, glm::vec4 direction,
-                     const RayTraceScene &scene, double time) {
-    // default return value if no objects are hit
-    float toReturnDistance = -1.f;
-
+int findClosestHit(glm::vec4 position, glm::vec4 direction,
+                   const RayTraceScene &scene, double time, float &t) {
     // include variables to store information about minimum
-    bool hitObject = false;
     float minT = FLT_MAX;
+    int minTShapeIndex = -1;
 
-    // go through each shape and get minimum intersection
-    for (const RenderShapeData &primitiveShape : scene.getShapes()) {
-        // transform ray into object space
-        glm::vec4 objectPosition = primitiveShape.inverseCTM * position;
-        glm::vec4 objectDirection = primitiveShape.inverseCTM * direction;
-
-        // define starting minimum and go through each shape
-        float potentialMinT = -1;
-        switch (primitiveShape.primitive.type) {
-        case PrimitiveType::PRIMITIVE_CUBE: {
-            potentialMinT =
-                CubeIntersect(objectPosition, objectDirection).getIntersection();
-            break;
-        }
-        case PrimitiveType::PRIMITIVE_CONE:
-            potentialMinT =
-                ConeIntersect(objectPosition, objectDirection).getIntersection();
-            break;
-        case PrimitiveType::PRIMITIVE_CYLINDER:
-            potentialMinT =
-                CylinderIntersect(objectPosition, objectDirection).getIntersection();
-            break;
-        case PrimitiveType::PRIMITIVE_SPHERE: {
-            potentialMinT =
-                SphereIntersect(objectPosition, objectDirection).getIntersection();
-            break;
-        }
-        case PrimitiveType::PRIMITIVE_SPHERE_MOVING: {
-            potentialMinT =
-                movingSphereIntersect(objectPosition, objectDirection, time,
-                                                  primitiveShape.primitive.center2)
-                                .getIntersection();
-            break;
-        }
-        case PrimitiveType::PRIMITIVE_CUBE_MOVING: {
-            potentialMinT = movingCubeIntersect(objectPosition, objectDirection, time,
-                                                primitiveShape.primitive.center2)
-                                .getIntersection();
-            break;
-        }
-        case PrimitiveType::PRIMITIVE_MESH:
-            break;
-        }
-
-        // if a new minimum was found, update the stored information
+    // test a shape, keeping it if it is the closest so far
+    const std::vector<RenderShapeData> &shapes = scene.getShapes();
+    auto testShape = [&](int shapeIndex) {
+        float potentialMinT = intersectShape(shapes[shapeIndex], shapeIndex, position, direction, time);
         if (potentialMinT != -1.f && potentialMinT < minT) {
-            hitObject = true;
             minT = potentialMinT;
+            minTShapeIndex = shapeIndex;
+        }
+    };
+
+    // go through the shapes the BVH cannot rule out, or through each shape,
+    // and get minimum intersection
+    if (const BVH *bvh = scene.getAcceleration()) {
+        bvh->traverse(position, direction, minT, testShape);
+    } else {
+        for (int shapeIndex = 0; shapeIndex < (int)shapes.size(); shapeIndex++) {
+            testShape(shapeIndex);
         }
     }
 
-    // if an object was hit, do the lighting computation
-    if (hitObject) {
+    t = minT;
+    return minTShapeIndex;
+}
+
+/**
+ * @brief traceShadowRay: traces a single ray and tracks intersections with
+ * implicitly defined objects in a scene
+ * @param position: starting position of the ray
+ * @param direction: direction of the ray
+ * @param scene: information about the scene
+ * @param time: with potential object movement
+ * @param hitShapeIndex: if not null, set to the index of the closest shape hit
+ * @return the distance of the closest object from the current one
+ */
+float traceShadowRay(glm::vec4 position, glm::vec4 direction,
+                     const RayTraceScene &scene, double time,
+                     int *hitShapeIndex) {
+    RENDER_STAT(shadowRays++);
+
+    // default return value if no objects are hit
+    float toReturnDistance = -1.f;
+
+    float minT;
+    int minTShapeIndex = findClosestHit(position, direction, scene, time, minT);
+    if (minTShapeIndex >= 0) {
         toReturnDistance = glm::length(minT * direction);
     }
+    if (hitShapeIndex != nullptr) {
+        *hitShapeIndex = minTShapeIndex;
+    }
 
     // return the distance to nearest object
     return toReturnDistance;
@@ -1,14 +1,23 @@
 #ifndef TRACESINGLERAY_H
 #define TRACESINGLERAY_H
 
+#include "../raytracer/aovbuffers.h"
 #include "../raytracer/raytracer.h"
 #include "../raytracer/raytracescene.h"
 #include "../utils/rgba.h"
 
 RGBA traceRay(glm::vec4 position, glm::vec4 direction,
-              const RayTraceScene &scene, const RayTracer::Config &config, int completedReflections, double time);
+              const RayTraceScene &scene, const RayTracer::Config &config, int completedReflections, double time,
+              RayHitInfo *hitInfo = nullptr);
+
+glm::vec3 shapeNormal(const RenderShapeData &shape, glm::vec4 position,
+                      glm::vec4 direction, float t, double time);
+
+int findClosestHit(glm::vec4 position, glm::vec4 direction,
+                   const RayTraceScene &scene, double time, float &t);
 
 float traceShadowRay(glm::vec4 position, glm::vec4 direction,
-                     const RayTraceScene &scene, double time);
+                     const RayTraceScene &scene, double time,
+                     int *hitShapeIndex = nullptr);
 
 #endif // TRACESINGLERAY_H
@@ -0,0 +1,93 @@
+#include "imagecompare.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief computePSNR: measures how close an image is to a reference
+ * @param image: the image to measure
+ * @param reference: the image it should match
+ * @param width: width of both images
+ * @param height: height of both images
+ * @return the PSNR in dB
+ */
+double computePSNR(const RGBA *image, const RGBA *reference, int width,
+                   int height) {
+    double squaredError = 0;
+    for (int i = 0; i < width * height; i++) {
+        double dr = image[i].r - reference[i].r;
+        double dg = image[i].g - reference[i].g;
+        double db = image[i].b - reference[i].b;
+        squaredError += dr * dr + dg * dg + db * db;
+    }
+    double meanSquaredError = squaredError / (3.0 * width * height);
+    if (meanSquaredError == 0)
+        return std::numeric_limits<double>::infinity();
+    return 10 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+/**
+ * @brief luma: converts the pixels of an image to Rec. 601 luma
+ */
+std::vector<double> luma(const RGBA *image, int count) {
+    std::vector<double> values(count);
+    for (int i = 0; i < count; i++)
+        values[i] = 0.299 * image[i].r + 0.587 * image[i].g + 0.114 * image[i].b;
+    return values;
+}
+
+/**
+ * @brief computeSSIM: measures the structural similarity of an image to a
+ * reference, averaging SSIM over 8x8 windows placed every 4 pixels
+ * @param image: the image to measure
+ * @param reference: the image it should match
+ * @param width: width of both images
+ * @param height: height of both images
+ * @return the mean SSIM
+ */
+double computeSSIM(const RGBA *image, const RGBA *reference, int width,
+                   int height) {
+    if (width <= 0 || height <= 0)
+        return 1.0;
+
+    // images smaller than a window are compared as a single window
+    const int window = std::min({8, width, height});
+    const int stride = 4;
+    // stabilizing constants for 8 bit values, from Wang et al. 2004
+    const double c1 = (0.01 * 255) * (0.01 * 255);
+    const double c2 = (0.03 * 255) * (0.03 * 255);
+
+    std::vector<double> x = luma(image, width * height);
+    std::vector<double> y = luma(reference, width * height);
+
+    double total = 0;
+    int windows = 0;
+    for (int top = 0; top + window <= height; top += stride) {
+        for (int left = 0; left + window <= width; left += stride) {
+            double sumX = 0, sumY = 0, sumXX = 0, sumYY = 0, sumXY = 0;
+            for (int j = top; j < top + window; j++) {
+                for (int i = left; i < left + window; i++) {
+                    double a = x[j * width + i];
+                    double b = y[j * width + i];
+                    sumX += a;
+                    sumY += b;
+                    sumXX += a * a;
+                    sumYY += b * b;
+                    sumXY += a * b;
+                }
+            }
+            const double n = window * window;
+            double meanX = sumX / n, meanY = sumY / n;
+            double varianceX = sumXX / n - meanX * meanX;
+            double varianceY = sumYY / n - meanY * meanY;
+            double covariance = sumXY / n - meanX * meanY;
+            total += ((2 * meanX * meanY + c1) * (2 * covariance + c2)) /
+                     ((meanX * meanX + meanY * meanY + c1) *
+                      (varianceX + varianceY + c2));
+            windows++;
+        }
+    }
+    return windows > 0 ? total / windows : 1.0;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "rgba.h"
+
+// Peak signal-to-noise ratio in dB between two images of the same size, over
+// the red, green and blue channels. Identical images give infinity.
+double computePSNR(const RGBA *image, const RGBA *reference, int width,
+                   int height);
+
+// Mean structural similarity between two images of the same size, computed on
+// their luma over 8x8 windows. 1 means identical.
+double computeSSIM(const RGBA *image, const RGBA *reference, int width,
+                   int height);
@@ -0,0 +1,406 @@
+#include "imageencoder.h"
+#include "imagewriter.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Filtered bytes of a PNG deflated as one chunk, about; large enough that
+// restarting the compressor's window at each chunk costs little
+const size_t PNG_CHUNK_BYTES = 256 * 1024;
+
+// Bytes of compressed data per IDAT chunk, at most
+const size_t PNG_IDAT_BYTES = 1 << 20;
+
+/**
+ * @brief lowercaseExtension: gets the extension of a path
+ * @param path: the path
+ * @return its extension without the dot, in lower case
+ */
+std::string lowercaseExtension(const std::string &path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    if (!extension.empty())
+        extension.erase(0, 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return (char)std::tolower(c); });
+    return extension;
+}
+
+/**
+ * @brief encoderSupports: checks whether encodeImage writes a format
+ * @param path: the path of the image
+ * @return True for .png, .qoi, .ppm, .pnm and .pfm
+ */
+bool encoderSupports(const std::string &path) {
+    std::string extension = lowercaseExtension(path);
+    return extension == "png" || extension == "qoi" || extension == "ppm" ||
+           extension == "pnm" || extension == "pfm";
+}
+
+/**
+ * @brief writeBigEndian: writes a 32-bit number, most significant byte first
+ * @param out: the stream
+ * @param value: the number
+ */
+static void writeBigEndian(std::ostream &out, std::uint32_t value) {
+    char bytes[4] = {(char)(value >> 24), (char)(value >> 16), (char)(value >> 8), (char)value};
+    out.write(bytes, 4);
+}
+
+/**
+ * @brief rgbRow: drops the alpha of a row of pixels
+ * @param pixels: the row
+ * @param width: the number of pixels
+ * @param row: filled with 3 bytes per pixel
+ */
+static void rgbRow(const RGBA *pixels, int width, std::uint8_t *row) {
+    for (int i = 0; i < width; i++) {
+        row[3 * i] = pixels[i].r;
+        row[3 * i + 1] = pixels[i].g;
+        row[3 * i + 2] = pixels[i].b;
+    }
+}
+
+/**
+ * @brief writePngChunk: writes a PNG chunk
+ * @param out: the stream
+ * @param type: the four letters of the chunk type
+ * @param data: the data of the chunk
+ * @param size: the number of bytes of data
+ */
+void writePngChunk(std::ostream &out, const char *type, const std::uint8_t *data,
+                   size_t size) {
+    writeBigEndian(out, (std::uint32_t)size);
+    out.write(type, 4);
+    out.write(reinterpret_cast<const char *>(data), (std::streamsize)size);
+
+    // the CRC covers the type and the data; a null buffer would restart it
+    uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+    if (size > 0)
+        crc = crc32(crc, data, (uInt)size);
+    writeBigEndian(out, (std::uint32_t)crc);
+}
+
+/**
+ * @brief writePngHeader: writes the signature and the IHDR chunk
+ * @param out: the stream
+ * @param width: width of the image
+ * @param height: height of the image
+ */
+void writePngHeader(std::ostream &out, int width, int height) {
+    const char signature[8] = {(char)137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+    out.write(signature, 8);
+    // 8-bit RGB, not interlaced
+    std::uint8_t header[13] = {(std::uint8_t)(width >> 24), (std::uint8_t)(width >> 16),
+                               (std::uint8_t)(width >> 8), (std::uint8_t)width,
+                               (std::uint8_t)(height >> 24), (std::uint8_t)(height >> 16),
+                               (std::uint8_t)(height >> 8), (std::uint8_t)height,
+                               8, 2, 0, 0, 0};
+    writePngChunk(out, "IHDR", header, sizeof(header));
+}
+
+/**
+ * @brief paethPredictor: the PNG Paeth predictor of a byte
+ * @param a: the byte to the left
+ * @param b: the byte above
+ * @param c: the byte above to the left
+ * @return whichever of a, b and c is closest to a + b - c
+ */
+static int paethPredictor(int a, int b, int c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+/**
+ * @brief filterPngRow: filters a row of RGB bytes each of the five ways and
+ * keeps the one whose bytes, read as signed, sum to the least
+ * @param row: the bytes of the row
+ * @param previousRow: the bytes of the row above, zeros for the first row
+ * @param rowBytes: the number of bytes of a row
+ * @param filtered: the filter byte and filtered bytes are appended to it
+ */
+void filterPngRow(const std::uint8_t *row, const std::uint8_t *previousRow,
+                  size_t rowBytes, std::vector<std::uint8_t> &filtered) {
+    std::vector<std::uint8_t> best, candidate(rowBytes + 1);
+    long bestSum = -1;
+    for (int filter = 0; filter < 5; filter++) {
+        candidate[0] = (std::uint8_t)filter;
+        long sum = 0;
+        for (size_t k = 0; k < rowBytes; k++) {
+            int a = k >= 3 ? row[k - 3] : 0;
+            int b = previousRow[k];
+            int c = k >= 3 ? previousRow[k - 3] : 0;
+            int predicted = filter == 0   ? 0
+                            : filter == 1 ? a
+                            : filter == 2 ? b
+                            : filter == 3 ? (a + b) / 2
+                                          : paethPredictor(a, b, c);
+            std::uint8_t value = (std::uint8_t)(row[k] - predicted);
+            candidate[k + 1] = value;
+            sum += value < 128 ? value : 256 - value;
+        }
+        if (bestSum < 0 || sum < bestSum) {
+            bestSum = sum;
+            best = candidate;
+        }
+    }
+    filtered.insert(filtered.end(), best.begin(), best.end());
+}
+
+/**
+ * @brief The DeflateChunk struct: rows of a PNG compressed on their own
+ */
+struct DeflateChunk {
+    int firstRow = 0;
+    int lastRow = 0;
+    bool last = false;
+    // the raw deflate data, ending on a byte boundary unless last
+    std::vector<std::uint8_t> compressed;
+    // the Adler-32 and length of the filtered bytes, which the zlib trailer
+    // of the whole image is combined from
+    uLong adler = 1;
+    size_t length = 0;
+    bool compressedAll = false;
+};
+
+/**
+ * @brief encodePng: writes a PNG whose rows are filtered and deflated in
+ * chunks in parallel
+ * @param out: the stream
+ * @param pixels: the image, row by row
+ * @param width: width of the image
+ * @param height: height of the image
+ * @return True if every chunk was compressed
+ *
+ * Each chunk is a run of deflate blocks ended by a sync flush, as pigz does,
+ * so the chunks simply concatenate into a single zlib stream.
+ */
+static bool encodePng(std::ostream &out, const RGBA *pixels, int width, int height) {
+    size_t rowBytes = (size_t)width * 3;
+    int rowsPerChunk = (int)std::max<size_t>(1, PNG_CHUNK_BYTES / (rowBytes + 1));
+    std::vector<DeflateChunk> chunks;
+    for (int y = 0; y < height; y += rowsPerChunk) {
+        DeflateChunk chunk;
+        chunk.firstRow = y;
+        chunk.lastRow = std::min(y + rowsPerChunk, height);
+        chunks.push_back(std::move(chunk));
+    }
+    if (chunks.empty())
+        return false;
+    chunks.back().last = true;
+
+    auto compress = [&](DeflateChunk &chunk) {
+        std::vector<std::uint8_t> row(rowBytes), previousRow(rowBytes, 0), filtered;
+        if (chunk.firstRow > 0)
+            rgbRow(pixels + (size_t)(chunk.firstRow - 1) * width, width, previousRow.data());
+        for (int j = chunk.firstRow; j < chunk.lastRow; j++) {
+            rgbRow(pixels + (size_t)j * width, width, row.data());
+            filterPngRow(row.data(), previousRow.data(), rowBytes, filtered);
+            previousRow.swap(row);
+        }
+        chunk.length = filtered.size();
+        chunk.adler = adler32(adler32(0, Z_NULL, 0), filtered.data(), (uInt)filtered.size());
+
+        z_stream zlib{};
+        if (deflateInit2(&zlib, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK)
+            return;
+        // room for the sync flush marker on top of the bound
+        chunk.compressed.resize(deflateBound(&zlib, (uLong)filtered.size()) + 16);
+        zlib.next_in = filtered.data();
+        zlib.avail_in = (uInt)filtered.size();
+        zlib.next_out = chunk.compressed.data();
+        zlib.avail_out = (uInt)chunk.compressed.size();
+        int status = deflate(&zlib, chunk.last ? Z_FINISH : Z_SYNC_FLUSH);
+        chunk.compressedAll = chunk.last ? status == Z_STREAM_END
+                                         : status == Z_OK && zlib.avail_out > 0;
+        chunk.compressed.resize(chunk.compressed.size() - zlib.avail_out);
+        deflateEnd(&zlib);
+    };
+    QtConcurrent::blockingMap(chunks, compress);
+
+    // a zlib header for the default compression, the chunks, and the
+    // Adler-32 of every filtered byte
+    std::vector<std::uint8_t> stream = {0x78, 0x9c};
+    uLong adler = chunks[0].adler;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        if (!chunks[k].compressedAll)
+            return false;
+        if (k > 0)
+            adler = adler32_combine(adler, chunks[k].adler, (z_off_t)chunks[k].length);
+        stream.insert(stream.end(), chunks[k].compressed.begin(), chunks[k].compressed.end());
+        // the chunk is not needed anymore
+        std::vector<std::uint8_t>().swap(chunks[k].compressed);
+    }
+    for (int shift = 24; shift >= 0; shift -= 8)
+        stream.push_back((std::uint8_t)(adler >> shift));
+
+    writePngHeader(out, width, height);
+    for (size_t offset = 0; offset < stream.size(); offset += PNG_IDAT_BYTES) {
+        writePngChunk(out, "IDAT", stream.data() + offset,
+                      std::min(PNG_IDAT_BYTES, stream.size() - offset));
+    }
+    writePngChunk(out, "IEND", nullptr, 0);
+    return true;
+}
+
+/**
+ * @brief encodeQoi: writes a "Quite OK Image", which encodes an order of
+ * magnitude faster than PNG for files of a similar size
+ * @param out: the stream
+ * @param pixels: the image, row by row
+ * @param width: width of the image
+ * @param height: height of the image
+ * @return True
+ */
+static bool encodeQoi(std::ostream &out, const RGBA *pixels, int width, int height) {
+    out.write("qoif", 4);
+    writeBigEndian(out, (std::uint32_t)width);
+    writeBigEndian(out, (std::uint32_t)height);
+    // RGB, sRGB with linear alpha
+    out.put(3);
+    out.put(0);
+
+    struct Pixel {
+        std::uint8_t r = 0, g = 0, b = 0, a = 0;
+        bool operator==(const Pixel &) const = default;
+    };
+    Pixel seen[64];
+    Pixel previous{0, 0, 0, 255};
+    std::vector<char> bytes;
+    bytes.reserve((size_t)width * height);
+    int run = 0;
+    size_t count = (size_t)width * height;
+    for (size_t k = 0; k < count; k++) {
+        // the image is opaque, whatever its alpha says
+        Pixel pixel{pixels[k].r, pixels[k].g, pixels[k].b, 255};
+        if (pixel == previous) {
+            run++;
+            if (run == 62 || k + 1 == count) {
+                bytes.push_back((char)(0xc0 | (run - 1)));
+                run = 0;
+            }
+            continue;
+        }
+        if (run > 0) {
+            bytes.push_back((char)(0xc0 | (run - 1)));
+            run = 0;
+        }
+
+        int hash = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + pixel.a * 11) % 64;
+        if (seen[hash] == pixel) {
+            bytes.push_back((char)hash);
+        } else {
+            seen[hash] = pixel;
+            int dr = (std::int8_t)(pixel.r - previous.r);
+            int dg = (std::int8_t)(pixel.g - previous.g);
+            int db = (std::int8_t)(pixel.b - previous.b);
+            int drdg = dr - dg, dbdg = db - dg;
+            if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                bytes.push_back((char)(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+            } else if (dg >= -32 && dg <= 31 && drdg >= -8 && drdg <= 7 && dbdg >= -8 && dbdg <= 7) {
+                bytes.push_back((char)(0x80 | (dg + 32)));
+                bytes.push_back((char)((drdg + 8) << 4 | (dbdg + 8)));
+            } else {
+                bytes.push_back((char)0xfe);
+                bytes.push_back((char)pixel.r);
+                bytes.push_back((char)pixel.g);
+                bytes.push_back((char)pixel.b);
+            }
+        }
+        previous = pixel;
+    }
+    out.write(bytes.data(), (std::streamsize)bytes.size());
+    const char end[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out.write(end, 8);
+    return true;
+}
+
+/**
+ * @brief encodeImage: writes an image in the format of its extension
+ * @param path: the image to write
+ * @param pixels: the image, row by row from the top
+ * @param width: width of the image
+ * @param height: height of the image
+ * @return True if the image was written
+ */
+bool encodeImage(const std::string &path, const RGBA *pixels, int width, int height) {
+    TRACE_SPAN("encodeImage", path);
+    std::string extension = lowercaseExtension(path);
+
+    // write, then rename, so that the output is never a partly written image
+    // nor written through a link to another file
+    std::string partialPath = path + ".part";
+    bool success;
+    if (extension == "pfm") {
+        std::vector<float> rgb((size_t)width * height * 3);
+        for (size_t k = 0; k < (size_t)width * height; k++) {
+            rgb[3 * k] = pixels[k].r / 255.f;
+            rgb[3 * k + 1] = pixels[k].g / 255.f;
+            rgb[3 * k + 2] = pixels[k].b / 255.f;
+        }
+        success = saveFloatImage(partialPath, width, height, 3, rgb.data());
+    } else {
+        std::ofstream out(partialPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Failed to open image for writing: " << path << std::endl;
+            return false;
+        }
+        if (extension == "png") {
+            success = encodePng(out, pixels, width, height);
+        } else if (extension == "qoi") {
+            success = encodeQoi(out, pixels, width, height);
+        } else {
+            out << "P6\n" << width << " " << height << "\n255\n";
+            std::vector<std::uint8_t> row((size_t)width * 3);
+            for (int j = 0; j < height; j++) {
+                rgbRow(pixels + (size_t)j * width, width, row.data());
+                out.write(reinterpret_cast<const char *>(row.data()), (std::streamsize)row.size());
+            }
+            success = true;
+        }
+        out.flush();
+        success = success && (bool)out;
+    }
+
+    std::error_code error;
+    if (success)
+        std::filesystem::rename(partialPath, path, error);
+    if (!success || error) {
+        std::remove(partialPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief saveImage: saves a rendered image
+ * @param image: the image
+ * @param path: where to save it, whose extension picks the format
+ * @param qtEncoder: whether to use QImage::save even for the formats
+ * encodeImage supports
+ * @return True if the image was saved
+ */
+bool saveImage(const QImage &image, const std::string &path, bool qtEncoder) {
+    if (!qtEncoder && encoderSupports(path)) {
+        // the pixels of RGBX8888 rows are laid out as RGBA
+        QImage rgbx = image.format() == QImage::Format_RGBX8888
+                          ? image
+                          : image.convertToFormat(QImage::Format_RGBX8888);
+        return encodeImage(path, reinterpret_cast<const RGBA *>(rgbx.constBits()),
+                           rgbx.width(), rgbx.height());
+    }
+    QString output = QString::fromStdString(path);
+    return image.save(output) || image.save(output, "PNG");
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "rgba.h"
+
+#include <QImage>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Returns the extension of path without the dot, in lower case.
+std::string lowercaseExtension(const std::string &path);
+
+// Whether the renderer encodes the format of path itself rather than through
+// QImage::save: .png, .qoi, .ppm, .pnm and .pfm.
+bool encoderSupports(const std::string &path);
+
+// Writes an 8-bit image, rows top to bottom, in the format of the extension
+// of path. PNG is deflated in chunks of rows compressed in parallel on the
+// global thread pool, and the chunks never depend on the number of threads,
+// so the same image always gives the same file. Returns whether the file was
+// written.
+bool encodeImage(const std::string &path, const RGBA *pixels, int width,
+                 int height);
+
+// Saves a rendered image, with encodeImage for the formats it supports unless
+// qtEncoder is set, and with QImage::save otherwise, falling back to PNG for
+// unknown extensions. Returns whether the image was saved.
+bool saveImage(const QImage &image, const std::string &path, bool qtEncoder = false);
+
+// The building blocks of PNG files, shared with StreamingImageWriter.
+
+// Writes the signature and the header of an 8-bit RGB image.
+void writePngHeader(std::ostream &out, int width, int height);
+
+// Writes a chunk, with its length and CRC.
+void writePngChunk(std::ostream &out, const char *type, const std::uint8_t *data,
+                   size_t size);
+
+// Appends the filter byte and the filtered bytes of a row of RGB bytes to
+// filtered, choosing the filter like libpng: the one whose bytes, read as
+// signed, sum to the least. previousRow is all zeros for the first row.
+void filterPngRow(const std::uint8_t *row, const std::uint8_t *previousRow,
+                  size_t rowBytes, std::vector<std::uint8_t> &filtered);
@@ -0,0 +1,44 @@
+#include "imagewriter.h"
+#include <fstream>
+#include <iostream>
+#include <ostream>
+
+/**
+ * @brief saveFloatImage: writes a raw float image as a Portable Float Map
+ * (PFM), which keeps the full float precision of each channel
+ * @param file: file path to write to
+ * @param width: width of the image in pixels
+ * @param height: height of the image in pixels
+ * @param channels: number of floats per pixel, either 1 or 3
+ * @param data: pixel data, stored row by row from the top of the image
+ * @return True if the image was written, False otherwise
+ */
+bool saveFloatImage(const std::string &file, int width, int height,
+                    int channels, const float *data) {
+    if (channels != 1 && channels != 3) {
+        std::cerr << "PFM images must have 1 or 3 channels, got " << channels
+                  << std::endl;
+        return false;
+    }
+
+    std::ofstream out(file, std::ios::binary);
+    if (!out) {
+        std::cerr << "Failed to open float image for writing: " << file
+                  << std::endl;
+        return false;
+    }
+
+    // header: a negative scale marks the data as little-endian
+    out << (channels == 3 ? "PF" : "Pf") << "\n"
+        << width << " " << height << "\n"
+        << "-1.0\n";
+
+    // PFM stores its rows from the bottom of the image to the top
+    size_t rowFloats = (size_t)width * channels;
+    for (int j = height - 1; j >= 0; --j) {
+        out.write(reinterpret_cast<const char *>(data + j * rowFloats),
+                  rowFloats * sizeof(float));
+    }
+
+    return (bool)out;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Writes a float image with 1 or 3 channels per pixel as a Portable Float Map.
+// Rows are given top to bottom, as in the rendered image.
+bool saveFloatImage(const std::string &file, int width, int height,
+                    int channels, const float *data);
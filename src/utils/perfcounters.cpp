@@ -0,0 +1,204 @@
+#include "perfcounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+/**
+ * @brief PerfCounterValues::ipc: computes the instructions per cycle
+ * @return the IPC, or -1 if it cannot be computed
+ */
+double PerfCounterValues::ipc() const {
+    if (!available[CYCLES] || !available[INSTRUCTIONS] || counts[CYCLES] == 0)
+        return -1;
+    return (double)counts[INSTRUCTIONS] / (double)counts[CYCLES];
+}
+
+/**
+ * @brief operator-: subtracts the counts of two readings
+ * @param end: the later reading
+ * @param start: the earlier reading
+ * @return the events counted in between, available if both readings were
+ */
+PerfCounterValues operator-(const PerfCounterValues &end,
+                            const PerfCounterValues &start) {
+    PerfCounterValues difference;
+    for (int i = 0; i < PerfCounterValues::EVENT_COUNT; i++) {
+        difference.available[i] = end.available[i] && start.available[i];
+        difference.counts[i] = difference.available[i]
+                                   ? end.counts[i] - start.counts[i]
+                                   : 0;
+    }
+    return difference;
+}
+
+#ifdef __linux__
+/**
+ * @brief openCounter: opens a hardware counter for this process
+ * @param config: the PERF_COUNT_HW_* event to count
+ * @return the file descriptor of the counter, or -1 if it cannot be opened
+ */
+int openCounter(std::uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/**
+ * @brief PerfCounters::PerfCounters: opens every counter that is available
+ */
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < PerfCounterValues::EVENT_COUNT; i++)
+        m_fds[i] = -1;
+
+#ifdef __linux__
+    const std::uint64_t configs[PerfCounterValues::EVENT_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < PerfCounterValues::EVENT_COUNT; i++)
+        m_fds[i] = openCounter(configs[i]);
+#endif
+}
+
+/**
+ * @brief PerfCounters::~PerfCounters: closes the counters
+ */
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (int fd : m_fds) {
+        if (fd != -1)
+            close(fd);
+    }
+#endif
+}
+
+/**
+ * @brief PerfCounters::isAvailable: whether any counter could be opened
+ */
+bool PerfCounters::isAvailable() const {
+    for (int fd : m_fds) {
+        if (fd != -1)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @brief PerfCounters::read: reads the current value of every counter
+ * @return the counts since the counters were opened
+ */
+PerfCounterValues PerfCounters::read() const {
+    PerfCounterValues values;
+#ifdef __linux__
+    for (int i = 0; i < PerfCounterValues::EVENT_COUNT; i++) {
+        // value, time enabled, time running
+        std::uint64_t data[3];
+        if (m_fds[i] == -1 ||
+            ::read(m_fds[i], data, sizeof(data)) != (ssize_t)sizeof(data) ||
+            data[2] == 0)
+            continue;
+
+        // extrapolate if the counter was only running part of the time
+        values.counts[i] =
+            data[2] < data[1]
+                ? (std::uint64_t)((double)data[0] * data[1] / data[2])
+                : data[0];
+        values.available[i] = true;
+    }
+#endif
+    return values;
+}
+
+/**
+ * @brief PerfCounters::eventName: gets the printed name of an event
+ */
+const char *PerfCounters::eventName(PerfCounterValues::Event event) {
+    switch (event) {
+    case PerfCounterValues::CYCLES:
+        return "cycles";
+    case PerfCounterValues::INSTRUCTIONS:
+        return "instructions";
+    case PerfCounterValues::CACHE_MISSES:
+        return "cache-misses";
+    case PerfCounterValues::BRANCH_MISSES:
+        return "branch-misses";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief formatValue: formats a number for the benchmark report
+ * @param value: the number to format
+ * @param available: whether the number was measured
+ * @param precision: digits after the decimal point
+ * @return the formatted number, or "n/a"
+ */
+std::string formatValue(double value, bool available, int precision) {
+    if (!available)
+        return "n/a";
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(precision) << value;
+    return text.str();
+}
+
+/**
+ * @brief printBenchReport: prints the measurements of a benchmark run
+ * @param phases: the phases in the order they ran
+ */
+void printBenchReport(const std::vector<BenchPhase> &phases) {
+    std::cout << std::left << std::setw(12) << "phase" << std::right
+              << std::setw(10) << "seconds" << std::setw(16) << "cycles"
+              << std::setw(16) << "instructions" << std::setw(8) << "IPC"
+              << std::setw(14) << "cache-miss" << std::setw(14)
+              << "branch-miss" << std::setw(12) << "rays" << std::setw(14)
+              << "rays/s" << std::setw(14) << "c-miss/ray" << std::setw(14)
+              << "b-miss/ray" << std::endl;
+
+    for (const BenchPhase &phase : phases) {
+        const PerfCounterValues &c = phase.counters;
+        bool hasRays = phase.rays > 0;
+        double rays = (double)phase.rays;
+        std::cout
+            << std::left << std::setw(12) << phase.name << std::right
+            << std::setw(10) << formatValue(phase.seconds, true, 3)
+            << std::setw(16)
+            << formatValue(c.counts[PerfCounterValues::CYCLES],
+                           c.available[PerfCounterValues::CYCLES], 0)
+            << std::setw(16)
+            << formatValue(c.counts[PerfCounterValues::INSTRUCTIONS],
+                           c.available[PerfCounterValues::INSTRUCTIONS], 0)
+            << std::setw(8) << formatValue(c.ipc(), c.ipc() >= 0, 2)
+            << std::setw(14)
+            << formatValue(c.counts[PerfCounterValues::CACHE_MISSES],
+                           c.available[PerfCounterValues::CACHE_MISSES], 0)
+            << std::setw(14)
+            << formatValue(c.counts[PerfCounterValues::BRANCH_MISSES],
+                           c.available[PerfCounterValues::BRANCH_MISSES], 0)
+            << std::setw(12) << formatValue(rays, hasRays, 0) << std::setw(14)
+            << formatValue(rays / phase.seconds, hasRays && phase.seconds > 0, 0)
+            << std::setw(14)
+            << formatValue(c.counts[PerfCounterValues::CACHE_MISSES] / rays,
+                           hasRays && c.available[PerfCounterValues::CACHE_MISSES], 3)
+            << std::setw(14)
+            << formatValue(c.counts[PerfCounterValues::BRANCH_MISSES] / rays,
+                           hasRays && c.available[PerfCounterValues::BRANCH_MISSES], 3)
+            << std::endl;
+    }
+}
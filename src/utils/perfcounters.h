@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The PerfCounterValues struct: hardware events counted over a span of
+ * the program. A count is only meaningful if its available flag is set.
+ */
+struct PerfCounterValues {
+    enum Event { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, EVENT_COUNT };
+
+    std::uint64_t counts[EVENT_COUNT] = {};
+    bool available[EVENT_COUNT] = {};
+
+    // instructions per cycle, or -1 if either count is unavailable
+    double ipc() const;
+};
+
+/**
+ * @brief The PerfCounters class: hardware performance counters of the process,
+ * read through perf_event_open on Linux. Counters that cannot be opened, e.g.
+ * on other platforms, in containers or under a restrictive
+ * perf_event_paranoid, are reported as unavailable instead of failing.
+ */
+class PerfCounters {
+public:
+    // Opens the counters for the calling thread and every thread it creates
+    // from now on, so it should be constructed before the render threads.
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    // Whether at least one counter could be opened.
+    bool isAvailable() const;
+
+    // Returns the events counted since the counters were opened, scaled up
+    // when the kernel had to multiplex them.
+    PerfCounterValues read() const;
+
+    // Returns the name of an event, as printed in the benchmark report.
+    static const char *eventName(PerfCounterValues::Event event);
+
+private:
+    int m_fds[PerfCounterValues::EVENT_COUNT];
+};
+
+// Returns the counts of end minus those of start.
+PerfCounterValues operator-(const PerfCounterValues &end,
+                            const PerfCounterValues &start);
+
+/**
+ * @brief The BenchPhase struct: measurements of one phase of a benchmark run
+ */
+struct BenchPhase {
+    std::string name;
+    double seconds = 0;
+    PerfCounterValues counters;
+    // rays traced in the phase, 0 if it traces none or they were not counted
+    std::uint64_t rays = 0;
+};
+
+// Prints a table of the phases with their IPC, misses per ray and rays per
+// second, leaving out whatever could not be measured.
+void printBenchReport(const std::vector<BenchPhase> &phases);
@@ -0,0 +1,53 @@
+#include "pixelrandom.h"
+
+// state of the calling thread's PCG32 generator (O'Neill, 2014)
+static thread_local std::uint64_t pcgState = 0;
+static thread_local std::uint64_t pcgIncrement = 1;
+
+/**
+ * @brief mixBits: the SplitMix64 finalizer, which spreads the bits of
+ * consecutive pixel indices over the whole state
+ * @param value: the value to mix
+ * @return the mixed value
+ */
+static std::uint64_t mixBits(std::uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/**
+ * @brief nextPixelRandom: advances the generator of the calling thread
+ * @return 32 random bits
+ */
+static std::uint32_t nextPixelRandom() {
+    std::uint64_t state = pcgState;
+    pcgState = state * 6364136223846793005ULL + pcgIncrement;
+    std::uint32_t xorShifted = (std::uint32_t)(((state >> 18u) ^ state) >> 27u);
+    std::uint32_t rotation = (std::uint32_t)(state >> 59u);
+    return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+}
+
+/**
+ * @brief seedPixelRandom: restarts the sequence of the calling thread
+ * @param seed: the seed of the render
+ * @param pixelIndex: the index of the pixel about to be sampled
+ */
+void seedPixelRandom(std::uint32_t seed, std::uint32_t pixelIndex) {
+    // the pixel picks the stream and the seed the starting point, so that
+    // neighboring pixels never walk the same sequence
+    pcgState = 0;
+    pcgIncrement = (mixBits(((std::uint64_t)seed << 32) | pixelIndex) << 1u) | 1u;
+    nextPixelRandom();
+    pcgState += mixBits(seed ^ 0x9e3779b97f4a7c15ULL);
+    nextPixelRandom();
+}
+
+/**
+ * @brief pixelRandom: draws a number from the sequence of the calling thread
+ * @return a number uniform in [0, 1)
+ */
+float pixelRandom() {
+    // the top 24 bits, which a float holds exactly, so 1 is never returned
+    return (float)(nextPixelRandom() >> 8) * (1.f / 16777216.f);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+// Random numbers for sampling. Each thread has its own generator, which is
+// restarted at the start of every pixel from the seed and the pixel's index,
+// so what a pixel draws does not depend on the thread, the tile order or the
+// run that renders it. This is what lets a resumed or partial render match a
+// complete one pixel for pixel.
+
+// Restarts the calling thread's sequence for the pixel at pixelIndex.
+void seedPixelRandom(std::uint32_t seed, std::uint32_t pixelIndex);
+
+// Returns the next number of the calling thread's sequence, uniform in [0, 1).
+float pixelRandom();
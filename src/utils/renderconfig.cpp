@@ -0,0 +1,39 @@
+#include "renderconfig.h"
+
+/**
+ * @brief readRayTracerConfig: builds the ray tracer configuration of a config
+ * file
+ * @param settings: the opened config file
+ * @param overrides: values replacing those of the file, by key
+ * @return the configuration to render with
+ */
+RayTracer::Config readRayTracerConfig(const QSettings &settings,
+                                      const QVariantMap &overrides) {
+    auto value = [&](const QString &key, const QVariant &defaultValue = QVariant()) {
+        return overrides.contains(key) ? overrides.value(key)
+                                       : settings.value(key, defaultValue);
+    };
+
+    RayTracer::Config config{};
+    config.enableShadow        = value("Feature/shadows").toBool();
+    config.enableReflection    = value("Feature/reflect").toBool();
+    config.enableRefraction    = value("Feature/refract").toBool();
+    config.enableTextureMap    = value("Feature/texture").toBool();
+    config.enableTextureFilter = value("Feature/texture-filter").toBool();
+    config.enableParallelism   = value("Feature/parallel").toBool();
+    config.enableSuperSample   = value("Feature/super-sample").toBool();
+    config.enableAcceleration  = value("Feature/acceleration").toBool();
+    config.enableDepthOfField  = value("Feature/depthoffield").toBool();
+    config.maxRecursiveDepth   = value("Settings/maximum-recursive-depth").toInt();
+    config.onlyRenderNormals   = value("Settings/only-render-normals").toBool();
+    config.tileSize            = value("Settings/tile-size", 32).toInt();
+    config.samplesPerPixel     = value("Settings/samples-per-pixel", 100).toInt();
+    config.stratifiedTime      = value("Settings/time-sampling", "stratified").toString() != "random";
+    config.areaLightGrid       = value("Settings/area-light-grid", 6).toInt();
+    config.stratifiedAreaLight = value("Settings/area-light-sampling", "stratified").toString() != "random";
+    config.adaptiveThreshold   = value("Settings/adaptive-threshold", 0).toFloat();
+    config.adaptiveMinSamples  = value("Settings/adaptive-min-samples", 16).toInt();
+    config.bvhRebuildThreshold = value("Settings/bvh-rebuild-threshold", 1.5).toFloat();
+    config.seed                = value("Settings/seed", 0).toUInt();
+    return config;
+}
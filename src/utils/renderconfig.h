@@ -0,0 +1,11 @@
+#pragma once
+
+#include "../raytracer/raytracer.h"
+#include <QSettings>
+#include <QVariant>
+
+// Reads the [Feature] and [Settings] keys of a config file into a ray tracer
+// configuration. A key present in overrides, e.g. "Feature/parallel", takes
+// precedence over the file.
+RayTracer::Config readRayTracerConfig(const QSettings &settings,
+                                      const QVariantMap &overrides = {});
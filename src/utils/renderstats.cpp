@@ -0,0 +1,181 @@
+#include "renderstats.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief RenderStats::merge: adds the counts of another instance into this one
+ * @param other: the counters to add
+ */
+void RenderStats::merge(const RenderStats &other) {
+    primaryRays += other.primaryRays;
+    reflectionRays += other.reflectionRays;
+    shadowRays += other.shadowRays;
+    for (int i = 0; i < PRIMITIVE_TYPE_COUNT; i++) {
+        intersectionTests[i] += other.intersectionTests[i];
+        intersectionHits[i] += other.intersectionHits[i];
+    }
+    textureLookups += other.textureLookups;
+    textureCacheMisses += other.textureCacheMisses;
+    pixels += other.pixels;
+    samples += other.samples;
+    reusedPixels += other.reusedPixels;
+    if (primitiveCosts.size() < other.primitiveCosts.size())
+        primitiveCosts.resize(other.primitiveCosts.size());
+    for (int i = 0; i < (int)other.primitiveCosts.size(); i++) {
+        PrimitiveCost &cost = primitiveCosts[i];
+        cost.tests += other.primitiveCosts[i].tests;
+        cost.hits += other.primitiveCosts[i].hits;
+        cost.shades += other.primitiveCosts[i].shades;
+        cost.occlusions += other.primitiveCosts[i].occlusions;
+    }
+}
+
+/**
+ * @brief currentRenderStats: the counters of the calling thread's innermost
+ * RenderStatsScope, null outside of one
+ */
+thread_local RenderStats *currentRenderStats = nullptr;
+
+/**
+ * @brief threadRenderStats: gets the counters the calling thread counts into
+ * @return the counters of the current scope, or of the thread itself, which
+ * are never read, outside of a scope
+ */
+RenderStats &threadRenderStats() {
+    if (currentRenderStats != nullptr)
+        return *currentRenderStats;
+    thread_local RenderStats unscopedStats;
+    return unscopedStats;
+}
+
+/**
+ * @brief RenderStatsScope::RenderStatsScope: makes the calling thread count
+ * into the given counters
+ * @param stats: the counters, which must outlive the scope
+ */
+RenderStatsScope::RenderStatsScope(RenderStats &stats)
+    : m_previous(std::exchange(currentRenderStats, &stats)) {}
+
+/**
+ * @brief RenderStatsScope::~RenderStatsScope: returns the calling thread to
+ * the counters it used before the scope
+ */
+RenderStatsScope::~RenderStatsScope() { currentRenderStats = m_previous; }
+
+/**
+ * @brief saveRenderStats: writes the statistics of a render as JSON
+ * @param file: path of the JSON file to write
+ * @param stats: merged counters of the render
+ * @param phaseTimes: wall time of each phase
+ * @return True if the file was written, False otherwise
+ */
+bool saveRenderStats(const std::string &file, const RenderStats &stats,
+                     const RenderPhaseTimes &phaseTimes) {
+    QJsonObject rays;
+    rays["primary"] = (qint64)stats.primaryRays;
+    rays["reflection"] = (qint64)stats.reflectionRays;
+    rays["shadow"] = (qint64)stats.shadowRays;
+
+    QJsonObject intersections;
+    for (int i = 0; i < PRIMITIVE_TYPE_COUNT; i++) {
+        if (stats.intersectionTests[i] == 0)
+            continue;
+        QJsonObject counts;
+        counts["tests"] = (qint64)stats.intersectionTests[i];
+        counts["hits"] = (qint64)stats.intersectionHits[i];
+        intersections[primitiveTypeName((PrimitiveType)i)] = counts;
+    }
+
+    QJsonObject textures;
+    textures["lookups"] = (qint64)stats.textureLookups;
+    textures["cacheMisses"] = (qint64)stats.textureCacheMisses;
+
+    QJsonObject phases;
+    phases["parse"] = phaseTimes.parse;
+    phases["sceneBuild"] = phaseTimes.sceneBuild;
+    phases["render"] = phaseTimes.render;
+    phases[phaseTimes.backgroundSave ? "saveLaunch" : "save"] = phaseTimes.save;
+
+    QJsonObject root;
+    root["rays"] = rays;
+    root["intersections"] = intersections;
+    root["textures"] = textures;
+    root["pixels"] = (qint64)stats.pixels;
+    root["averageSamplesPerPixel"] =
+        stats.pixels > 0 ? (double)stats.samples / stats.pixels : 0.0;
+    root["reusedPixels"] = (qint64)stats.reusedPixels;
+    root["phaseSeconds"] = phases;
+
+    QFile out(QString::fromStdString(file));
+    if (!out.open(QFile::WriteOnly | QFile::Truncate)) {
+        std::cerr << "Failed to open render statistics for writing: " << file
+                  << std::endl;
+        return false;
+    }
+    out.write(QJsonDocument(root).toJson());
+    return true;
+}
+
+/**
+ * @brief savePrimitiveCostReport: writes a table of the work done for each
+ * shape, most expensive first, so the objects worth simplifying or
+ * reordering stand out
+ * @param file: path of the text file to write
+ * @param stats: merged counters of the render
+ * @param shapes: shapes of the rendered scene
+ * @return True if the file was written, False otherwise
+ */
+bool savePrimitiveCostReport(const std::string &file, const RenderStats &stats,
+                             const std::vector<RenderShapeData> &shapes) {
+    std::ofstream out(file);
+    if (!out) {
+        std::cerr << "Failed to open primitive cost report for writing: " << file
+                  << std::endl;
+        return false;
+    }
+
+    // rank the shapes by intersection tests, then by shading work
+    std::vector<PrimitiveCost> costs(shapes.size());
+    std::copy_n(stats.primitiveCosts.begin(),
+                std::min(stats.primitiveCosts.size(), costs.size()),
+                costs.begin());
+    std::vector<int> order(shapes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if (costs[a].tests != costs[b].tests)
+            return costs[a].tests > costs[b].tests;
+        return costs[a].shades > costs[b].shades;
+    });
+
+    std::uint64_t totalTests = 0;
+    for (const PrimitiveCost &cost : costs)
+        totalTests += cost.tests;
+
+    out << std::left << std::setw(6) << "rank" << std::setw(7) << "shape"
+        << std::right << std::setw(14) << "tests" << std::setw(8) << "tests%"
+        << std::setw(14) << "hits" << std::setw(14) << "shades"
+        << std::setw(14) << "occlusions"
+        << "  path" << std::endl;
+    for (int rank = 0; rank < (int)order.size(); rank++) {
+        int index = order[rank];
+        const PrimitiveCost &cost = costs[index];
+        double testShare = totalTests > 0 ? 100.0 * cost.tests / totalTests : 0.0;
+        out << std::left << std::setw(6) << rank + 1 << std::setw(7) << index
+            << std::right << std::setw(14) << cost.tests << std::setw(8)
+            << std::fixed << std::setprecision(2) << testShare << std::setw(14)
+            << cost.hits << std::setw(14) << cost.shades << std::setw(14)
+            << cost.occlusions << "  " << shapes[index].path << std::endl;
+    }
+    return (bool)out;
+}
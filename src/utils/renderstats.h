@@ -0,0 +1,115 @@
+#pragma once
+
+#include "sceneparser.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Number of entries in the PrimitiveType enum
+constexpr int PRIMITIVE_TYPE_COUNT = 9;
+
+/**
+ * @brief The PrimitiveCost struct: work attributed to a single shape
+ */
+struct PrimitiveCost {
+    // ray-shape intersection tests against the shape, and those that hit it
+    std::uint64_t tests = 0;
+    std::uint64_t hits = 0;
+    // times the shape was the closest hit and got shaded
+    std::uint64_t shades = 0;
+    // shadow rays the shape blocked from reaching a light
+    std::uint64_t occlusions = 0;
+};
+
+/**
+ * @brief The RenderStats struct: hot-path counters of a render. Each tile
+ * counts into an instance of its own through RenderStatsScope, merged into
+ * the render's once the tile is done, so counting never needs a lock or an
+ * atomic, and renders running at the same time never count into each other.
+ */
+struct RenderStats {
+    // rays traced, by kind
+    std::uint64_t primaryRays = 0;
+    std::uint64_t reflectionRays = 0;
+    std::uint64_t shadowRays = 0;
+
+    // ray-shape intersection tests and hits, indexed by PrimitiveType
+    std::uint64_t intersectionTests[PRIMITIVE_TYPE_COUNT] = {};
+    std::uint64_t intersectionHits[PRIMITIVE_TYPE_COUNT] = {};
+
+    // texture lookups, and those that had to load the texture from disk
+    std::uint64_t textureLookups = 0;
+    std::uint64_t textureCacheMisses = 0;
+
+    // pixels traced through the lenses and the samples taken for them
+    std::uint64_t pixels = 0;
+    std::uint64_t samples = 0;
+    // pixels that reused the previous frame's result instead
+    std::uint64_t reusedPixels = 0;
+
+    // work attributed to each shape, indexed like RayTraceScene::getShapes();
+    // sized to the shapes of the scene before counting when costs are
+    // attributed to shapes, and empty otherwise
+    std::vector<PrimitiveCost> primitiveCosts;
+
+    // adds one to a counter of a shape's cost entry, if there is a table,
+    // e.g. countPrimitive(shapeIndex, &PrimitiveCost::tests)
+    void countPrimitive(int shapeIndex, std::uint64_t PrimitiveCost::*counter) {
+        if (!primitiveCosts.empty())
+            primitiveCosts[shapeIndex].*counter += 1;
+    }
+
+    // adds the counts of other into this instance
+    void merge(const RenderStats &other);
+};
+
+/**
+ * @brief The RenderPhaseTimes struct: wall time in seconds of each phase of
+ * producing an image
+ */
+struct RenderPhaseTimes {
+    double parse = 0;
+    double sceneBuild = 0;
+    double render = 0;
+    // only the launch of the save when it runs in the background
+    double save = 0;
+    bool backgroundSave = false;
+};
+
+// Returns the counters the calling thread counts into, those of the
+// innermost RenderStatsScope, or counters that nothing reads outside of one.
+RenderStats &threadRenderStats();
+
+/**
+ * @brief The RenderStatsScope class: makes the calling thread count into
+ * the given counters until the scope ends
+ */
+class RenderStatsScope {
+public:
+    explicit RenderStatsScope(RenderStats &stats);
+    ~RenderStatsScope();
+
+    RenderStatsScope(const RenderStatsScope &) = delete;
+    RenderStatsScope &operator=(const RenderStatsScope &) = delete;
+
+private:
+    RenderStats *m_previous;
+};
+
+// Writes the counters and phase times as a JSON file.
+bool saveRenderStats(const std::string &file, const RenderStats &stats,
+                     const RenderPhaseTimes &phaseTimes);
+
+// Writes a table of the shapes ranked by intersection tests, naming each by
+// its group path in the scenefile.
+bool savePrimitiveCostReport(const std::string &file, const RenderStats &stats,
+                             const std::vector<RenderShapeData> &shapes);
+
+// RENDER_STAT(expression) updates a counter of the calling thread, e.g.
+// RENDER_STAT(shadowRays++). It compiles to nothing unless the CMake option
+// AETHER_RENDER_STATS is on.
+#ifdef AETHER_RENDER_STATS
+#define RENDER_STAT(expression) ((void)(threadRenderStats().expression))
+#else
+#define RENDER_STAT(expression) ((void)0)
+#endif
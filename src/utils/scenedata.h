@@ -84,6 +84,14 @@ struct SceneLightData {
     glm::vec3 vvec;
 };
 
+// Struct which contains the value of an animated property at one frame.
+// Values between keyframes are interpolated linearly, and held before the
+// first and after the last keyframe.
+struct SceneKeyframe {
+    float frame;
+    glm::vec4 value; // xyz for vectors, the axis and angle in RADIANS for rotations
+};
+
 // Struct which contains data for the camera of a scene
 struct SceneCameraData {
     glm::vec4 pos;
@@ -94,6 +102,12 @@ struct SceneCameraData {
 
     float aperture;    // Only applicable for depth of field
     float focalLength; // Only applicable for depth of field
+
+    // Keyframes of the animated properties, empty if they are static
+    std::vector<SceneKeyframe> posKeyframes;
+    std::vector<SceneKeyframe> lookKeyframes;
+    std::vector<SceneKeyframe> upKeyframes;
+    bool lookIsFocus = false; // lookKeyframes hold focus points instead of directions
 };
 
 // Struct which contains data for texture mapping files
@@ -176,11 +190,15 @@ struct SceneTransformation {
         // by in RADIANS, following the right-hand rule.
     glm::mat4 matrix; // Only applicable when transforming by a custom matrix.
         // This is that custom matrix.
+    std::vector<SceneKeyframe>
+        keyframes; // Only applicable when animated, replaces the static value
+        // of a translation, scale or rotation at each frame.
 };
 
 // Struct which represents a node in the scene graph/tree, to be parsed by the
 // student's `SceneParser`.
 struct SceneNode {
+    std::string name; // Name of the group in the scenefile, may be empty
     std::vector<SceneTransformation *>
         transformations; // Note the order of transformations described in lab 5
     std::vector<ScenePrimitive *> primitives;
@@ -3,6 +3,7 @@
 
 #include "glm/gtc/type_ptr.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <iostream>
@@ -21,7 +22,7 @@
 ScenefileReader::ScenefileReader(const std::string &name) {
     file_name = name;
 
-    memset(&m_cameraData, 0, sizeof(SceneCameraData));
+    m_cameraData = SceneCameraData();
     memset(&m_globalData, 0, sizeof(SceneGlobalData));
 
     m_root = new SceneNode;
@@ -447,6 +448,50 @@ bool ScenefileReader::parseLightData(const QJsonObject &lightData, SceneNode *no
     return true;
 }
 
+/**
+ * Parse the keyframes of an animated property, an array of objects such as
+ * {"frame": 0, "value": [0, 1, 0]}, into result sorted by frame.
+ */
+bool ScenefileReader::parseKeyframes(const QJsonArray &keyframes, int size, const std::string &owner,
+                                     std::vector<SceneKeyframe> &result) {
+    result.clear();
+    for (auto keyframe : keyframes) {
+        if (!keyframe.isObject()) {
+            std::cout << owner << " keyframes must be of type object" << std::endl;
+            return false;
+        }
+        QJsonObject keyframeObject = keyframe.toObject();
+        if (!keyframeObject["frame"].isDouble() || !keyframeObject["value"].isArray()) {
+            std::cout << owner << " keyframes must have a floating-point frame and an array value" << std::endl;
+            return false;
+        }
+        QJsonArray valueArray = keyframeObject["value"].toArray();
+        if (valueArray.size() != size) {
+            std::cout << owner << " keyframe values must have " << size << " elements" << std::endl;
+            return false;
+        }
+
+        SceneKeyframe parsed{(float)keyframeObject["frame"].toDouble(), glm::vec4(0)};
+        for (int i = 0; i < size; i++) {
+            if (!valueArray[i].isDouble()) {
+                std::cout << owner << " keyframe values must contain floating-point values" << std::endl;
+                return false;
+            }
+            parsed.value[i] = valueArray[i].toDouble();
+        }
+        result.push_back(parsed);
+    }
+    if (result.empty()) {
+        std::cout << owner << " keyframes cannot be empty" << std::endl;
+        return false;
+    }
+
+    std::stable_sort(result.begin(), result.end(), [](const SceneKeyframe &a, const SceneKeyframe &b) {
+        return a.frame < b.frame;
+    });
+    return true;
+}
+
 /**
  * Parse cameraData and fill in m_cameraData.
  */
@@ -476,6 +521,12 @@ bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
     // Parse the camera data
     if (cameradata["position"].isArray()) {
         QJsonArray position = cameradata["position"].toArray();
+        if (!position.isEmpty() && position[0].isObject()) {
+            if (!parseKeyframes(position, 3, "cameraData position", m_cameraData.posKeyframes)) {
+                return false;
+            }
+            position = position[0].toObject()["value"].toArray();
+        }
         if (position.size() != 3) {
             std::cout << "cameraData position must have 3 elements" << std::endl;
             return false;
@@ -495,6 +546,12 @@ bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
 
     if (cameradata["up"].isArray()) {
         QJsonArray up = cameradata["up"].toArray();
+        if (!up.isEmpty() && up[0].isObject()) {
+            if (!parseKeyframes(up, 3, "cameraData up", m_cameraData.upKeyframes)) {
+                return false;
+            }
+            up = up[0].toObject()["value"].toArray();
+        }
         if (up.size() != 3) {
             std::cout << "cameraData up must have 3 elements" << std::endl;
             return false;
@@ -545,6 +602,12 @@ bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
     if (cameradata.contains("look")) {
         if (cameradata["look"].isArray()) {
             QJsonArray look = cameradata["look"].toArray();
+            if (!look.isEmpty() && look[0].isObject()) {
+                if (!parseKeyframes(look, 3, "cameraData look", m_cameraData.lookKeyframes)) {
+                    return false;
+                }
+                look = look[0].toObject()["value"].toArray();
+            }
             if (look.size() != 3) {
                 std::cout << "cameraData look must have 3 elements" << std::endl;
                 return false;
@@ -565,6 +628,13 @@ bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
     else if (cameradata.contains("focus")) {
         if (cameradata["focus"].isArray()) {
             QJsonArray focus = cameradata["focus"].toArray();
+            if (!focus.isEmpty() && focus[0].isObject()) {
+                if (!parseKeyframes(focus, 3, "cameraData focus", m_cameraData.lookKeyframes)) {
+                    return false;
+                }
+                m_cameraData.lookIsFocus = true;
+                focus = focus[0].toObject()["value"].toArray();
+            }
             if (focus.size() != 3) {
                 std::cout << "cameraData focus must have 3 elements" << std::endl;
                 return false;
@@ -586,6 +656,11 @@ bool ScenefileReader::parseCameraData(const QJsonObject &cameradata) {
     // Convert the focus point (stored in the look vector) into a
     // look vector from the camera position to that focus point.
     if (cameradata.contains("focus")) {
+        // a moving camera keeps looking at a fixed focus point
+        if (!m_cameraData.posKeyframes.empty() && m_cameraData.lookKeyframes.empty()) {
+            m_cameraData.lookKeyframes.push_back(SceneKeyframe{0, m_cameraData.look});
+            m_cameraData.lookIsFocus = true;
+        }
         m_cameraData.look -= m_cameraData.pos;
     }
 
@@ -659,6 +734,11 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         }
     }
 
+    // keep the name so rendered shapes can be traced back to their group
+    if (object.contains("name") && object["name"].isString()) {
+        node->name = object["name"].toString().toStdString();
+    }
+
     // parse translation if defined
     if (object.contains("translate")) {
         if (!object["translate"].isArray()) {
@@ -667,6 +747,15 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         }
 
         QJsonArray translateArray = object["translate"].toArray();
+        std::vector<SceneKeyframe> keyframes;
+        if (!translateArray.isEmpty() && translateArray[0].isObject()) {
+            // keyframed, the value of the first keyframe in the file stands in
+            // until the scene is evaluated at a frame
+            if (!parseKeyframes(translateArray, 3, "group translate", keyframes)) {
+                return false;
+            }
+            translateArray = translateArray[0].toObject()["value"].toArray();
+        }
         if (translateArray.size() != 3) {
             std::cout << "group translate must have 3 elements" << std::endl;
             return false;
@@ -681,6 +770,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         translation->translate.x = translateArray[0].toDouble();
         translation->translate.y = translateArray[1].toDouble();
         translation->translate.z = translateArray[2].toDouble();
+        translation->keyframes = keyframes;
 
         node->transformations.push_back(translation);
     }
@@ -693,6 +783,18 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         }
 
         QJsonArray rotateArray = object["rotate"].toArray();
+        std::vector<SceneKeyframe> keyframes;
+        if (!rotateArray.isEmpty() && rotateArray[0].isObject()) {
+            // keyframed, the value of the first keyframe in the file stands in
+            // until the scene is evaluated at a frame
+            if (!parseKeyframes(rotateArray, 4, "group rotate", keyframes)) {
+                return false;
+            }
+            for (SceneKeyframe &keyframe : keyframes) {
+                keyframe.value.w *= M_PI / 180.f;
+            }
+            rotateArray = rotateArray[0].toObject()["value"].toArray();
+        }
         if (rotateArray.size() != 4) {
             std::cout << "group rotate must have 4 elements" << std::endl;
             return false;
@@ -708,6 +810,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         rotation->rotate.y = rotateArray[1].toDouble();
         rotation->rotate.z = rotateArray[2].toDouble();
         rotation->angle = rotateArray[3].toDouble() * M_PI / 180.f;
+        rotation->keyframes = keyframes;
 
         node->transformations.push_back(rotation);
     }
@@ -720,6 +823,15 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         }
 
         QJsonArray scaleArray = object["scale"].toArray();
+        std::vector<SceneKeyframe> keyframes;
+        if (!scaleArray.isEmpty() && scaleArray[0].isObject()) {
+            // keyframed, the value of the first keyframe in the file stands in
+            // until the scene is evaluated at a frame
+            if (!parseKeyframes(scaleArray, 3, "group scale", keyframes)) {
+                return false;
+            }
+            scaleArray = scaleArray[0].toObject()["value"].toArray();
+        }
         if (scaleArray.size() != 3) {
             std::cout << "group scale must have 3 elements" << std::endl;
             return false;
@@ -734,6 +846,7 @@ bool ScenefileReader::parseGroupData(const QJsonObject &object, SceneNode *node)
         scale->scale.x = scaleArray[0].toDouble();
         scale->scale.y = scaleArray[1].toDouble();
         scale->scale.z = scaleArray[2].toDouble();
+        scale->keyframes = keyframes;
 
         node->transformations.push_back(scale);
     }
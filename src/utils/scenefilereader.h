@@ -5,6 +5,7 @@
 #include <vector>
 #include <map>
 
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 
@@ -37,6 +38,8 @@ private:
     bool parseGroupData(const QJsonObject &object, SceneNode *node);
     bool parsePrimitive(const QJsonObject &prim, SceneNode *node);
     bool parseLightData(const QJsonObject &lightData, SceneNode *node);
+    bool parseKeyframes(const QJsonArray &keyframes, int size, const std::string &owner,
+                        std::vector<SceneKeyframe> &result);
 
     std::string file_name;
 
@@ -1,57 +1,155 @@
 #include "sceneparser.h"
 #include "scenefilereader.h"
+#include "tracing.h"
 #include <glm/gtx/transform.hpp>
 
 #include <chrono>
 #include <iostream>
 
+/**
+ * @brief primitiveTypeName: gets the scenefile name of a primitive type
+ * @param type: the primitive type
+ * @return the name of the type
+ */
+const char *primitiveTypeName(PrimitiveType type) {
+    switch (type) {
+    case PrimitiveType::PRIMITIVE_CUBE:
+        return "cube";
+    case PrimitiveType::PRIMITIVE_CONE:
+        return "cone";
+    case PrimitiveType::PRIMITIVE_CYLINDER:
+        return "cylinder";
+    case PrimitiveType::PRIMITIVE_SPHERE:
+        return "sphere";
+    case PrimitiveType::PRIMITIVE_MESH:
+        return "mesh";
+    case PrimitiveType::PRIMITIVE_SPHERE_MOVING:
+        return "movingSphere";
+    case PrimitiveType::PRIMITIVE_CUBE_MOVING:
+        return "movingCube";
+    case PrimitiveType::PRIMITIVE_CONE_MOVING:
+        return "movingCone";
+    case PrimitiveType::PRIMITIVE_CYLINDER_MOVING:
+        return "movingCylinder";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief sampleKeyframes: interpolates keyframes linearly, holding the first
+ * and last value outside of them
+ * @param keyframes: the keyframes sorted by frame, not empty
+ * @param frame: the frame to sample at
+ * @return the value at the frame
+ */
+glm::vec4 sampleKeyframes(const std::vector<SceneKeyframe> &keyframes, float frame) {
+    if (frame <= keyframes.front().frame)
+        return keyframes.front().value;
+    if (frame >= keyframes.back().frame)
+        return keyframes.back().value;
+
+    int next = 1;
+    while (keyframes[next].frame < frame)
+        next++;
+    const SceneKeyframe &a = keyframes[next - 1];
+    const SceneKeyframe &b = keyframes[next];
+    float t = b.frame > a.frame ? (frame - a.frame) / (b.frame - a.frame) : 1.f;
+    return glm::mix(a.value, b.value, t);
+}
+
+/**
+ * @brief transformationMatrix: gets the matrix of a transformation at a frame
+ * @param transformation: the transformation, static or keyframed
+ * @param frame: the frame to evaluate keyframes at
+ * @return the matrix of the transformation
+ */
+glm::mat4 transformationMatrix(const SceneTransformation &transformation, float frame) {
+    bool animated = !transformation.keyframes.empty();
+    glm::vec4 value = animated ? sampleKeyframes(transformation.keyframes, frame) : glm::vec4(0);
+
+    switch (transformation.type) {
+    case TransformationType::TRANSFORMATION_TRANSLATE:
+        return glm::translate(animated ? glm::vec3(value) : transformation.translate);
+    case TransformationType::TRANSFORMATION_SCALE:
+        return glm::scale(animated ? glm::vec3(value) : transformation.scale);
+    case TransformationType::TRANSFORMATION_ROTATE:
+        if (animated)
+            return glm::rotate(value.w, glm::vec3(value));
+        return glm::rotate(transformation.angle, transformation.rotate);
+    case TransformationType::TRANSFORMATION_MATRIX:
+        return transformation.matrix;
+    }
+    return glm::mat4(1.f);
+}
+
 /**
  * @brief dfsBuild: builds out the scene to render
  * @param node: node to build out from
  * @param CTM: the cumulative transform matrix
  * @param renderData: the data that is being arranged
+ * @param path: path of the node in the scenefile, e.g. "/group1/alice"
+ * @param animatedParent: index of the parent in renderData.animatedNodes, -1
+ * if the parent is static
  *
  * citation: this function is copied from my code for Lab 5: Scene Parsing
  */
-void dfsBuild(SceneNode *node, glm::mat4 CTM, RenderData &renderData) {
+void dfsBuild(SceneNode *node, glm::mat4 CTM, RenderData &renderData,
+              const std::string &path, int animatedParent) {
+    TRACE_SPAN_LAZY("dfsBuild", path.empty() ? "/" : path);
     glm::mat4 newCTM = CTM;
 
     // iterate through the transformations and add them to the CTM
+    bool animated = animatedParent >= 0;
     for (SceneTransformation *transformation : node->transformations) {
-        switch (transformation->type) {
-        case TransformationType::TRANSFORMATION_TRANSLATE:
-            newCTM *= glm::translate(transformation->translate);
-            break;
-        case TransformationType::TRANSFORMATION_SCALE:
-            newCTM *= glm::scale(transformation->scale);
-            break;
-        case TransformationType::TRANSFORMATION_ROTATE:
-            newCTM *= glm::rotate(transformation->angle, transformation->rotate);
-            break;
-        case TransformationType::TRANSFORMATION_MATRIX:
-            newCTM *= transformation->matrix;
-            break;
-        }
+        newCTM *= transformationMatrix(*transformation, 0);
+        animated = animated || !transformation->keyframes.empty();
+    }
+
+    // groups that move over time are kept so that only their CTMs are
+    // recomputed for each frame
+    AnimatedNodeData *animatedNode = nullptr;
+    int animatedIndex = -1;
+    if (animated) {
+        AnimatedNodeData nodeData{animatedParent, CTM, {}, {}, {}, {}, newCTM};
+        for (SceneTransformation *transformation : node->transformations)
+            nodeData.transformations.push_back(*transformation);
+        renderData.animatedNodes.push_back(nodeData);
+        animatedIndex = (int)renderData.animatedNodes.size() - 1;
+        animatedNode = &renderData.animatedNodes.back();
     }
 
     // iterate through scene primitives and record their CTM values
-    for (ScenePrimitive *primitive : node->primitives) {
-        renderData.shapes.push_back(
-            RenderShapeData{*primitive, newCTM, glm::inverse(newCTM)});
+    for (int i = 0; i < (int)node->primitives.size(); i++) {
+        ScenePrimitive *primitive = node->primitives[i];
+        std::string primitivePath = path + "/" +
+                                    primitiveTypeName(primitive->type) + "[" +
+                                    std::to_string(i) + "]";
+        if (animatedNode)
+            animatedNode->shapes.push_back((int)renderData.shapes.size());
+        renderData.shapes.push_back(RenderShapeData{
+            *primitive, newCTM, glm::inverse(newCTM), primitivePath});
     }
 
     // iterate through the lights and reocrd their direction and position in world
     // space
     for (SceneLight *light : node->lights) {
+        if (animatedNode) {
+            animatedNode->lights.push_back((int)renderData.lights.size());
+            animatedNode->lightDirs.push_back(light->dir);
+        }
         renderData.lights.push_back(SceneLightData{
                                                    light->id, light->type, light->color, light->function,
             newCTM * glm::vec4(0, 0, 0, 1), newCTM * light->dir, light->penumbra,
             light->angle, light->width, light->height});
     }
 
-    // reccur in a depth first manner on all children of the current node
-    for (SceneNode *child : node->children) {
-        dfsBuild(child, newCTM, renderData);
+    // reccur in a depth first manner on all children of the current node,
+    // naming unnamed groups by their index
+    for (int i = 0; i < (int)node->children.size(); i++) {
+        SceneNode *child = node->children[i];
+        std::string childName =
+            child->name.empty() ? "group" + std::to_string(i) : child->name;
+        dfsBuild(child, newCTM, renderData, path + "/" + childName, animatedIndex);
     }
 }
 
@@ -64,6 +162,7 @@ void dfsBuild(SceneNode *node, glm::mat4 CTM, RenderData &renderData) {
  * citation: this function is copied from Lab 5: Scene Parsing
  */
 bool SceneParser::parse(std::string filepath, RenderData &renderData) {
+    TRACE_SPAN("SceneParser::parse", filepath);
     ScenefileReader fileReader = ScenefileReader(filepath);
     bool success = fileReader.readJSON();
     if (!success) {
@@ -77,6 +176,61 @@ bool SceneParser::parse(std::string filepath, RenderData &renderData) {
     // populate renderData's list of primitives and their transforms
     SceneNode *rootNode = fileReader.getRootNode();
     renderData.shapes.clear();
-    dfsBuild(rootNode, glm::mat4(1.f), renderData);
+    renderData.lights.clear();
+    renderData.animatedNodes.clear();
+    dfsBuild(rootNode, glm::mat4(1.f), renderData, "", -1);
     return true;
 }
+
+/**
+ * @brief SceneParser::isAnimated: checks whether a scene has keyframes
+ * @param renderData: the parsed scene
+ * @return true if the scene changes between frames
+ */
+bool SceneParser::isAnimated(const RenderData &renderData) {
+    const SceneCameraData &camera = renderData.cameraData;
+    return !renderData.animatedNodes.empty() || !camera.posKeyframes.empty() ||
+           !camera.lookKeyframes.empty() || !camera.upKeyframes.empty();
+}
+
+/**
+ * @brief SceneParser::evaluate: moves the animated groups and the camera of
+ * a scene to a frame. Static groups keep the CTMs computed when parsing.
+ * @param renderData: the parsed scene, updated in place
+ * @param frame: the frame to evaluate the keyframes at
+ */
+void SceneParser::evaluate(RenderData &renderData, float frame) {
+    TRACE_SPAN_LAZY("SceneParser::evaluate", std::to_string(frame));
+
+    // parents come before their children, so their CTMs are already updated
+    std::vector<AnimatedNodeData> &nodes = renderData.animatedNodes;
+    for (AnimatedNodeData &node : nodes) {
+        glm::mat4 ctm = node.parent >= 0 ? nodes[node.parent].ctm : node.parentCTM;
+        for (const SceneTransformation &transformation : node.transformations)
+            ctm *= transformationMatrix(transformation, frame);
+        node.ctm = ctm;
+
+        glm::mat4 inverseCTM = glm::inverse(ctm);
+        for (int shape : node.shapes) {
+            renderData.shapes[shape].ctm = ctm;
+            renderData.shapes[shape].inverseCTM = inverseCTM;
+        }
+        for (int i = 0; i < (int)node.lights.size(); i++) {
+            SceneLightData &light = renderData.lights[node.lights[i]];
+            light.pos = ctm * glm::vec4(0, 0, 0, 1);
+            light.dir = ctm * node.lightDirs[i];
+        }
+    }
+
+    SceneCameraData &camera = renderData.cameraData;
+    if (!camera.posKeyframes.empty())
+        camera.pos = glm::vec4(glm::vec3(sampleKeyframes(camera.posKeyframes, frame)), camera.pos.w);
+    if (!camera.upKeyframes.empty())
+        camera.up = glm::vec4(glm::vec3(sampleKeyframes(camera.upKeyframes, frame)), camera.up.w);
+    if (!camera.lookKeyframes.empty()) {
+        glm::vec3 look = sampleKeyframes(camera.lookKeyframes, frame);
+        if (camera.lookIsFocus)
+            look -= glm::vec3(camera.pos);
+        camera.look = glm::vec4(look, camera.look.w);
+    }
+}
@@ -9,6 +9,19 @@ struct RenderShapeData {
     ScenePrimitive primitive;
     glm::mat4 ctm; // the cumulative transformation matrix
     glm::mat4 inverseCTM;
+    std::string path; // path of the primitive's group in the scenefile
+};
+
+// Struct which contains a group of the scene graph whose CTM is animated,
+// either by its own keyframes or by those of an ancestor
+struct AnimatedNodeData {
+    int parent;          // index of the animated parent, -1 if the parent is static
+    glm::mat4 parentCTM; // CTM of the static parent, when parent is -1
+    std::vector<SceneTransformation> transformations;
+    std::vector<int> shapes;          // indices of the group's primitives in RenderData::shapes
+    std::vector<int> lights;          // indices of the group's lights in RenderData::lights
+    std::vector<glm::vec4> lightDirs; // directions of the group's lights before the CTM
+    glm::mat4 ctm;                    // the CTM at the last evaluated frame
 };
 
 // Struct which contains all the data needed to render a scene
@@ -18,8 +31,14 @@ struct RenderData {
 
     std::vector<SceneLightData> lights;
     std::vector<RenderShapeData> shapes;
+
+    // animated groups, each after its animated parent
+    std::vector<AnimatedNodeData> animatedNodes;
 };
 
+// Returns the scenefile name of a primitive type, e.g. "sphere".
+const char *primitiveTypeName(PrimitiveType type);
+
 class SceneParser {
 public:
     // Parse the scene and store the results in renderData.
@@ -29,4 +48,13 @@ public:
     // @return            A boolean value indicating whether the parse was
     // successful.
     static bool parse(std::string filepath, RenderData &renderData);
+
+    // Whether the scene has keyframes, i.e. evaluate changes it.
+    static bool isAnimated(const RenderData &renderData);
+
+    // Moves the animated groups and camera of a parsed scene to a frame,
+    // recomputing only the CTMs that depend on keyframes.
+    // @param renderData  The parsed scene, updated in place.
+    // @param frame       The frame to evaluate the keyframes at.
+    static void evaluate(RenderData &renderData, float frame);
 };
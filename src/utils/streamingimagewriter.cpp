@@ -0,0 +1,158 @@
+#include "streamingimagewriter.h"
+#include "imageencoder.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+// Bytes of compressed data per IDAT chunk, at most
+const size_t IDAT_SIZE = 1 << 16;
+
+/**
+ * @brief StreamingImageWriter::supports: checks the format of a path
+ * @param path: the path of the image
+ * @return True if images of its format can be streamed
+ */
+bool StreamingImageWriter::supports(const std::string &path) {
+    std::string extension = lowercaseExtension(path);
+    return extension == "png" || extension == "ppm" || extension == "pnm";
+}
+
+/**
+ * @brief StreamingImageWriter::StreamingImageWriter: prepares to write an
+ * image, without creating the file yet
+ * @param path: where the image goes
+ * @param width: width of the image in pixels
+ * @param height: height of the image in pixels
+ */
+StreamingImageWriter::StreamingImageWriter(std::string path, int width, int height)
+    : m_path(std::move(path)), m_partialPath(m_path + ".part"), m_width(width),
+      m_height(height),
+      m_format(lowercaseExtension(m_path) == "png" ? Format::PNG : Format::PPM) {}
+
+/**
+ * @brief StreamingImageWriter::~StreamingImageWriter: drops an image that was
+ * not finished
+ */
+StreamingImageWriter::~StreamingImageWriter() {
+    if (!m_open)
+        return;
+    if (m_format == Format::PNG)
+        deflateEnd(&m_zlib);
+    m_out.close();
+    std::remove(m_partialPath.c_str());
+}
+
+/**
+ * @brief StreamingImageWriter::open: creates the file and writes its header
+ * @return True if the file was created
+ */
+bool StreamingImageWriter::open() {
+    m_out.open(m_partialPath, std::ios::binary | std::ios::trunc);
+    if (!m_out) {
+        std::cerr << "Failed to open image for writing: " << m_path << std::endl;
+        return false;
+    }
+
+    if (m_format == Format::PPM) {
+        m_out << "P6\n" << m_width << " " << m_height << "\n255\n";
+    } else {
+        writePngHeader(m_out, m_width, m_height);
+        if (deflateInit(&m_zlib, Z_DEFAULT_COMPRESSION) != Z_OK) {
+            m_out.close();
+            std::remove(m_partialPath.c_str());
+            return false;
+        }
+        m_previousRow.assign((size_t)m_width * 3, 0);
+    }
+    m_open = true;
+    return (bool)m_out;
+}
+
+/**
+ * @brief StreamingImageWriter::deflateRows: compresses the filtered rows into
+ * IDAT chunks
+ * @param flush: Z_NO_FLUSH, or Z_FINISH for the end of the image
+ * @return True if the compressed data was written
+ */
+bool StreamingImageWriter::deflateRows(int flush) {
+    m_zlib.next_in = m_filtered.data();
+    m_zlib.avail_in = (uInt)m_filtered.size();
+    int status;
+    do {
+        m_compressed.resize(IDAT_SIZE);
+        m_zlib.next_out = m_compressed.data();
+        m_zlib.avail_out = (uInt)m_compressed.size();
+        status = deflate(&m_zlib, flush);
+        if (status == Z_STREAM_ERROR)
+            return false;
+        size_t produced = m_compressed.size() - m_zlib.avail_out;
+        if (produced > 0)
+            writePngChunk(m_out, "IDAT", m_compressed.data(), produced);
+    } while (m_zlib.avail_out == 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+    m_filtered.clear();
+    return (bool)m_out;
+}
+
+/**
+ * @brief StreamingImageWriter::writeRows: appends rows to the image
+ * @param rows: the pixels of the rows, row by row
+ * @param rowCount: the number of rows
+ * @return True if the rows were written
+ */
+bool StreamingImageWriter::writeRows(const RGBA *rows, int rowCount) {
+    if (!m_open || m_rowsWritten + rowCount > m_height)
+        return false;
+
+    size_t rowBytes = (size_t)m_width * 3;
+    std::vector<std::uint8_t> row(rowBytes);
+    for (int j = 0; j < rowCount; j++) {
+        const RGBA *pixels = rows + (size_t)j * m_width;
+        for (int i = 0; i < m_width; i++) {
+            row[3 * i] = pixels[i].r;
+            row[3 * i + 1] = pixels[i].g;
+            row[3 * i + 2] = pixels[i].b;
+        }
+        if (m_format == Format::PPM) {
+            m_out.write(reinterpret_cast<const char *>(row.data()), (std::streamsize)rowBytes);
+            continue;
+        }
+
+        filterPngRow(row.data(), m_previousRow.data(), rowBytes, m_filtered);
+        m_previousRow.swap(row);
+    }
+    m_rowsWritten += rowCount;
+
+    if (m_format == Format::PNG && !deflateRows(Z_NO_FLUSH))
+        return false;
+    return (bool)m_out;
+}
+
+/**
+ * @brief StreamingImageWriter::close: finishes the image
+ * @return True if every row was written and the image is at its path
+ */
+bool StreamingImageWriter::close() {
+    if (!m_open)
+        return false;
+    bool success = m_rowsWritten == m_height;
+    if (m_format == Format::PNG) {
+        success = success && deflateRows(Z_FINISH);
+        deflateEnd(&m_zlib);
+        if (success)
+            writePngChunk(m_out, "IEND", nullptr, 0);
+    }
+    m_out.flush();
+    success = success && (bool)m_out;
+    m_out.close();
+    m_open = false;
+
+    std::error_code error;
+    if (success)
+        std::filesystem::rename(m_partialPath, m_path, error);
+    if (!success || error) {
+        std::remove(m_partialPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "rgba.h"
+
+#include <zlib.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The StreamingImageWriter class: writes an image a band of rows at a
+ * time, top to bottom, so that only the band being written has to be in
+ * memory. PNG files are compressed as the rows arrive, with the same per-row
+ * filter choice as libpng; PPM files take the rows as they are.
+ */
+class StreamingImageWriter {
+public:
+    // constructor for a width x height image at path, whose extension picks
+    // the format
+    StreamingImageWriter(std::string path, int width, int height);
+    ~StreamingImageWriter();
+
+    StreamingImageWriter(const StreamingImageWriter &) = delete;
+    StreamingImageWriter &operator=(const StreamingImageWriter &) = delete;
+
+    // Whether the extension of path is a format that can be streamed, .png,
+    // .ppm or .pnm.
+    static bool supports(const std::string &path);
+
+    // Starts the file, next to path until it is complete. Returns whether it
+    // could be created.
+    bool open();
+
+    // Appends the next rowCount rows of the image. Returns whether they were
+    // written.
+    bool writeRows(const RGBA *rows, int rowCount);
+
+    // Finishes the file and moves it to path, once every row was written.
+    // Returns whether the image is complete.
+    bool close();
+
+private:
+    enum class Format { PNG, PPM };
+
+    bool deflateRows(int flush);
+
+    std::string m_path;
+    std::string m_partialPath;
+    int m_width;
+    int m_height;
+    Format m_format;
+    int m_rowsWritten = 0;
+    bool m_open = false;
+    std::ofstream m_out;
+
+    // the PNG compressor, the filtered rows it reads and the compressed
+    // bytes waiting to fill an IDAT chunk
+    z_stream m_zlib{};
+    std::vector<std::uint8_t> m_previousRow;
+    std::vector<std::uint8_t> m_filtered;
+    std::vector<std::uint8_t> m_compressed;
+};
@@ -0,0 +1,198 @@
+#include "tracing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+// Spans kept per thread before the oldest ones get overwritten
+constexpr std::size_t TRACE_RING_CAPACITY = 1 << 16;
+
+std::atomic<bool> tracingOn{false};
+
+/**
+ * @brief setTracingEnabled: turns span recording on or off for every thread
+ * @param enabled: whether spans should be recorded
+ */
+void setTracingEnabled(bool enabled) {
+    tracingOn.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief tracingEnabled: whether spans are currently being recorded
+ */
+bool tracingEnabled() { return tracingOn.load(std::memory_order_relaxed); }
+
+/**
+ * @brief traceTimestamp: gets the current time for a span
+ * @return microseconds since the first call in the process
+ */
+double traceTimestamp() {
+    static const auto epoch = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - epoch)
+        .count();
+}
+
+/**
+ * @brief The TraceRing struct: the spans of one thread, oldest first once
+ * unrolled
+ */
+struct TraceRing {
+    int threadId = 0;
+    std::vector<TraceEvent> events;
+    // index the next span is written to, once the ring is full
+    std::size_t next = 0;
+    std::uint64_t dropped = 0;
+
+    void push(TraceEvent event) {
+        if (events.size() < TRACE_RING_CAPACITY) {
+            events.push_back(std::move(event));
+            return;
+        }
+        events[next] = std::move(event);
+        next = (next + 1) % TRACE_RING_CAPACITY;
+        dropped++;
+    }
+
+    std::vector<TraceEvent> unrolled() const {
+        std::vector<TraceEvent> ordered(events.begin() + next, events.end());
+        ordered.insert(ordered.end(), events.begin(), events.begin() + next);
+        return ordered;
+    }
+};
+
+/**
+ * @brief traceRegistryMutex, traceRegistry, retiredTraces: the rings of every
+ * live thread, and of threads that have already exited. The mutex is only
+ * taken when a thread starts or stops and when the trace is saved, never per
+ * span, as each thread records into its own ring.
+ */
+std::mutex traceRegistryMutex;
+std::vector<TraceRing *> traceRegistry;
+std::vector<TraceRing> retiredTraces;
+int nextTraceThreadId = 0;
+
+/**
+ * @brief The ThreadTraceSlot struct: owns a thread's ring and registers it
+ * for the lifetime of the thread
+ */
+struct ThreadTraceSlot {
+    TraceRing ring;
+
+    ThreadTraceSlot() {
+        std::lock_guard<std::mutex> lock(traceRegistryMutex);
+        ring.threadId = nextTraceThreadId++;
+        traceRegistry.push_back(&ring);
+    }
+
+    ~ThreadTraceSlot() {
+        std::lock_guard<std::mutex> lock(traceRegistryMutex);
+        std::erase(traceRegistry, &ring);
+        retiredTraces.push_back(std::move(ring));
+    }
+};
+
+/**
+ * @brief recordTraceEvent: stores a finished span in the calling thread's ring
+ * @param name: name of the span, must outlive the trace
+ * @param detail: optional text shown with the span
+ * @param start: start of the span from traceTimestamp
+ * @param duration: length of the span in microseconds
+ */
+void recordTraceEvent(const char *name, std::string detail, double start,
+                      double duration) {
+    thread_local ThreadTraceSlot slot;
+    slot.ring.push(TraceEvent{name, std::move(detail), start, duration});
+}
+
+/**
+ * @brief writeJsonString: writes a string as a quoted and escaped JSON string
+ */
+void writeJsonString(std::ostream &out, const std::string &text) {
+    out << '"';
+    for (char c : text) {
+        switch (c) {
+        case '"':
+            out << "\\\"";
+            break;
+        case '\\':
+            out << "\\\\";
+            break;
+        case '\n':
+            out << "\\n";
+            break;
+        default:
+            if ((unsigned char)c < 0x20) {
+                out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                    << (int)c << std::dec << std::setfill(' ');
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+/**
+ * @brief saveTrace: writes the spans of every thread as Chrome trace events.
+ * Must not be called while other threads are still recording.
+ * @param file: path of the JSON file to write
+ * @return whether the file was written
+ */
+bool saveTrace(const std::string &file) {
+    std::ofstream out(file);
+    if (!out) {
+        std::cerr << "Error: could not open \"" << file << "\" for writing"
+                  << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(traceRegistryMutex);
+    std::vector<const TraceRing *> rings;
+    for (const TraceRing *ring : traceRegistry)
+        rings.push_back(ring);
+    for (const TraceRing &ring : retiredTraces)
+        rings.push_back(&ring);
+    std::sort(rings.begin(), rings.end(),
+              [](const TraceRing *a, const TraceRing *b) {
+                  return a->threadId < b->threadId;
+              });
+
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    std::uint64_t dropped = 0;
+    for (const TraceRing *ring : rings) {
+        // name the track of each thread
+        out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+            << "\"pid\":1,\"tid\":" << ring->threadId
+            << ",\"args\":{\"name\":\"thread " << ring->threadId << "\"}}";
+        first = false;
+
+        for (const TraceEvent &event : ring->unrolled()) {
+            out << ",\n{\"name\":";
+            writeJsonString(out, event.name);
+            out << ",\"cat\":\"aether\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                << ring->threadId << ",\"ts\":" << event.start
+                << ",\"dur\":" << event.duration;
+            if (!event.detail.empty()) {
+                out << ",\"args\":{\"detail\":";
+                writeJsonString(out, event.detail);
+                out << "}";
+            }
+            out << "}";
+        }
+        dropped += ring->dropped;
+    }
+    out << "\n]}\n";
+
+    if (dropped > 0) {
+        std::cout << "Warning: the trace ring buffers overflowed, the oldest "
+                  << dropped << " spans were dropped" << std::endl;
+    }
+    return out.good();
+}
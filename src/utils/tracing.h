@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <concepts>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The TraceEvent struct: a finished span, in microseconds since the
+ * start of the process
+ */
+struct TraceEvent {
+    const char *name = nullptr;
+    std::string detail;
+    double start = 0;
+    double duration = 0;
+};
+
+// Turns span recording on or off for every thread. Off by default, in which
+// case a span costs a single relaxed load.
+void setTracingEnabled(bool enabled);
+bool tracingEnabled();
+
+// Microseconds elapsed since the start of the process.
+double traceTimestamp();
+
+// Appends a finished span to the ring buffer of the calling thread, replacing
+// the oldest one once the buffer is full.
+void recordTraceEvent(const char *name, std::string detail, double start,
+                      double duration);
+
+// Writes the spans of every thread as a Chrome trace-event JSON file, which
+// can be opened in chrome://tracing or ui.perfetto.dev.
+bool saveTrace(const std::string &file);
+
+/**
+ * @brief The TraceSpan class: records the lifetime of a scope as a span. The
+ * name must outlive the trace, e.g. a string literal.
+ */
+class TraceSpan {
+public:
+    explicit TraceSpan(const char *name, std::string detail = {})
+        : m_name(name), m_active(tracingEnabled()) {
+        if (m_active) {
+            m_detail = std::move(detail);
+            m_start = traceTimestamp();
+        }
+    }
+
+    ~TraceSpan() {
+        if (m_active) {
+            recordTraceEvent(m_name, std::move(m_detail), m_start,
+                             traceTimestamp() - m_start);
+        }
+    }
+
+    // constructor taking a function that builds the detail, only called
+    // when tracing is on, for details that cost an allocation to format
+    template <std::invocable MakeDetail>
+    TraceSpan(const char *name, MakeDetail &&makeDetail)
+        : m_name(name), m_active(tracingEnabled()) {
+        if (m_active) {
+            m_detail = makeDetail();
+            m_start = traceTimestamp();
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *m_name;
+    bool m_active;
+    std::string m_detail;
+    double m_start = 0;
+};
+
+// TRACE_SPAN(name[, detail]) traces the rest of the enclosing scope.
+// TRACE_SPAN_LAZY(name, detail) does too, but only evaluates the detail
+// expression when tracing is on, e.g. for a std::to_string in a hot loop.
+#define TRACE_SPAN_CONCAT_(a, b) a##b
+#define TRACE_SPAN_NAME_(line) TRACE_SPAN_CONCAT_(traceSpan, line)
+#define TRACE_SPAN(...) TraceSpan TRACE_SPAN_NAME_(__LINE__)(__VA_ARGS__)
+#define TRACE_SPAN_LAZY(name, detail) \
+    TraceSpan TRACE_SPAN_NAME_(__LINE__)(name, [&]() { return std::string(detail); })
@@ -0,0 +1,143 @@
+#include "videostreamwriter.h"
+#include "imageencoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+/**
+ * @brief VideoStreamWriter::VideoStreamWriter: creates an empty stream; the
+ * Y4M header is written with the first frame, whose size it holds
+ * @param out: the file or pipe to write to
+ * @param format: Y4M or raw RGB
+ * @param fps: frames per second, only recorded by Y4M
+ */
+VideoStreamWriter::VideoStreamWriter(std::ostream &out, Format format, int fps)
+    : m_out(out), m_format(format), m_fps(std::max(1, fps)) {}
+
+/**
+ * @brief VideoStreamWriter::formatOf: picks the format of a path
+ * @param path: the path of the stream, "-" for standard output
+ * @return Y4M for a .y4m extension, raw RGB otherwise
+ */
+VideoStreamWriter::Format VideoStreamWriter::formatOf(const std::string &path) {
+    return lowercaseExtension(path) == "y4m" ? Format::Y4M : Format::RawRGB;
+}
+
+int VideoStreamWriter::frameCount() const { return m_frameCount; }
+
+/**
+ * @brief clampToByte: rounds a color component to a byte
+ * @param value: the component
+ * @return value rounded and clamped to 0-255
+ */
+static std::uint8_t clampToByte(float value) {
+    return (std::uint8_t)std::clamp((int)std::lround(value), 0, 255);
+}
+
+/**
+ * @brief VideoStreamWriter::writeFrame: appends a frame to the stream once the
+ * frames before it are
+ * @param sequence: the number of the frame, from 0
+ * @param pixels: the frame, row by row from the top
+ * @param width: width of the frame
+ * @param height: height of the frame
+ * @return True if the frame was written
+ */
+bool VideoStreamWriter::writeFrame(int sequence, const RGBA *pixels, int width, int height) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_turn.wait(lock, [&]() { return sequence <= m_nextSequence; });
+    bool written = appendFrame(pixels, width, height);
+    finishFrame(sequence);
+    return written;
+}
+
+/**
+ * @brief VideoStreamWriter::skipFrame: lets the frames after a frame that
+ * will never be written go ahead
+ * @param sequence: the number of the frame, from 0
+ */
+void VideoStreamWriter::skipFrame(int sequence) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    finishFrame(sequence);
+}
+
+/**
+ * @brief VideoStreamWriter::finishFrame: records that a frame is written or
+ * skipped, and advances to the first frame that is not. m_mutex must be held.
+ * @param sequence: the number of the frame, from 0
+ */
+void VideoStreamWriter::finishFrame(int sequence) {
+    if (sequence < m_nextSequence)
+        return;
+    m_finished.insert(sequence);
+    while (m_finished.erase(m_nextSequence) > 0) {
+        m_nextSequence++;
+    }
+    m_turn.notify_all();
+}
+
+/**
+ * @brief VideoStreamWriter::appendFrame: writes a frame at the end of the
+ * stream
+ * @param pixels: the frame, row by row from the top
+ * @param width: width of the frame
+ * @param height: height of the frame
+ * @return True if the frame was written
+ */
+bool VideoStreamWriter::appendFrame(const RGBA *pixels, int width, int height) {
+    if (m_frameCount == 0) {
+        m_width = width;
+        m_height = height;
+        if (m_format == Format::Y4M) {
+            m_out << "YUV4MPEG2 W" << width << " H" << height << " F" << m_fps
+                  << ":1 Ip A1:1 C444\n";
+        }
+    } else if (width != m_width || height != m_height) {
+        std::cerr << "Error: a " << width << "x" << height << " frame does not fit a "
+                  << m_width << "x" << m_height << " video stream" << std::endl;
+        return false;
+    }
+
+    size_t count = (size_t)width * height;
+    m_frame.resize(count * 3);
+    if (m_format == Format::Y4M) {
+        // BT.601 in the limited range video encoders expect, one plane after
+        // the other
+        std::uint8_t *y = m_frame.data();
+        std::uint8_t *cb = y + count;
+        std::uint8_t *cr = cb + count;
+        for (size_t k = 0; k < count; k++) {
+            float r = pixels[k].r, g = pixels[k].g, b = pixels[k].b;
+            y[k] = clampToByte(16.f + 0.256788f * r + 0.504129f * g + 0.097906f * b);
+            cb[k] = clampToByte(128.f - 0.148223f * r - 0.290993f * g + 0.439216f * b);
+            cr[k] = clampToByte(128.f + 0.439216f * r - 0.367788f * g - 0.071427f * b);
+        }
+        m_out << "FRAME\n";
+    } else {
+        for (size_t k = 0; k < count; k++) {
+            m_frame[3 * k] = pixels[k].r;
+            m_frame[3 * k + 1] = pixels[k].g;
+            m_frame[3 * k + 2] = pixels[k].b;
+        }
+    }
+    m_out.write(reinterpret_cast<const char *>(m_frame.data()), (std::streamsize)m_frame.size());
+    // a pipe reader gets each frame as soon as it is rendered
+    m_out.flush();
+    if (!m_out) {
+        std::cerr << "Error: failed to write frame " << m_frameCount << " to the video stream" << std::endl;
+        return false;
+    }
+    m_frameCount++;
+    return true;
+}
+
+/**
+ * @brief VideoStreamWriter::close: flushes the stream
+ * @return True if every frame was written
+ */
+bool VideoStreamWriter::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_out.flush();
+    return (bool)m_out;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "rgba.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+/**
+ * @brief The VideoStreamWriter class: appends the frames of an animation to a
+ * single uncompressed video stream, for a video encoder to read from a file
+ * or a pipe without a round-trip through one image file per frame.
+ *
+ * YUV4MPEG2 (.y4m) streams carry the size and frame rate in their header and
+ * each frame as 4:4:4 BT.601 planes, as ffmpeg and x264 read them. Raw
+ * streams are the RGB24 frames back to back, e.g. for
+ * "ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -r 30 -i -".
+ */
+class VideoStreamWriter {
+public:
+    enum class Format { Y4M, RawRGB };
+
+    // constructor for a stream written to out, at fps frames per second
+    VideoStreamWriter(std::ostream &out, Format format, int fps);
+
+    // The format of a path: Y4M for a .y4m extension, raw RGB otherwise.
+    static Format formatOf(const std::string &path);
+
+    // Appends the frame numbered sequence, row by row from the top, once
+    // every frame before it was written or skipped; frames are numbered from
+    // 0 in the order they appear. Every frame must have the size of the
+    // first. Returns whether it was written.
+    bool writeFrame(int sequence, const RGBA *pixels, int width, int height);
+
+    // Leaves out the frame numbered sequence, e.g. because it failed to
+    // render, so that the frames after it can be written.
+    void skipFrame(int sequence);
+
+    // Flushes the stream. Returns whether everything was written.
+    bool close();
+
+    int frameCount() const;
+
+private:
+    // writes a frame, in whatever order it comes
+    bool appendFrame(const RGBA *pixels, int width, int height);
+
+    // marks a frame as written or skipped, waking up the next one
+    void finishFrame(int sequence);
+
+    // frames rendered concurrently wait for their turn, see writeFrame
+    std::mutex m_mutex;
+    std::condition_variable m_turn;
+    int m_nextSequence = 0;
+    std::set<int> m_finished;
+
+    std::ostream &m_out;
+    Format m_format;
+    int m_fps;
+    int m_width = 0;
+    int m_height = 0;
+    int m_frameCount = 0;
+    // the planes or bytes of the frame being written
+    std::vector<std::uint8_t> m_frame;
+};
@@ -0,0 +1,169 @@
+"""Generates scenefiles with many primitives to see how the renderer scales.
+
+The output uses the same JSON format as the files in scenefiles/, so it can
+be rendered like any other scene. The same arguments and seed always give the
+same scene.
+
+Example:
+    python3 tools/generateScene.py --count 10000 --mix sphere=3,cube=1 \
+        --distribution clustered --lights point=2,area=1 --reflective 0.2 \
+        --output scenefiles/generated/scene10k.json
+"""
+
+import argparse
+import json
+import math
+import random
+
+PRIMITIVE_TYPES = ["sphere", "cube", "cone", "cylinder", "movingSphere", "movingCube"]
+LIGHT_TYPES = ["point", "directional", "spot", "area"]
+
+# Primitives are put in groups of this size, so the scene graph has some depth
+# like a hand-made scene instead of one flat list
+GROUP_SIZE = 64
+
+
+def parse_weights(text, allowed):
+    """Parses "a=2,b=1" into a dictionary of weights, rejecting unknown names."""
+    weights = {}
+    for item in text.split(","):
+        if not item:
+            continue
+        name, _, weight = item.partition("=")
+        if name not in allowed:
+            raise argparse.ArgumentTypeError(
+                f"unknown type '{name}', expected one of {', '.join(allowed)}")
+        weights[name] = float(weight) if weight else 1.0
+    return weights
+
+
+def sample_position(rng, distribution, index, count, extent, clusters):
+    """Places the index-th of count primitives inside a cube of side extent."""
+    half = extent / 2
+    if distribution == "grid":
+        side = math.ceil(count ** (1 / 3))
+        step = extent / side
+        x, y, z = index % side, (index // side) % side, index // (side * side)
+        return [-half + (x + 0.5) * step, -half + (y + 0.5) * step, -half + (z + 0.5) * step]
+    if distribution == "clustered":
+        center = clusters[index % len(clusters)]
+        spread = extent / (2 * len(clusters) ** (1 / 3))
+        return [c + rng.gauss(0, spread / 2) for c in center]
+    return [rng.uniform(-half, half) for _ in range(3)]
+
+
+def make_material(rng, reflective):
+    """Returns a random material, reflective with the given probability."""
+    color = [round(rng.uniform(0.1, 1.0), 3) for _ in range(3)]
+    material = {
+        "ambient": [round(c * 0.2, 3) for c in color],
+        "diffuse": color,
+        "specular": [0.5, 0.5, 0.5],
+        "shininess": rng.choice([5, 15, 30, 60]),
+    }
+    if rng.random() < reflective:
+        material["reflective"] = [0.6, 0.6, 0.6]
+    return material
+
+
+def make_light(rng, light_type, extent):
+    """Returns a light group of the given type above the primitives."""
+    height = extent
+    position = [rng.uniform(-extent / 2, extent / 2), height, rng.uniform(-extent / 2, extent / 2)]
+    light = {"type": light_type, "color": [1, 1, 1]}
+    if light_type != "directional":
+        light["attenuationCoeff"] = [1.0, 0.0, 0.0]
+    if light_type == "directional":
+        light["direction"] = [round(rng.uniform(-1, 1), 3), -1, round(rng.uniform(-1, 1), 3)]
+    elif light_type == "spot":
+        light["direction"] = [0, -1, 0]
+        light["angle"] = 45
+        light["penumbra"] = 10
+    elif light_type == "area":
+        light["width"] = extent / 4
+        light["height"] = extent / 4
+        light["uvec"] = [1, 0, 0]
+        light["vvec"] = [0, 0, 1]
+    return {"translate": [round(p, 3) for p in position], "lights": [light]}
+
+
+def generate(args):
+    rng = random.Random(args.seed)
+    types = list(args.mix.keys())
+    type_weights = list(args.mix.values())
+    clusters = [[rng.uniform(-args.extent / 2, args.extent / 2) for _ in range(3)]
+                for _ in range(args.clusters)]
+
+    # one named group per GROUP_SIZE primitives, each primitive with its own
+    # transform
+    groups = []
+    for start in range(0, args.count, GROUP_SIZE):
+        children = []
+        for index in range(start, min(start + GROUP_SIZE, args.count)):
+            primitive_type = rng.choices(types, type_weights)[0]
+            primitive = {"type": primitive_type, **make_material(rng, args.reflective)}
+            if primitive_type.startswith("moving"):
+                primitive["center2"] = [0, round(rng.uniform(0.2, 1.0), 3), 0]
+            scale = rng.uniform(args.min_size, args.max_size)
+            children.append({
+                "translate": [round(p, 3) for p in sample_position(
+                    rng, args.distribution, index, args.count, args.extent, clusters)],
+                "rotate": [0, 1, 0, round(rng.uniform(0, 360), 1)],
+                "scale": [round(scale, 3)] * 3,
+                "primitives": [primitive],
+            })
+        groups.append({"name": f"chunk{start // GROUP_SIZE}", "groups": children})
+
+    for light_type, light_count in args.lights.items():
+        for _ in range(int(light_count)):
+            groups.append(make_light(rng, light_type, args.extent))
+
+    # a floor under everything so shadows land somewhere
+    groups.append({
+        "name": "floor",
+        "translate": [0, -args.extent / 2 - 0.5, 0],
+        "scale": [args.extent * 2, 0.1, args.extent * 2],
+        "primitives": [{"type": "cube", "diffuse": [0.5, 0.5, 0.5], "ambient": [0.1, 0.1, 0.1]}],
+    })
+
+    distance = args.extent * 1.6
+    return {
+        "globalData": {"ambientCoeff": 0.5, "diffuseCoeff": 0.5,
+                       "specularCoeff": 0.5, "transparentCoeff": 0},
+        "cameraData": {"position": [distance, distance * 0.6, distance],
+                       "up": [0, 1, 0], "heightAngle": 45,
+                       "look": [-1, -0.6, -1]},
+        "groups": groups,
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--count", type=int, default=1000, help="number of primitives")
+    parser.add_argument("--mix", type=lambda t: parse_weights(t, PRIMITIVE_TYPES),
+                        default="sphere,cube,cone,cylinder",
+                        help="relative weight of each primitive type, e.g. sphere=3,cube=1")
+    parser.add_argument("--distribution", choices=["uniform", "clustered", "grid"],
+                        default="uniform", help="how primitives are placed")
+    parser.add_argument("--clusters", type=int, default=8,
+                        help="number of clusters of the clustered distribution")
+    parser.add_argument("--extent", type=float, default=20.0,
+                        help="side of the cube the primitives are placed in")
+    parser.add_argument("--min-size", type=float, default=0.2)
+    parser.add_argument("--max-size", type=float, default=1.0)
+    parser.add_argument("--lights", type=lambda t: parse_weights(t, LIGHT_TYPES),
+                        default="point=1,directional=1",
+                        help="number of lights of each type, e.g. point=2,area=1")
+    parser.add_argument("--reflective", type=float, default=0.0,
+                        help="fraction of primitives with a reflective material")
+    parser.add_argument("--seed", type=int, default=1230)
+    parser.add_argument("--output", required=True, help="scenefile to write")
+    args = parser.parse_args()
+
+    with open(args.output, "w") as f:
+        json.dump(generate(args), f, indent=1)
+    print(f"wrote {args.count} primitives to {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,119 @@
+"""Renders generated scenes over a sweep of primitive counts, thread counts and
+resolutions, and collects render time and ray throughput in a CSV file.
+
+Each render writes the stats.json of Feature/stats, which is where the render
+time and ray counts come from, so the renderer has to be built with
+AETHER_RENDER_STATS (the default).
+
+Example:
+    python3 tools/scalingSweep.py --executable build/project_aether_ray \
+        --counts 100,1000,10000 --threads 1,4,8 --resolutions 256x192,512x384 \
+        -- --mix sphere=3,cube=1 --lights point=2,area=1 --reflective 0.2
+Arguments after "--" are passed on to generateScene.py.
+"""
+
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+
+INI_TEMPLATE = """[IO]
+    scene = {scene}
+    output = {output}
+
+[Canvas]
+    width = {width}
+    height = {height}
+
+[Feature]
+    shadows = true
+    reflect = true
+    refract = false
+    texture = false
+    parallel = {parallel}
+    acceleration = {acceleration}
+    stats = true
+
+[Settings]
+    maximum-recursive-depth = 4
+    threads = {threads}
+"""
+
+
+def parse_list(text, convert):
+    return [convert(item) for item in text.split(",") if item]
+
+
+def parse_resolution(text):
+    width, _, height = text.partition("x")
+    return int(width), int(height)
+
+
+def main():
+    argv = sys.argv[1:]
+    generator_args = []
+    if "--" in argv:
+        split = argv.index("--")
+        argv, generator_args = argv[:split], argv[split + 1:]
+
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--executable", required=True, help="path of project_aether_ray")
+    parser.add_argument("--counts", type=lambda t: parse_list(t, int), default="100,1000,10000")
+    parser.add_argument("--threads", type=lambda t: parse_list(t, int), default="1,4")
+    parser.add_argument("--resolutions", type=lambda t: parse_list(t, parse_resolution),
+                        default="256x192")
+    parser.add_argument("--acceleration", action="store_true",
+                        help="render with Feature/acceleration enabled")
+    parser.add_argument("--work-dir", default="sweep", help="directory for scenes, inis and renders")
+    parser.add_argument("--output", default="sweep.csv", help="CSV file of the results")
+    args = parser.parse_args(argv)
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    rows = []
+    for count in args.counts:
+        scene = os.path.abspath(os.path.join(args.work_dir, f"scene{count}.json"))
+        subprocess.run([sys.executable, os.path.join(TOOLS_DIR, "generateScene.py"),
+                        "--count", str(count), "--output", scene, *generator_args], check=True)
+
+        for threads in args.threads:
+            for width, height in args.resolutions:
+                name = f"scene{count}_t{threads}_{width}x{height}"
+                ini = os.path.join(args.work_dir, name + ".ini")
+                output = os.path.abspath(os.path.join(args.work_dir, name + ".png"))
+                with open(ini, "w") as f:
+                    f.write(INI_TEMPLATE.format(
+                        scene=scene, output=output, width=width, height=height,
+                        parallel="true" if threads > 1 else "false", threads=threads,
+                        acceleration="true" if args.acceleration else "false"))
+
+                print(f"rendering {name}", flush=True)
+                result = subprocess.run([args.executable, ini], capture_output=True, text=True)
+                if result.returncode != 0:
+                    print(result.stderr, file=sys.stderr)
+                    continue
+
+                with open(os.path.join(args.work_dir, name + ".stats.json")) as f:
+                    stats = json.load(f)
+                seconds = stats["phaseSeconds"]["render"]
+                rays = sum(stats["rays"].values())
+                rows.append({
+                    "primitives": count, "threads": threads, "width": width, "height": height,
+                    "parse_seconds": stats["phaseSeconds"]["parse"],
+                    "build_seconds": stats["phaseSeconds"]["sceneBuild"],
+                    "render_seconds": seconds, "rays": rays,
+                    "rays_per_second": rays / seconds if seconds > 0 else 0,
+                })
+
+    with open(args.output, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=list(rows[0].keys()) if rows else ["primitives"])
+        writer.writeheader()
+        writer.writerows(rows)
+    print(f"wrote {len(rows)} results to {args.output}")
+
+
+if __name__ == "__main__":
+    main()